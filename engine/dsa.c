@@ -1,38 +1,115 @@
 #include "./dsa.h"
 
-#define _BINSEARCH_FUNC(name, bufftype, valtype, cmp, cmp_inv, mid_read)       \
-    uint8_t name(const bufftype *const haystack, size_t len, valtype needle,   \
-                 uint32_t *pos) {                                              \
-        int32_t left = 0, right = len - 1, mid;                                \
-        valtype mid_val;                                                       \
-        if (len == 0) {                                                        \
-            if (pos)                                                           \
-                *pos = 0;                                                      \
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DSA_X86
+#endif
+
+// Branchless lower bound: the loop always runs log2(len) times and the
+// comparison becomes a conditional move instead of a mispredicted branch.
+// field selects the compared member of bufftype, empty for plain values.
+#define _LOWERBOUND_FUNC(name, bufftype, valtype, field)                       \
+    size_t name(const bufftype *const haystack, size_t len, valtype needle) {  \
+        const bufftype *base = haystack;                                       \
+        size_t half;                                                           \
+        if (len == 0)                                                          \
             return 0;                                                          \
+        while (len > 1) {                                                      \
+            half = len >> 1;                                                   \
+            base = base[half] field < needle ? base + half : base;             \
+            len -= half;                                                       \
         }                                                                      \
-        while (left <= right) {                                                \
-            mid = (left + right) >> 1;                                         \
-            mid_val = mid_read;                                                \
-            if (mid_val cmp needle)                                            \
-                right = mid - 1;                                               \
-            else if (mid_val cmp_inv needle)                                   \
-                left = mid + 1;                                                \
-            else {                                                             \
-                if (pos)                                                       \
-                    *pos = mid;                                                \
-                return 1;                                                      \
-            }                                                                  \
-        }                                                                      \
+        return (base - haystack) + (base[0] field < needle);                   \
+    }
+
+#define _BINSEARCH_FUNC(name, lowerbound_func, bufftype, valtype, field)       \
+    uint8_t name(const bufftype *const haystack, size_t len, valtype needle,   \
+                 uint32_t *pos) {                                              \
+        const size_t lb = lowerbound_func(haystack, len, needle);              \
+        const uint8_t found = lb < len && haystack[lb] field == needle;        \
         if (pos)                                                               \
-            *pos = mid;                                                        \
-        return 0;                                                              \
+            *pos = found || lb == 0 ? lb : lb - 1;                             \
+        return found;                                                          \
     }
 
+#define _LINSEARCH_SCALAR(haystack, start, len, needle)                        \
+    for (size_t j = start; j < len; j++) {                                     \
+        if (haystack[j] == needle)                                             \
+            return j;                                                          \
+    }                                                                          \
+    return len;
+
+#ifdef DSA_X86
+__attribute__((target("avx2"))) static size_t
+linsearch_u32Avx2(const uint32_t *const haystack, const size_t len,
+                  const uint32_t needle) {
+    const __m256i key = _mm256_set1_epi32(needle);
+    size_t i;
+    int mask;
+    for (i = 0; i + 8 <= len; i += 8) {
+        mask = _mm256_movemask_epi8(_mm256_cmpeq_epi32(
+            _mm256_loadu_si256((const __m256i *)(haystack + i)), key));
+        if (mask)
+            return i + (__builtin_ctz(mask) >> 2);
+    }
+    _LINSEARCH_SCALAR(haystack, i, len, needle)
+}
+
+__attribute__((target("sse2"))) static size_t
+linsearch_u32Sse2(const uint32_t *const haystack, const size_t len,
+                  const uint32_t needle) {
+    const __m128i key = _mm_set1_epi32(needle);
+    size_t i;
+    int mask;
+    for (i = 0; i + 4 <= len; i += 4) {
+        mask = _mm_movemask_epi8(_mm_cmpeq_epi32(
+            _mm_loadu_si128((const __m128i *)(haystack + i)), key));
+        if (mask)
+            return i + (__builtin_ctz(mask) >> 2);
+    }
+    _LINSEARCH_SCALAR(haystack, i, len, needle)
+}
+#endif
+
+static size_t linsearch_u32Scalar(const uint32_t *const haystack,
+                                  const size_t len, const uint32_t needle) {
+    _LINSEARCH_SCALAR(haystack, 0, len, needle)
+}
+
+typedef size_t (*LinsearchU32Func)(const uint32_t *haystack, size_t len,
+                                   uint32_t needle);
+
+static size_t linsearch_u32Resolve(const uint32_t *haystack, size_t len,
+                                   uint32_t needle);
+
+// Kernel picked by the first call
+static LinsearchU32Func linsearch_u32Impl = linsearch_u32Resolve;
+
+static size_t linsearch_u32Resolve(const uint32_t *const haystack,
+                                   const size_t len, const uint32_t needle) {
+    LinsearchU32Func impl = linsearch_u32Scalar;
+#ifdef DSA_X86
+    if (__builtin_cpu_supports("avx2"))
+        impl = linsearch_u32Avx2;
+    else if (__builtin_cpu_supports("sse2"))
+        impl = linsearch_u32Sse2;
+#endif
+    // Every thread resolves to the same kernel, so racing stores are harmless
+    __atomic_store_n(&linsearch_u32Impl, impl, __ATOMIC_RELAXED);
+    return impl(haystack, len, needle);
+}
+
+size_t linsearch_u32(const uint32_t *const haystack, const size_t len,
+                     const uint32_t needle) {
+    return __atomic_load_n(&linsearch_u32Impl, __ATOMIC_RELAXED)(haystack, len,
+                                                                  needle);
+}
+
 #define _INSERTSORT_FUNC(name, binsearch_func, buftype, searchtype)            \
     uint32_t name(buftype *const buf, size_t size, searchtype val) {           \
         int32_t pos, i;                                                        \
         binsearch_func(buf, size, val, &pos);                                  \
-        if (size)                                                              \
+        if (size && buf[pos] < val)                                            \
             pos++;                                                             \
         for (i = size; i > pos; i--)                                           \
             buf[i] = buf[i - 1];                                               \
@@ -40,68 +117,254 @@
         return pos;                                                            \
     }
 
-Hashmap hashmap_init() { return (Hashmap){0, 0, 0}; }
+#define SORT_SMALL 32
+
+// Key comparison honouring the sort direction
+#define _SORT_BEFORE(a, b) (descending ? (a).key > (b).key : (a).key < (b).key)
+
+// Stable insertion sort, used below SORT_SMALL pairs
+#define _SORT_INSERTION(pairs, n, pairtype)                                    \
+    for (size_t i = 1; i < n; i++) {                                           \
+        const pairtype cur = pairs[i];                                         \
+        size_t j = i;                                                          \
+        for (; j > 0 && _SORT_BEFORE(cur, pairs[j - 1]); j--)                  \
+            pairs[j] = pairs[j - 1];                                           \
+        pairs[j] = cur;                                                        \
+    }
+
+#define _RADIXSORT_FUNC(name, pairtype)                                        \
+    uint8_t name(pairtype *pairs, const size_t n, pairtype *tmp,               \
+                 const uint8_t descending) {                                   \
+        enum { nBytes = sizeof(pairs->key) };                                  \
+        size_t count[nBytes][256] = {0}, offset[256], i, byte, digit, sum;     \
+        pairtype *const orig = pairs, *const scratch = tmp, *swap;             \
+        if (n < SORT_SMALL) {                                                  \
+            _SORT_INSERTION(pairs, n, pairtype)                                \
+            return 1;                                                          \
+        }                                                                      \
+        if (tmp == NULL && (tmp = malloc(n * sizeof(pairtype))) == NULL)       \
+            return 0;                                                          \
+        /* One pass builds the histograms of every key byte */                 \
+        for (i = 0; i < n; i++) {                                              \
+            for (byte = 0; byte < nBytes; byte++)                              \
+                count[byte][(pairs[i].key >> (byte * 8)) & 0xff]++;            \
+        }                                                                      \
+        for (byte = 0; byte < nBytes; byte++) {                                \
+            if (count[byte][(pairs[0].key >> (byte * 8)) & 0xff] == n)         \
+                continue;                                                      \
+            for (sum = 0, i = 0; i < 256; i++) {                               \
+                digit = descending ? 255 - i : i;                              \
+                offset[digit] = sum;                                           \
+                sum += count[byte][digit];                                     \
+            }                                                                  \
+            for (i = 0; i < n; i++)                                            \
+                tmp[offset[(pairs[i].key >> (byte * 8)) & 0xff]++] = pairs[i]; \
+            swap = pairs;                                                      \
+            pairs = tmp;                                                       \
+            tmp = swap;                                                        \
+        }                                                                      \
+        if (pairs != orig)                                                     \
+            memcpy(orig, pairs, n * sizeof(pairtype));                         \
+        if (scratch == NULL)                                                   \
+            free(pairs == orig ? tmp : pairs);                                 \
+        return 1;                                                              \
+    }
+
+#define _INTROSORT_FUNC(name, pairtype)                                        \
+    static void name##Sift(pairtype *const pairs, size_t root,                 \
+                           const size_t n, const uint8_t descending) {         \
+        const pairtype cur = pairs[root];                                      \
+        size_t child;                                                          \
+        while ((child = root * 2 + 1) < n) {                                   \
+            if (child + 1 < n && _SORT_BEFORE(pairs[child], pairs[child + 1])) \
+                child++;                                                       \
+            if (!_SORT_BEFORE(cur, pairs[child]))                              \
+                break;                                                         \
+            pairs[root] = pairs[child];                                        \
+            root = child;                                                      \
+        }                                                                      \
+        pairs[root] = cur;                                                     \
+    }                                                                          \
+    static void name##Rec(pairtype *pairs, size_t n, size_t depth,             \
+                          const uint8_t descending) {                          \
+        pairtype pivot, swap;                                                  \
+        size_t i, j;                                                           \
+        while (n >= SORT_SMALL) {                                              \
+            if (depth-- == 0) {                                                \
+                for (i = n / 2; i-- > 0;)                                      \
+                    name##Sift(pairs, i, n, descending);                       \
+                for (i = n - 1; i > 0; i--) {                                  \
+                    swap = pairs[0];                                           \
+                    pairs[0] = pairs[i];                                       \
+                    pairs[i] = swap;                                           \
+                    name##Sift(pairs, 0, i, descending);                       \
+                }                                                              \
+                return;                                                        \
+            }                                                                  \
+            /* Median of three, so sorted input stays O(n log n) */            \
+            i = n / 2;                                                         \
+            if (_SORT_BEFORE(pairs[i], pairs[0]))                              \
+                swap = pairs[i], pairs[i] = pairs[0], pairs[0] = swap;         \
+            if (_SORT_BEFORE(pairs[n - 1], pairs[i]))                          \
+                swap = pairs[i], pairs[i] = pairs[n - 1], pairs[n - 1] = swap; \
+            if (_SORT_BEFORE(pairs[i], pairs[0]))                              \
+                swap = pairs[i], pairs[i] = pairs[0], pairs[0] = swap;         \
+            pivot = pairs[i];                                                  \
+            /* Hoare partition */                                              \
+            i = 0;                                                             \
+            j = n - 1;                                                         \
+            while (1) {                                                        \
+                while (_SORT_BEFORE(pairs[i], pivot))                          \
+                    i++;                                                       \
+                while (_SORT_BEFORE(pivot, pairs[j]))                          \
+                    j--;                                                       \
+                if (i >= j)                                                    \
+                    break;                                                     \
+                swap = pairs[i], pairs[i] = pairs[j], pairs[j] = swap;         \
+                i++;                                                           \
+                j--;                                                           \
+            }                                                                  \
+            /* Recurse into the smaller side, loop on the larger one */        \
+            if (j + 1 < n - j - 1) {                                           \
+                name##Rec(pairs, j + 1, depth, descending);                    \
+                pairs += j + 1;                                                \
+                n -= j + 1;                                                    \
+            } else {                                                           \
+                name##Rec(pairs + j + 1, n - j - 1, depth, descending);        \
+                n = j + 1;                                                     \
+            }                                                                  \
+        }                                                                      \
+        _SORT_INSERTION(pairs, n, pairtype)                                    \
+    }                                                                          \
+    void name(pairtype *const pairs, const size_t n,                           \
+              const uint8_t descending) {                                      \
+        size_t depth = 0;                                                      \
+        for (size_t i = n; i > 1; i >>= 1)                                     \
+            depth += 2;                                                        \
+        name##Rec(pairs, n, depth, descending);                                \
+    }
+
+#define HASHMAP_EMPTY UINT32_MAX
+#define HASHMAP_MIN_SLOTS 8
+
+static inline uint32_t hashmap_hash(const uint32_t key) {
+    uint32_t h = key * 0x9e3779b1u;
+    return h ^ (h >> 15);
+}
+
+// Distance of a slot from the home slot of its key
+static inline size_t hashmap_probeDist(const Hashmap *const hmap,
+                                       const size_t slot, const uint32_t key) {
+    return (slot - hashmap_hash(key)) & (hmap->nSlots - 1);
+}
+
+// Slot holding key, or hmap->nSlots if it isn't in the map
+static size_t hashmap_findSlot(const Hashmap *const hmap, const uint32_t key) {
+    const size_t mask = hmap->nSlots - 1;
+    size_t slot, dist;
+    if (hmap->slots == NULL)
+        return hmap->nSlots;
+    slot = hashmap_hash(key) & mask;
+    for (dist = 0;; dist++, slot = (slot + 1) & mask) {
+        const HashmapSlot *const s = hmap->slots + slot;
+        // Robin Hood keeps probe sequences ordered by distance, so a richer
+        // slot means the key would have been placed before it
+        if (s->entry == HASHMAP_EMPTY ||
+            hashmap_probeDist(hmap, slot, s->key) < dist)
+            return hmap->nSlots;
+        if (s->key == key)
+            return slot;
+    }
+}
+
+// Place a key that isn't in the index yet, displacing richer slots
+static void hashmap_insertSlot(Hashmap *const hmap, uint32_t key,
+                               uint32_t entry) {
+    const size_t mask = hmap->nSlots - 1;
+    size_t slot = hashmap_hash(key) & mask, dist = 0, slotDist;
+    HashmapSlot tmp;
+    while (hmap->slots[slot].entry != HASHMAP_EMPTY) {
+        slotDist = hashmap_probeDist(hmap, slot, hmap->slots[slot].key);
+        if (slotDist < dist) {
+            tmp = hmap->slots[slot];
+            hmap->slots[slot] = (HashmapSlot){key, entry};
+            key = tmp.key;
+            entry = tmp.entry;
+            dist = slotDist;
+        }
+        slot = (slot + 1) & mask;
+        dist++;
+    }
+    hmap->slots[slot] = (HashmapSlot){key, entry};
+}
+
+// Rebuild the index with enough slots for size entries at 3/4 load
+static uint8_t hashmap_rehash(Hashmap *const hmap, const size_t size) {
+    size_t nSlots = HASHMAP_MIN_SLOTS, i;
+    HashmapSlot *slots;
+    while (nSlots * 3 < size * 4)
+        nSlots *= 2;
+    if (nSlots != hmap->nSlots) {
+        slots = malloc(nSlots * sizeof(HashmapSlot));
+        if (slots == NULL)
+            return 0;
+        free(hmap->slots);
+        hmap->slots = slots;
+        hmap->nSlots = nSlots;
+    }
+    for (i = 0; i < hmap->nSlots; i++)
+        hmap->slots[i].entry = HASHMAP_EMPTY;
+    for (i = 0; i < hmap->nEntries; i++)
+        hashmap_insertSlot(hmap, hmap->entries[i].key, i);
+    return 1;
+}
+
+Hashmap hashmap_init() { return (Hashmap){0, 0, NULL, 0, NULL}; }
 
 uint8_t hashmap_resize(Hashmap *const hmap, const size_t size) {
-    HashmapEntry *const newArr =
-        realloc(hmap->entries, size * sizeof(HashmapEntry));
-    if (newArr) {
-        hmap->entries = newArr;
-        hmap->allocSize = size;
-        if (hmap->nEntries > hmap->allocSize)
-            hmap->nEntries = hmap->allocSize;
+    HashmapEntry *newArr;
+    if (size == 0) {
+        hashmap_free(hmap);
         return 1;
     }
-    return 0;
+    newArr = realloc(hmap->entries, size * sizeof(HashmapEntry));
+    if (newArr == NULL)
+        return 0;
+    hmap->entries = newArr;
+    hmap->allocSize = size;
+    if (hmap->nEntries > hmap->allocSize)
+        hmap->nEntries = hmap->allocSize;
+    return hashmap_rehash(hmap, size);
 }
 
 uint8_t hashmap_set(Hashmap *const hmap, const uint32_t key,
                     const HashmapVal value) {
-    uint32_t pos = 0;
-    uint8_t retVal, res;
-    if (hmap->entries != NULL)
-        res = binsearch_hashmapInc(hmap->entries, hmap->nEntries, key, &pos);
-    // printf("%u insert at %u\n", key, pos);
-    if (hmap->entries == NULL || !res) {
-        if (hmap->nEntries + 1 > hmap->allocSize) {
-            if (!hashmap_resize(hmap, hmap->allocSize * 2 + 1))
-                return 0;
-        }
-        if (hmap->nEntries && pos == hmap->nEntries - 1 &&
-            key > hmap->entries[pos].key)
-            pos++;
-        hmap->nEntries++;
-        for (uint32_t i = hmap->nEntries - 1; i > pos; i--)
-            hmap->entries[i] = hmap->entries[i - 1];
-        retVal = 1;
-    } else
-        retVal = 2;
-    hmap->entries[pos].key = key;
-    hmap->entries[pos].val = value;
-
-    /*printf("values: ");
-    for(int i = 0; i < hmap->nEntries; i++)
-        printf("%u ", hmap->entries[i].key);
-    printf("\n");*/
-    return retVal;
+    const size_t slot = hashmap_findSlot(hmap, key);
+    if (slot != hmap->nSlots) {
+        hmap->entries[hmap->slots[slot].entry].val = value;
+        return 2;
+    }
+    if (hmap->nEntries + 1 > hmap->allocSize &&
+        !hashmap_resize(hmap, hmap->allocSize * 2 + 1))
+        return 0;
+    hmap->entries[hmap->nEntries] = (HashmapEntry){key, value};
+    hashmap_insertSlot(hmap, key, hmap->nEntries);
+    hmap->nEntries++;
+    return 1;
 }
 
 uint8_t hashmap_get(const Hashmap *const hmap, const uint32_t key,
                     HashmapVal *const out) {
-    uint32_t pos;
-    if (hmap->entries == NULL ||
-        !binsearch_hashmapInc(hmap->entries, hmap->nEntries, key, &pos))
+    const size_t slot = hashmap_findSlot(hmap, key);
+    if (slot == hmap->nSlots)
         return 0;
     if (out)
-        *out = hmap->entries[pos].val;
+        *out = hmap->entries[hmap->slots[slot].entry].val;
     return 1;
 }
 
 uint8_t hashmap_exists(const Hashmap *const hmap, const uint32_t key) {
-    if (hmap->entries == NULL ||
-        !binsearch_hashmapInc(hmap->entries, hmap->nEntries, key, NULL))
-        return 0;
-    return 1;
+    return hashmap_findSlot(hmap, key) != hmap->nSlots;
 }
 
 uint8_t hashmap_getU32(const Hashmap *hmap, const uint32_t key,
@@ -124,25 +387,49 @@ uint8_t hashmap_getP(const Hashmap *hmap, const uint32_t key,
 
 uint8_t hashmap_delResize(Hashmap *const hmap, const uint32_t key,
                           const uint8_t resize) {
-    const uint32_t final_nEntries = hmap->nEntries - 1;
-    uint32_t pos, i;
-    if (hmap->entries == 0)
-        return 0;
-    if (!binsearch_hashmapInc(hmap->entries, hmap->nEntries, key, &pos))
+    const size_t mask = hmap->nSlots - 1;
+    size_t slot = hashmap_findSlot(hmap, key), next;
+    uint32_t entry, last;
+    if (slot == hmap->nSlots)
         return 0;
-    if (resize)
-        hashmap_resize(hmap, hmap->nEntries - 1);
-    hmap->nEntries = final_nEntries;
-    if (final_nEntries) {
-        for (i = pos; i < final_nEntries - 1; i++)
-            hmap->entries[i] = hmap->entries[i + 1];
+    entry = hmap->slots[slot].entry;
+
+    // Backward shift the rest of the probe sequence instead of leaving a
+    // tombstone
+    for (next = (slot + 1) & mask;
+         hmap->slots[next].entry != HASHMAP_EMPTY &&
+         hashmap_probeDist(hmap, next, hmap->slots[next].key) != 0;
+         slot = next, next = (next + 1) & mask)
+        hmap->slots[slot] = hmap->slots[next];
+    hmap->slots[slot].entry = HASHMAP_EMPTY;
+
+    // Keep entries dense by moving the last one into the hole
+    last = --hmap->nEntries;
+    if (entry != last) {
+        hmap->entries[entry] = hmap->entries[last];
+        hmap->slots[hashmap_findSlot(hmap, hmap->entries[entry].key)].entry =
+            entry;
     }
+    if (resize)
+        hashmap_resize(hmap, hmap->nEntries);
     return 1;
 }
 
 uint8_t hashmap_del(Hashmap *const hmap, const uint32_t key,
                     const uint8_t resize) {
-    return hashmap_delResize(hmap, key, 0);
+    return hashmap_delResize(hmap, key, resize);
+}
+
+void hashmap_clear(Hashmap *const hmap) {
+    hmap->nEntries = 0;
+    for (size_t i = 0; i < hmap->nSlots; i++)
+        hmap->slots[i].entry = HASHMAP_EMPTY;
+}
+
+void hashmap_free(Hashmap *const hmap) {
+    free(hmap->entries);
+    free(hmap->slots);
+    *hmap = hashmap_init();
 }
 
 Array array_init() { return (Array){0, 0, 0}; }
@@ -230,6 +517,13 @@ size_t array_size(const Array *const arr) { return arr->nEntries; }
 
 size_t array_capacity(const Array *const arr) { return arr->allocSize; }
 
+static int vec_cmpU32(const void *a, const void *b) {
+    const uint32_t valA = *(const uint32_t *)a, valB = *(const uint32_t *)b;
+    return (valA > valB) - (valA < valB);
+}
+
+_VEC_FUNC_SEARCH(U32Vec, vecU32, uint32_t, vec_cmpU32, linsearch_u32)
+
 // https://stackoverflow.com/questions/7666509/hash-function-for-string
 uint32_t str_hash(const char *const str) {
     uint32_t hash = 5381;
@@ -239,16 +533,29 @@ uint32_t str_hash(const char *const str) {
     return hash;
 }
 
-_BINSEARCH_FUNC(binsearch_s32Inc, int32_t, int32_t, >, <, haystack[mid]);
-_BINSEARCH_FUNC(binsearch_u32Inc, uint32_t, uint32_t, >, <, haystack[mid]);
-_BINSEARCH_FUNC(binsearch_fltInc, float, float, >, <, haystack[mid]);
-_BINSEARCH_FUNC(binsearch_fltArrayInc, ArrayVal, float, >, <,
-                haystack[mid].flt);
-_BINSEARCH_FUNC(binsearch_hashmapInc, HashmapEntry, uint32_t, >, <,
-                haystack[mid].key);
+_LOWERBOUND_FUNC(lowerbound_s32, int32_t, int32_t, );
+_LOWERBOUND_FUNC(lowerbound_u32, uint32_t, uint32_t, );
+_LOWERBOUND_FUNC(lowerbound_flt, float, float, );
+_LOWERBOUND_FUNC(lowerbound_fltArray, ArrayVal, float, .flt);
+_LOWERBOUND_FUNC(lowerbound_hashmap, HashmapEntry, uint32_t, .key);
+
+_BINSEARCH_FUNC(binsearch_s32Inc, lowerbound_s32, int32_t, int32_t, );
+_BINSEARCH_FUNC(binsearch_u32Inc, lowerbound_u32, uint32_t, uint32_t, );
+_BINSEARCH_FUNC(binsearch_fltInc, lowerbound_flt, float, float, );
+_BINSEARCH_FUNC(binsearch_fltArrayInc, lowerbound_fltArray, ArrayVal, float,
+                .flt);
+_BINSEARCH_FUNC(binsearch_hashmapInc, lowerbound_hashmap, HashmapEntry,
+                uint32_t, .key);
 
 _INSERTSORT_FUNC(insertsort_u32Inc, binsearch_u32Inc, uint32_t, uint32_t);
 _INSERTSORT_FUNC(insertsort_s32Inc, binsearch_s32Inc, int32_t, int32_t);
 
+_RADIXSORT_FUNC(sort_radixU32, SortPairU32);
+_RADIXSORT_FUNC(sort_radixU64, SortPairU64);
+_INTROSORT_FUNC(sort_introU32, SortPairU32);
+_INTROSORT_FUNC(sort_introU64, SortPairU64);
+
+#undef _LOWERBOUND_FUNC
 #undef _BINSEARCH_FUNC
+#undef _LINSEARCH_SCALAR
 #undef _INSERTSORT_FUNC
\ No newline at end of file
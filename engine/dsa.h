@@ -16,10 +16,21 @@ typedef struct HashmapEntry {
     HashmapVal val;
 } HashmapEntry;
 
+// Index slot of the open-addressing table, entry is UINT32_MAX when empty
+typedef struct HashmapSlot {
+    uint32_t key;
+    uint32_t entry;
+} HashmapSlot;
+
+// Entries are kept dense in insertion order (deletion moves the last entry
+// into the hole) and indexed by a Robin Hood linear probing table
 typedef struct Hashmap {
     size_t nEntries;
     size_t allocSize;
     HashmapEntry *entries;
+    // Power of 2, at most 3/4 full
+    size_t nSlots;
+    HashmapSlot *slots;
 } Hashmap;
 
 typedef union ArrayVal {
@@ -34,6 +45,113 @@ typedef struct Array {
     ArrayVal *entries;
 } Array;
 
+// Packed key/value pairs for the sort functions
+typedef struct SortPairU32 {
+    uint32_t key;
+    uint32_t val;
+} SortPairU32;
+
+typedef struct SortPairU64 {
+    uint64_t key;
+    uint32_t val;
+} SortPairU64;
+
+// Typed dynamic array storing elements at their native size. _VEC_DECL
+// declares the vector type and its functions, _VEC_FUNC defines them in a
+// single translation unit. cmp is a qsort comparator used by find and sort.
+// _VEC_FUNC_SEARCH finds elements with search instead, a linsearch_* function.
+// Elements are read directly through data[0..n).
+#define _VEC_DECL(vectype, prefix, type)                                       \
+    typedef struct vectype {                                                   \
+        size_t n;                                                              \
+        size_t cap;                                                            \
+        type *data;                                                            \
+    } vectype;                                                                 \
+    vectype prefix##_init(void);                                               \
+    void prefix##_free(vectype *vec);                                          \
+    /* Grow capacity to at least cap, at least doubling it */                  \
+    uint8_t prefix##_reserve(vectype *vec, size_t cap);                        \
+    uint8_t prefix##_push(vectype *vec, type val);                             \
+    uint8_t prefix##_append(vectype *vec, const type *vals, size_t count);     \
+    /* Remove an element by moving the last one into its place */              \
+    void prefix##_swapRemove(vectype *vec, size_t pos);                        \
+    /* Position of the first element equal to val, or n if not found */        \
+    size_t prefix##_find(const vectype *vec, type val);                        \
+    /* Swap-remove the first element equal to val. Returns 0 if not found. */ \
+    uint8_t prefix##_erase(vectype *vec, type val);                            \
+    void prefix##_sort(vectype *vec);                                          \
+    static inline void prefix##_clear(vectype *vec) { vec->n = 0; }
+
+#define _VEC_FUNC_COMMON(vectype, prefix, type, cmp)                           \
+    vectype prefix##_init(void) { return (vectype){0, 0, NULL}; }              \
+    void prefix##_free(vectype *const vec) {                                   \
+        free(vec->data);                                                       \
+        *vec = prefix##_init();                                                \
+    }                                                                          \
+    uint8_t prefix##_reserve(vectype *const vec, size_t cap) {                 \
+        type *data;                                                            \
+        if (cap <= vec->cap)                                                   \
+            return 1;                                                          \
+        if (cap < vec->cap * 2)                                                \
+            cap = vec->cap * 2;                                                \
+        if (cap < 8)                                                           \
+            cap = 8;                                                           \
+        data = realloc(vec->data, cap * sizeof(type));                         \
+        if (data == NULL)                                                      \
+            return 0;                                                          \
+        vec->data = data;                                                      \
+        vec->cap = cap;                                                        \
+        return 1;                                                              \
+    }                                                                          \
+    uint8_t prefix##_push(vectype *const vec, const type val) {                \
+        if (vec->n == vec->cap && !prefix##_reserve(vec, vec->n + 1))          \
+            return 0;                                                          \
+        vec->data[vec->n++] = val;                                             \
+        return 1;                                                              \
+    }                                                                          \
+    uint8_t prefix##_append(vectype *const vec, const type *const vals,        \
+                            const size_t count) {                              \
+        if (!prefix##_reserve(vec, vec->n + count))                            \
+            return 0;                                                          \
+        memcpy(vec->data + vec->n, vals, count * sizeof(type));                \
+        vec->n += count;                                                       \
+        return 1;                                                              \
+    }                                                                          \
+    void prefix##_swapRemove(vectype *const vec, const size_t pos) {           \
+        if (pos < vec->n)                                                      \
+            vec->data[pos] = vec->data[--vec->n];                              \
+    }                                                                          \
+    uint8_t prefix##_erase(vectype *const vec, const type val) {               \
+        const size_t pos = prefix##_find(vec, val);                            \
+        if (pos == vec->n)                                                     \
+            return 0;                                                          \
+        prefix##_swapRemove(vec, pos);                                         \
+        return 1;                                                              \
+    }                                                                          \
+    void prefix##_sort(vectype *const vec) {                                   \
+        if (vec->n > 1)                                                        \
+            qsort(vec->data, vec->n, sizeof(type), cmp);                       \
+    }
+
+#define _VEC_FUNC(vectype, prefix, type, cmp)                                  \
+    _VEC_FUNC_COMMON(vectype, prefix, type, cmp)                               \
+    size_t prefix##_find(const vectype *const vec, const type val) {           \
+        size_t i;                                                              \
+        for (i = 0; i < vec->n; i++) {                                         \
+            if (cmp(vec->data + i, &val) == 0)                                 \
+                break;                                                         \
+        }                                                                      \
+        return i;                                                              \
+    }
+
+#define _VEC_FUNC_SEARCH(vectype, prefix, type, cmp, search)                   \
+    _VEC_FUNC_COMMON(vectype, prefix, type, cmp)                               \
+    size_t prefix##_find(const vectype *const vec, const type val) {           \
+        return search(vec->data, vec->n, val);                                 \
+    }
+
+_VEC_DECL(U32Vec, vecU32, uint32_t)
+
 Hashmap hashmap_init();
 uint8_t hashmap_resize(Hashmap *hmap, size_t size);
 uint8_t hashmap_set(Hashmap *hmap, uint32_t key, HashmapVal value);
@@ -43,6 +161,8 @@ uint8_t hashmap_getP(const Hashmap *hmap, uint32_t key, void **out);
 uint8_t hashmap_exists(const Hashmap *hmap, uint32_t key);
 uint8_t hashmap_delResize(Hashmap *hmap, uint32_t key, uint8_t resize);
 uint8_t hashmap_del(Hashmap *hmap, uint32_t key, uint8_t resize);
+void hashmap_clear(Hashmap *hmap);
+void hashmap_free(Hashmap *hmap);
 
 Array array_init();
 uint8_t array_resize(Array *arr, size_t size);
@@ -77,6 +197,34 @@ uint8_t binsearch_fltArrayInc(const ArrayVal *haystack, size_t len,
 uint8_t binsearch_hashmapInc(const HashmapEntry *hmap, size_t len, uint32_t key,
                              uint32_t *pos);
 
+// Index of the first element not below needle in a sorted buffer, or len
+size_t lowerbound_s32(const int32_t *haystack, size_t len, int32_t needle);
+size_t lowerbound_u32(const uint32_t *haystack, size_t len, uint32_t needle);
+size_t lowerbound_flt(const float *haystack, size_t len, float needle);
+
+// Index of the first element equal to needle in an unsorted buffer, or len.
+// Uses AVX2 or SSE2 when the CPU supports them, checked on the first call.
+size_t linsearch_u32(const uint32_t *haystack, size_t len, uint32_t needle);
+
+// Map a float to a key with the same order, for sorting pairs by float
+static inline uint32_t sort_fltKey(const float val) {
+    uint32_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    return bits ^ (bits >> 31 ? UINT32_MAX : 0x80000000u);
+}
+
+// Stable LSD radix sort of pairs by key, skipping the bytes all keys share.
+// tmp is scratch space for n pairs, allocated internally when NULL. Returns 0
+// if that allocation fails.
+uint8_t sort_radixU32(SortPairU32 *pairs, size_t n, SortPairU32 *tmp,
+                      uint8_t descending);
+uint8_t sort_radixU64(SortPairU64 *pairs, size_t n, SortPairU64 *tmp,
+                      uint8_t descending);
+// Unstable in-place introsort of pairs by key: quicksort falling back to
+// heapsort past 2*log2(n) recursion levels
+void sort_introU32(SortPairU32 *pairs, size_t n, uint8_t descending);
+void sort_introU64(SortPairU64 *pairs, size_t n, uint8_t descending);
+
 // Insert value into sorted buffer.
 // Returns the inserted value index in buffer.
 // len = buffer length before insertion
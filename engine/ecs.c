@@ -9,30 +9,51 @@ static inline uint8_t ecs_checkCompType(const uint32_t compType) {
     return 1;
 }
 
-static inline uint8_t ecs_checkEntityID(const ECSEntityID id) {
+static inline ECSEntityDesc *ecs_entDesc(const ECS *const ecs,
+                                         const ECSEntityID id) {
+    return ecs->entDesc + ECS_ENTITY_INDEX(id);
+}
+
+static inline uint8_t ecs_checkEntityID(const ECS *const ecs,
+                                        const ECSEntityID id) {
     if (id == ECS_INVALID_ID) {
         logMsg(LOG_LVL_ERR, "input entity id is ECS_INVALID_ID");
         return 0;
     }
-    if (id >= ECS_MAX_ENTITIES) {
+    if (ECS_ENTITY_INDEX(id) >= ecs->nEntIds) {
         logMsg(LOG_LVL_ERR,
-               "entity id larger than max. possible entity count: %u vs %u", id,
-               ECS_MAX_ENTITIES);
+               "entity index larger than max. assigned index: %u vs %u",
+               ECS_ENTITY_INDEX(id), ecs->nEntIds);
         return 0;
     }
     return 1;
 }
 
-static inline uint8_t ecs_checkComponentID(const ECSComponentID id) {
+// Check if the slot of the entity is in use and has the same generation.
+// The id must be validated by ecs_checkEntityID first.
+static inline uint8_t ecs_entityAlive(const ECS *const ecs,
+                                      const ECSEntityID id) {
+    const ECSEntityDesc *const desc = ecs_entDesc(ecs, id);
+    return desc->activePos != ECS_INVALID_ID &&
+           desc->generation == ECS_ENTITY_GENERATION(id);
+}
+
+// Liveness check of any ID, without logging
+static inline uint8_t ecs_idAlive(const ECS *const ecs, const ECSEntityID id) {
+    return id != ECS_INVALID_ID && ECS_ENTITY_INDEX(id) < ecs->nEntIds &&
+           ecs_entityAlive(ecs, id);
+}
+
+static inline uint8_t ecs_checkComponentID(const ECSCompPool *const pool,
+                                           const ECSComponentID id) {
     if (id == ECS_INVALID_ID) {
         logMsg(LOG_LVL_ERR, "input component id is ECS_INVALID_ID");
         return 0;
     }
-    if (id >= ECS_MAX_COMPONENTS) {
-        logMsg(
-            LOG_LVL_ERR,
-            "component id larger than max. possible component count: %u vs %u",
-            id, ECS_MAX_COMPONENTS);
+    if (id >= pool->nComp) {
+        logMsg(LOG_LVL_ERR,
+               "component id larger than pool component count: %u vs %u", id,
+               pool->nComp);
         return 0;
     }
     return 1;
@@ -49,25 +70,783 @@ static inline uint8_t ecs_checkCallbackType(const uint32_t cbType) {
 
 static inline uint8_t ecs_checkEntityExists(const ECS *const ecs,
                                             const ECSEntityID id) {
-    if (!binsearch_u32Inc(ecs->activeEnt, ecs->nActiveEnt, id, 0)) {
+    if (!ecs_entityAlive(ecs, id)) {
         logMsg(LOG_LVL_ERR, "entity ID %u not found", id);
         return 0;
     }
     return 1;
 }
 
-void ecs_init(ECS *const ecs) {
-    ECSEntityID i;
+static inline ECSCompChunk *ecs_poolChunk(const ECSCompPool *const pool,
+                                          const uint32_t index) {
+    return pool->chunk + index / ECS_POOL_CHUNK_SIZE;
+}
+
+static inline void *ecs_poolData(const ECSCompPool *const pool,
+                                 const uint32_t index) {
+    return ecs_poolChunk(pool, index)->data +
+           (size_t)(index % ECS_POOL_CHUNK_SIZE) * pool->elemSize;
+}
+
+static inline ECSEntityID *ecs_poolOwner(const ECSCompPool *const pool,
+                                         const uint32_t index) {
+    return ecs_poolChunk(pool, index)->owner + index % ECS_POOL_CHUNK_SIZE;
+}
+
+static inline ECSComponentCallback *
+ecs_poolCallbacks(const ECSCompPool *const pool, const uint32_t index) {
+    return ecs_poolChunk(pool, index)->callback[index % ECS_POOL_CHUNK_SIZE];
+}
+
+// Dense index of the component owned by an entity, ECS_INVALID_ID if it has
+// none. The id must be validated by ecs_checkEntityID first.
+static inline uint32_t ecs_poolIndex(const ECSCompPool *const pool,
+                                     const ECSEntityID id) {
+    const uint32_t slot = ECS_ENTITY_INDEX(id);
+    const size_t page = slot / ECS_SPARSE_PAGE_SIZE;
+    if (page >= pool->nSparsePages || pool->sparse[page] == NULL)
+        return ECS_INVALID_ID;
+    return pool->sparse[page][slot % ECS_SPARSE_PAGE_SIZE];
+}
+
+static inline uint32_t ecs_compIndex(const ECS *const ecs,
+                                     const ECSEntityID id,
+                                     const uint32_t compType) {
+    return ecs_poolIndex(ecs->pool + compType, id);
+}
+
+// Set the dense index of an entity's component, allocating its sparse page
+static void ecs_poolSetIndex(ECSCompPool *const pool, const ECSEntityID id,
+                             const uint32_t index) {
+    const uint32_t slot = ECS_ENTITY_INDEX(id);
+    const size_t page = slot / ECS_SPARSE_PAGE_SIZE;
+    size_t i;
+
+    if (page >= pool->nSparsePages) {
+        if (index == ECS_INVALID_ID)
+            return;
+        uint32_t **const sparse =
+            realloc(pool->sparse, (page + 1) * sizeof(*sparse));
+        if (sparse == NULL) {
+            logMsg(LOG_LVL_FATAL, "can't grow sparse index to %u pages",
+                   page + 1);
+            return;
+        }
+        for (i = pool->nSparsePages; i <= page; i++)
+            sparse[i] = NULL;
+        pool->sparse = sparse;
+        pool->nSparsePages = page + 1;
+    }
+    if (pool->sparse[page] == NULL) {
+        if (index == ECS_INVALID_ID)
+            return;
+        pool->sparse[page] = malloc(ECS_SPARSE_PAGE_SIZE * sizeof(uint32_t));
+        if (pool->sparse[page] == NULL) {
+            logMsg(LOG_LVL_FATAL, "can't allocate sparse index page");
+            return;
+        }
+        memset(pool->sparse[page], 0xff,
+               ECS_SPARSE_PAGE_SIZE * sizeof(uint32_t));
+    }
+    pool->sparse[page][slot % ECS_SPARSE_PAGE_SIZE] = index;
+}
+
+static void ecs_poolFreeIndex(ECSCompPool *const pool) {
+    for (size_t i = 0; i < pool->nSparsePages; i++)
+        free(pool->sparse[i]);
+    free(pool->sparse);
+    pool->sparse = NULL;
+    pool->nSparsePages = 0;
+}
+
+// Size of the allocation of one chunk of the pool: data, then owners, then
+// callbacks, then change ticks
+static size_t ecs_chunkBytes(const ECSCompPool *const pool,
+                             size_t *const dataSize, size_t *const ownerSize,
+                             size_t *const cbSize) {
+    const ECSCompChunk *chunk;
+    *dataSize = ECS_POOL_CHUNK_SIZE * pool->elemSize;
+    *dataSize = (*dataSize + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    *ownerSize = ECS_POOL_CHUNK_SIZE * sizeof(*chunk->owner);
+    *ownerSize = (*ownerSize + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    *cbSize = ECS_POOL_CHUNK_SIZE * sizeof(*chunk->callback);
+    return *dataSize + *ownerSize + *cbSize +
+           ECS_POOL_CHUNK_SIZE * sizeof(*chunk->changeTick);
+}
+
+// Append a chunk to the pool. The chunk table grows geometrically, the chunks
+// themselves are never reallocated.
+static uint8_t ecs_poolGrow(ECSCompPool *const pool) {
+    ECSCompChunk *chunk;
+    uint8_t *block;
+    size_t dataSize, ownerSize, cbSize;
+    const size_t blockSize =
+        ecs_chunkBytes(pool, &dataSize, &ownerSize, &cbSize);
+
+    if (pool->nChunks == pool->chunkCap) {
+        const size_t newCap = pool->chunkCap ? pool->chunkCap * 2 : 4;
+        chunk = realloc(pool->chunk, newCap * sizeof(*chunk));
+        if (chunk == NULL)
+            return 0;
+        pool->chunk = chunk;
+        pool->chunkCap = newCap;
+    }
+
+    // malloc is enough for the alignment of any standard type
+    if (pool->align <= _Alignof(max_align_t))
+        block = malloc(blockSize);
+    else
+        block = aligned_alloc(pool->align, (blockSize + pool->align - 1) &
+                                               ~(pool->align - 1));
+    if (block == NULL)
+        return 0;
+    chunk = pool->chunk + pool->nChunks++;
+    chunk->data = block;
+    chunk->owner = (ECSEntityID *)(block + dataSize);
+    chunk->callback = (void *)(block + dataSize + ownerSize);
+    chunk->changeTick = (uint32_t *)(block + dataSize + ownerSize + cbSize);
+    memset(chunk->changed, 0, sizeof(chunk->changed));
+    chunk->lastChange = 0;
+    return 1;
+}
+
+// Stamp the component at index with the current tick. Atomic since systems
+// running in parallel can write components of the same chunk.
+static inline void ecs_poolMarkChanged(ECSCompPool *const pool,
+                                       const uint32_t index,
+                                       const uint32_t tick) {
+    ECSCompChunk *const chunk = ecs_poolChunk(pool, index);
+    const uint32_t i = index % ECS_POOL_CHUNK_SIZE;
+
+    __atomic_store_n(chunk->changeTick + i, tick, __ATOMIC_RELAXED);
+    __atomic_fetch_or(chunk->changed + i / 64, (uint64_t)1 << (i % 64),
+                      __ATOMIC_RELAXED);
+    __atomic_store_n(&chunk->lastChange, tick, __ATOMIC_RELAXED);
+    __atomic_store_n(&pool->lastChange, tick, __ATOMIC_RELAXED);
+}
+
+static inline void ecs_poolClearChanged(ECSCompPool *const pool,
+                                        const uint32_t index) {
+    const uint32_t i = index % ECS_POOL_CHUNK_SIZE;
+    ecs_poolChunk(pool, index)->changed[i / 64] &= ~((uint64_t)1 << (i % 64));
+}
+
+// Check that no read section is open on the entities (if entities is set) or
+// on the component types of mask before changing their structure
+static inline void ecs_checkStructChange(const ECS *const ecs,
+                                         const uint8_t entities,
+                                         const ECSCompMask mask,
+                                         const char *const op) {
+#if ECS_CHECK_ACCESS
+    uint32_t compType;
+
+    if (entities && __atomic_load_n(&ecs->nReaders, __ATOMIC_ACQUIRE)) {
+        logMsg(LOG_LVL_FATAL, "%s while %u ECS read sections are open", op,
+               __atomic_load_n(&ecs->nReaders, __ATOMIC_RELAXED));
+    }
+    for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        if ((mask & ECS_COMP_MASK(compType)) &&
+            __atomic_load_n(&ecs->pool[compType].readers, __ATOMIC_ACQUIRE))
+            logMsg(LOG_LVL_FATAL, "%s while comp. type %u is being read", op,
+                   compType);
+    }
+#endif
+}
+
+static inline void ecs_poolBumpEpoch(ECSCompPool *const pool) {
+    __atomic_fetch_add(&pool->epoch, 1, __ATOMIC_RELEASE);
+}
+
+// Free the trailing chunks that are no longer used. One spare chunk is kept to
+// avoid reallocating when the component count oscillates around a boundary.
+static void ecs_poolShrink(ECSCompPool *const pool) {
+    const size_t used =
+        (pool->nComp + pool->nParked + ECS_POOL_CHUNK_SIZE - 1) /
+        ECS_POOL_CHUNK_SIZE;
+    while (pool->nChunks > used + 1)
+        free(pool->chunk[--pool->nChunks].data);
+}
+
+static inline uint8_t ecs_queryMatches(const ECSQuery *const query,
+                                       const ECSCompMask compMask) {
+    return (compMask & query->mask) == query->mask;
+}
+
+static uint8_t ecs_queryGrow(ECSQuery *const query) {
+    const size_t newCap = query->cap ? query->cap * 2 : 64;
+    ECSEntityID *const ent = realloc(query->ent, newCap * sizeof(*ent));
+    if (ent == NULL)
+        return 0;
+    query->ent = ent;
+    for (uint32_t i = 0; i < query->nTypes; i++) {
+        void **const comp = realloc(query->comp[i], newCap * sizeof(*comp));
+        if (comp == NULL)
+            return 0;
+        query->comp[i] = comp;
+    }
+    query->cap = newCap;
+    return 1;
+}
+
+static void ecs_queryAdd(const ECS *const ecs, ECSQuery *const query,
+                         const ECSEntityID id) {
+    const uint32_t index = ECS_ENTITY_INDEX(id);
+    uint32_t i, compType;
+
+    if (index >= query->entPosCap) {
+        size_t newCap = query->entPosCap ? query->entPosCap : 64;
+        while (newCap <= index)
+            newCap *= 2;
+        uint32_t *const entPos =
+            realloc(query->entPos, newCap * sizeof(*entPos));
+        if (entPos == NULL) {
+            logMsg(LOG_LVL_FATAL, "can't grow query %x", query->mask);
+            return;
+        }
+        for (i = query->entPosCap; i < newCap; i++)
+            entPos[i] = ECS_INVALID_ID;
+        query->entPos = entPos;
+        query->entPosCap = newCap;
+    }
+    if (query->nEnt == query->cap && !ecs_queryGrow(query)) {
+        logMsg(LOG_LVL_FATAL, "can't grow query %x", query->mask);
+        return;
+    }
+    query->ent[query->nEnt] = id;
+    for (i = 0; i < query->nTypes; i++) {
+        compType = query->types[i];
+        query->comp[i][query->nEnt] =
+            ecs_poolData(ecs->pool + compType,
+                         ecs_compIndex(ecs, id, compType));
+    }
+    query->entPos[index] = query->nEnt++;
+}
+
+// Remove an entity from the query. The last entity of the query takes its
+// place.
+static void ecs_queryRemove(ECSQuery *const query, const ECSEntityID id) {
+    const uint32_t index = ECS_ENTITY_INDEX(id);
+    const uint32_t pos = query->entPos[index];
+    const uint32_t last = --query->nEnt;
+
+    query->entPos[index] = ECS_INVALID_ID;
+    if (pos == last)
+        return;
+    query->ent[pos] = query->ent[last];
+    for (uint32_t i = 0; i < query->nTypes; i++)
+        query->comp[i][pos] = query->comp[i][last];
+    query->entPos[ECS_ENTITY_INDEX(query->ent[pos])] = pos;
+}
+
+// Update the component pointers of the queries after a component was moved
+static void ecs_queriesReloc(const ECS *const ecs, const ECSEntityID id,
+                             const uint32_t compType, void *const compData) {
+    const ECSCompMask compMask = ecs_entDesc(ecs, id)->compMask;
+    ECSQuery *query;
+    uint32_t pos;
+    for (size_t i = 0; i < ecs->nQuery; i++) {
+        query = ecs->query[i];
+        if ((query->mask & ECS_COMP_MASK(compType)) &&
+            ecs_queryMatches(query, compMask)) {
+            pos = query->entPos[ECS_ENTITY_INDEX(id)];
+            query->comp[query->column[compType]][pos] = compData;
+        }
+    }
+}
+
+// Append an entity ID to an observer list
+static void ecs_observerPush(ECSObserverList *const list,
+                             const ECSEntityID id) {
+    ECSEntityID *ent;
+    if (list->nEnt == list->cap) {
+        const size_t newCap = list->cap ? list->cap * 2 : 64;
+        ent = realloc(list->ent, newCap * sizeof(*ent));
+        if (ent == NULL) {
+            logMsg(LOG_LVL_ERR, "can't grow observer list, dropping id %u",
+                   id);
+            return;
+        }
+        list->ent = ent;
+        list->cap = newCap;
+    }
+    list->ent[list->nEnt++] = id;
+}
+
+static inline void ecs_observeAdd(ECS *const ecs, const uint32_t compType,
+                                  const ECSEntityID id) {
+    ECSCompPool *const pool = ecs->pool + compType;
+    if (pool->observer == NULL)
+        return;
+    ecs_entDesc(ecs, id)->obsPending |= ECS_COMP_MASK(compType);
+    ecs_observerPush(&pool->obsAdded, id);
+}
+
+static inline void ecs_observeRemove(ECS *const ecs, const uint32_t compType,
+                                     const ECSEntityID id) {
+    ECSCompPool *const pool = ecs->pool + compType;
+    ECSEntityDesc *const desc = ecs_entDesc(ecs, id);
+    if (pool->observer == NULL)
+        return;
+    // The observer never heard of components added since the last flush
+    if (desc->obsPending & ECS_COMP_MASK(compType))
+        desc->obsPending &= ~ECS_COMP_MASK(compType);
+    else
+        ecs_observerPush(&pool->obsRemoved, id);
+}
+
+// Tell the queries and the relocation callback that the component at index
+// was moved there
+static inline void ecs_poolNotifyMoved(ECS *const ecs, const uint32_t compType,
+                                       const uint32_t index) {
+    ECSCompPool *const pool = ecs->pool + compType;
+    const ECSEntityID owner = *ecs_poolOwner(pool, index);
+
+    ecs_queriesReloc(ecs, owner, compType, ecs_poolData(pool, index));
+    if (pool->relocCb)
+        pool->relocCb(owner, compType, ecs_poolData(pool, index),
+                      pool->relocUserData);
+}
+
+// Move the component at from to the unused slot to. active tells if the owner
+// is active, i.e. tracked by queries and relocation callbacks.
+static void ecs_poolMove(ECS *const ecs, const uint32_t compType,
+                         const uint32_t from, const uint32_t to,
+                         const uint8_t active) {
+    ECSCompPool *const pool = ecs->pool + compType;
+    const ECSEntityID owner = *ecs_poolOwner(pool, from);
+
+    memcpy(ecs_poolData(pool, to), ecs_poolData(pool, from), pool->elemSize);
+    memcpy(ecs_poolCallbacks(pool, to), ecs_poolCallbacks(pool, from),
+           sizeof(*ecs_poolChunk(pool, 0)->callback));
+    ecs_poolMarkChanged(pool, to, ecs->tick);
+    ecs_poolClearChanged(pool, from);
+    *ecs_poolOwner(pool, to) = owner;
+    ecs_poolSetIndex(pool, owner, to);
+    if (active)
+        ecs_poolNotifyMoved(ecs, compType, to);
+}
+
+// Swap two components of a pool. The one moved to a is active if activeA is
+// set, the one moved to b is parked.
+static void ecs_poolSwap(ECS *const ecs, const uint32_t compType,
+                         const uint32_t a, const uint32_t b,
+                         const uint8_t activeA) {
+    ECSCompPool *const pool = ecs->pool + compType;
+    ECSComponentCallback callbacks[ECS_COMPONENT_CALLBACK_TYPES];
+    const ECSEntityID owner = *ecs_poolOwner(pool, a);
+    ECSComponent data;
+
+    memcpy(data.data, ecs_poolData(pool, a), pool->elemSize);
+    memcpy(callbacks, ecs_poolCallbacks(pool, a), sizeof(callbacks));
+    ecs_poolMove(ecs, compType, b, a, activeA);
+    memcpy(ecs_poolData(pool, b), data.data, pool->elemSize);
+    memcpy(ecs_poolCallbacks(pool, b), callbacks, sizeof(callbacks));
+    ecs_poolMarkChanged(pool, b, ecs->tick);
+    *ecs_poolOwner(pool, b) = owner;
+    ecs_poolSetIndex(pool, owner, b);
+}
+
+// Move count parked components out of the way of count new active ones
+static void ecs_poolMakeRoom(ECS *const ecs, const uint32_t compType,
+                             const size_t count) {
+    ECSCompPool *const pool = ecs->pool + compType;
+    const size_t shift = count > pool->nParked ? count : pool->nParked;
+
+    for (size_t i = 0; i < count && i < pool->nParked; i++)
+        ecs_poolMove(ecs, compType, pool->nComp + i,
+                     pool->nComp + shift + i, 0);
+}
+
+static inline void ecs_poolDropCallbacks(ECSCompPool *const pool,
+                                         const uint32_t index) {
+    const ECSComponentCallback *const callbacks =
+        ecs_poolCallbacks(pool, index);
+    for (uint32_t i = 0; i < ECS_COMPONENT_CALLBACK_TYPES; i++) {
+        if (callbacks[i] != NULL)
+            pool->nInstanceCb[i]--;
+    }
+}
+
+// Remove the component at index from its pool. The last component of the pool
+// is moved in its place, and the last parked one in the place of the latter.
+static void ecs_poolRemove(ECS *const ecs, const uint32_t compType,
+                           const uint32_t index) {
+    ECSCompPool *const pool = ecs->pool + compType;
+    const uint32_t last = pool->nComp - 1;
+
+    ecs_checkStructChange(ecs, 0, ECS_COMP_MASK(compType),
+                          "component unregistered");
+    ecs_poolBumpEpoch(pool);
+    ecs_observeRemove(ecs, compType, *ecs_poolOwner(pool, index));
+    ecs_poolDropCallbacks(pool, index);
+    pool->nComp--;
+    ecs->nComp--;
+    if (index != last)
+        ecs_poolMove(ecs, compType, last, index, 1);
+    else
+        ecs_poolClearChanged(pool, last);
+    if (pool->nParked)
+        ecs_poolMove(ecs, compType, last + pool->nParked, last, 0);
+    ecs_poolShrink(pool);
+}
+
+// Remove the parked component at index from its pool
+static void ecs_poolRemoveParked(ECS *const ecs, const uint32_t compType,
+                                 const uint32_t index) {
+    ECSCompPool *const pool = ecs->pool + compType;
+    const uint32_t last = pool->nComp + pool->nParked - 1;
+
+    ecs_poolBumpEpoch(pool);
+    ecs_poolDropCallbacks(pool, index);
+    pool->nParked--;
+    if (index != last)
+        ecs_poolMove(ecs, compType, last, index, 0);
+    else
+        ecs_poolClearChanged(pool, last);
+    ecs_poolShrink(pool);
+}
+
+// Grow the entity tables to hold newCap entities
+static uint8_t ecs_entGrow(ECS *const ecs, const size_t newCap) {
+    // Tag bitsets cover whole blocks of slots
+    const size_t nTagWords = (newCap + ECS_TAG_BLOCK - 1) / ECS_TAG_BLOCK *
+                             (ECS_TAG_BLOCK / 64);
+    ECSEntityID *activeEnt, *freeBuf;
+    ECSEntityDesc *entDesc;
+    FIFO freeEntId;
+    uint64_t *bits;
+
+    if (newCap > ECS_MAX_ENTITY_SLOTS)
+        return 0;
+    activeEnt = realloc(ecs->activeEnt, newCap * sizeof(*activeEnt));
+    if (activeEnt == NULL)
+        return 0;
+    ecs->activeEnt = activeEnt;
+    entDesc = realloc(ecs->entDesc, newCap * sizeof(*entDesc));
+    if (entDesc == NULL)
+        return 0;
+    ecs->entDesc = entDesc;
+    // Slots handed out later start from the generation left here, which a
+    // snapshot load may have bumped
+    for (size_t i = ecs->entCap; i < newCap; i++)
+        entDesc[i].generation = 0;
+
+    // The free ID FIFO is a ring buffer, so move its content to a new one
+    freeBuf = malloc((newCap + 1) * sizeof(*freeBuf));
+    if (freeBuf == NULL)
+        return 0;
+    fifo_init(&freeEntId, (int32_t *)freeBuf, newCap + 1, FIFO_MODE_NO_OVERRUN);
+    if (ecs->freeEntIdBuf != NULL) {
+        while (fifo_av_read(&ecs->freeEntId))
+            fifo_write(&freeEntId, fifo_read(&ecs->freeEntId));
+        free(ecs->freeEntIdBuf);
+    }
+    ecs->freeEntId = freeEntId;
+    ecs->freeEntIdBuf = freeBuf;
+    ecs->entCap = newCap;
+
+    for (uint32_t tag = 0; tag < ECS_TAG_TYPES; tag++) {
+        if (ecs->tagBits[tag] == NULL)
+            continue;
+        bits = realloc(ecs->tagBits[tag], nTagWords * sizeof(*bits));
+        if (bits == NULL)
+            return 0;
+        memset(bits + ecs->nTagWords, 0,
+               (nTagWords - ecs->nTagWords) * sizeof(*bits));
+        ecs->tagBits[tag] = bits;
+    }
+    ecs->nTagWords = nTagWords;
+    return 1;
+}
+
+// Bitset of a tag, allocated on first use
+static uint64_t *ecs_tagBits(ECS *const ecs, const uint32_t tag) {
+    if (ecs->tagBits[tag] == NULL) {
+        ecs->tagBits[tag] = calloc(ecs->nTagWords, sizeof(uint64_t));
+        if (ecs->tagBits[tag] == NULL)
+            logMsg(LOG_LVL_FATAL, "can't allocate bitset of tag %u", tag);
+        ecs->usedTags |= ECS_TAG_MASK(tag);
+    }
+    return ecs->tagBits[tag];
+}
+
+static ECSTagMask ecs_slotTags(const ECS *const ecs, const uint32_t slot) {
+    ECSTagMask tags = 0;
+    for (uint32_t tag = 0; tag < ECS_TAG_TYPES; tag++) {
+        if ((ecs->usedTags & ECS_TAG_MASK(tag)) &&
+            (ecs->tagBits[tag][slot / 64] >> (slot % 64) & 1))
+            tags |= ECS_TAG_MASK(tag);
+    }
+    return tags;
+}
+
+// Set the tags in set and clear the ones in clear for an entity slot
+static void ecs_slotSetTags(ECS *const ecs, const uint32_t slot,
+                            const ECSTagMask set, const ECSTagMask clear) {
+    const uint64_t bit = (uint64_t)1 << (slot % 64);
+    for (uint32_t tag = 0; tag < ECS_TAG_TYPES; tag++) {
+        if (set & ECS_TAG_MASK(tag))
+            ecs_tagBits(ecs, tag)[slot / 64] |= bit;
+        else if (clear & ecs->usedTags & ECS_TAG_MASK(tag))
+            ecs->tagBits[tag][slot / 64] &= ~bit;
+    }
+}
+
+void ecs_init(ECS *const ecs) { ecs_initReserve(ecs, ECS_DEFAULT_RESERVE); }
+
+// Get the table slot holding a name, or the empty slot where it would go
+static ECSName *ecs_nameSlot(const ECS *const ecs, const char *const name,
+                             const uint32_t hash) {
+    const size_t mask = ecs->nameCap - 1;
+    ECSName *entry;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        entry = ecs->names + i;
+        if (entry->str == NULL ||
+            (entry->hash == hash && strcmp(entry->str, name) == 0))
+            return entry;
+    }
+}
+
+// Double the name table capacity, rehashing all the names
+static uint8_t ecs_nameGrow(ECS *const ecs) {
+    const size_t oldCap = ecs->nameCap;
+    ECSName *const old = ecs->names;
+    size_t i;
+
+    ecs->nameCap = oldCap ? oldCap * 2 : 64;
+    ecs->names = calloc(ecs->nameCap, sizeof(ECSName));
+    if (ecs->names == NULL) {
+        ecs->names = old;
+        ecs->nameCap = oldCap;
+        return 0;
+    }
+    for (i = 0; i < oldCap; i++)
+        if (old[i].str != NULL)
+            *ecs_nameSlot(ecs, old[i].str, old[i].hash) = old[i];
+    free(old);
+    return 1;
+}
+
+// Intern the name of an entity slot and add the slot to the name's list
+static void ecs_nameAttach(ECS *const ecs, const uint32_t index,
+                           const char *const name) {
+    ECSEntityDesc *const desc = ecs->entDesc + index;
+    uint32_t hash;
+    ECSName *entry;
+
+    desc->name = NULL;
+    desc->namePrev = desc->nameNext = ECS_INVALID_ID;
+    if (name == NULL)
+        return;
+    // Keep the load factor under 3/4
+    if ((ecs->nNames + 1) * 4 > ecs->nameCap * 3 && !ecs_nameGrow(ecs)) {
+        logMsg(LOG_LVL_ERR, "can't grow entity name table");
+        return;
+    }
+    hash = str_hash(name);
+    entry = ecs_nameSlot(ecs, name, hash);
+    if (entry->str == NULL) {
+        entry->str = strdup(name);
+        if (entry->str == NULL)
+            return;
+        entry->hash = hash;
+        entry->nEnt = 0;
+        entry->firstEnt = ECS_INVALID_ID;
+        ecs->nNames++;
+    }
+    desc->name = entry->str;
+    desc->nameNext = entry->firstEnt;
+    if (entry->firstEnt != ECS_INVALID_ID)
+        ecs->entDesc[entry->firstEnt].namePrev = index;
+    entry->firstEnt = index;
+    entry->nEnt++;
+}
+
+// Remove an entity slot from its name's list, releasing the name once no
+// entity uses it
+static void ecs_nameDetach(ECS *const ecs, const uint32_t index) {
+    ECSEntityDesc *const desc = ecs->entDesc + index;
+    const size_t mask = ecs->nameCap - 1;
+    ECSName *entry;
+    size_t hole, i, home;
+
+    if (desc->name == NULL)
+        return;
+    entry = ecs_nameSlot(ecs, desc->name, str_hash(desc->name));
+    if (desc->namePrev != ECS_INVALID_ID)
+        ecs->entDesc[desc->namePrev].nameNext = desc->nameNext;
+    else
+        entry->firstEnt = desc->nameNext;
+    if (desc->nameNext != ECS_INVALID_ID)
+        ecs->entDesc[desc->nameNext].namePrev = desc->namePrev;
+    desc->name = NULL;
+    desc->namePrev = desc->nameNext = ECS_INVALID_ID;
+    if (--entry->nEnt)
+        return;
+
+    // Backward shift deletion, so that no tombstones are needed
+    free(entry->str);
+    entry->str = NULL;
+    ecs->nNames--;
+    hole = entry - ecs->names;
+    for (i = (hole + 1) & mask; ecs->names[i].str != NULL; i = (i + 1) & mask) {
+        home = ecs->names[i].hash & mask;
+        // Move the entry if its home slot isn't between the hole and it
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            ecs->names[hole] = ecs->names[i];
+            ecs->names[i].str = NULL;
+            hole = i;
+        }
+    }
+}
+
+void ecs_initReserve(ECS *const ecs, size_t nEntities) {
+    uint32_t i;
     ecs->nActiveEnt = 0;
+    ecs->peakActiveEnt = 0;
+    ecs->nEntIds = 0;
+    ecs->entCap = 0;
+    ecs->freeEntIdBuf = NULL;
+    ecs->activeEnt = NULL;
+    ecs->entDesc = NULL;
+    ecs->nNames = 0;
+    ecs->nameCap = 0;
+    ecs->names = NULL;
+    ecs->nTagWords = 0;
+    memset(ecs->tagBits, 0, sizeof(ecs->tagBits));
+    ecs->usedTags = 0;
+    ecs->nParkedEnt = 0;
+    ecs->nParkLists = 0;
+    ecs->park = NULL;
+    ecs->nComp = 0;
+    ecs->tick = 1;
+    ecs->nReaders = 0;
+    ecs->nQuery = 0;
+    ecs->query = NULL;
+    ecs->jobs = NULL;
+    ecs->sysJobCap = 0;
+    ecs->sysJob = NULL;
+    ecs->nCmdBuf = 1;
+    ecs->cmdBuf = calloc(1, sizeof(ECSCmdBuffer));
+    if (ecs->cmdBuf == NULL)
+        logMsg(LOG_LVL_FATAL, "can't allocate command buffer");
+    ecs->nSnapCb = 0;
+    ecs->snapCbCap = 0;
+    ecs->snapCb = NULL;
     ecs->compTypeStr = NULL;
-    fifo_init(&ecs->freeEntId, ecs->freeEntIdBuf, ECS_MAX_ENTITIES + 1,
-              FIFO_MODE_NO_OVERRUN);
-    fifo_init(&ecs->freeCompId, ecs->freeCompIdBuf, ECS_MAX_COMPONENTS + 1,
-              FIFO_MODE_NO_OVERRUN);
-    for (i = 0; i < ECS_MAX_ENTITIES; i++)
-        fifo_write(&ecs->freeEntId, i);
-    for (i = 0; i < ECS_MAX_COMPONENTS; i++)
-        fifo_write(&ecs->freeCompId, i);
+    if (nEntities == 0)
+        nEntities = 1;
+    if (!ecs_entGrow(ecs, nEntities))
+        logMsg(LOG_LVL_FATAL, "can't reserve %u entities", nEntities);
+    for (i = 0; i < ECS_COMPONENT_TYPES; i++) {
+        ecs->pool[i].elemSize = ECS_COMPONENT_DATA_SIZE;
+        ecs->pool[i].align = 1;
+        ecs->pool[i].nComp = 0;
+        ecs->pool[i].nParked = 0;
+        ecs->pool[i].peakComp = 0;
+        ecs->pool[i].nChunks = 0;
+        ecs->pool[i].chunkCap = 0;
+        ecs->pool[i].chunk = NULL;
+        ecs->pool[i].sparse = NULL;
+        ecs->pool[i].nSparsePages = 0;
+        ecs->pool[i].relocCb = NULL;
+        ecs->pool[i].relocUserData = NULL;
+        ecs->pool[i].snapSave = NULL;
+        ecs->pool[i].snapLoad = NULL;
+        ecs->pool[i].snapUserData = NULL;
+        memset(ecs->pool[i].system, 0, sizeof(ecs->pool[i].system));
+        memset(ecs->pool[i].sysRead, 0, sizeof(ecs->pool[i].sysRead));
+        memset(ecs->pool[i].sysWrite, 0, sizeof(ecs->pool[i].sysWrite));
+        memset(ecs->pool[i].nInstanceCb, 0, sizeof(ecs->pool[i].nInstanceCb));
+        ecs->pool[i].lastChange = 0;
+        ecs->pool[i].readers = 0;
+        ecs->pool[i].epoch = 0;
+        ecs->pool[i].sortDest = NULL;
+        ecs->pool[i].sortCap = 0;
+        ecs->pool[i].sortLen = 0;
+        ecs->pool[i].sortPos = 0;
+        ecs->pool[i].sortEpoch = 0;
+        ecs->pool[i].sortKey = NULL;
+        ecs->pool[i].observer = NULL;
+        ecs->pool[i].observerUserData = NULL;
+        memset(&ecs->pool[i].obsAdded, 0, sizeof(ECSObserverList));
+        memset(&ecs->pool[i].obsRemoved, 0, sizeof(ECSObserverList));
+    }
+}
+
+void ecs_free(ECS *const ecs) {
+    uint32_t i, j;
+    for (i = 0; i < ecs->nQuery; i++) {
+        for (j = 0; j < ecs->query[i]->nTypes; j++)
+            free(ecs->query[i]->comp[j]);
+        free(ecs->query[i]->ent);
+        free(ecs->query[i]->entPos);
+        free(ecs->query[i]);
+    }
+    free(ecs->query);
+    ecs->query = NULL;
+    ecs->nQuery = 0;
+    free(ecs->sysJob);
+    ecs->sysJob = NULL;
+    ecs->sysJobCap = 0;
+    for (i = 0; i < ecs->nCmdBuf; i++) {
+        free(ecs->cmdBuf[i].cmd);
+        free(ecs->cmdBuf[i].data);
+        free(ecs->cmdBuf[i].newEnt);
+    }
+    free(ecs->cmdBuf);
+    ecs->cmdBuf = NULL;
+    ecs->nCmdBuf = 0;
+    for (i = 0; i < ECS_COMPONENT_TYPES; i++) {
+        while (ecs->pool[i].nChunks)
+            free(ecs->pool[i].chunk[--ecs->pool[i].nChunks].data);
+        free(ecs->pool[i].chunk);
+        ecs->pool[i].chunk = NULL;
+        ecs->pool[i].chunkCap = 0;
+        ecs->pool[i].nComp = 0;
+        ecs->pool[i].nParked = 0;
+        ecs_poolFreeIndex(ecs->pool + i);
+        free(ecs->pool[i].sortDest);
+        ecs->pool[i].sortDest = NULL;
+        ecs->pool[i].sortCap = 0;
+        ecs->pool[i].sortLen = 0;
+        free(ecs->pool[i].obsAdded.ent);
+        free(ecs->pool[i].obsRemoved.ent);
+        memset(&ecs->pool[i].obsAdded, 0, sizeof(ECSObserverList));
+        memset(&ecs->pool[i].obsRemoved, 0, sizeof(ECSObserverList));
+    }
+    for (i = 0; i < ecs->nParkLists; i++)
+        free(ecs->park[i].slot);
+    free(ecs->park);
+    ecs->park = NULL;
+    ecs->nParkLists = 0;
+    ecs->nParkedEnt = 0;
+    for (i = 0; i < ecs->nameCap; i++)
+        free(ecs->names[i].str);
+    free(ecs->names);
+    ecs->names = NULL;
+    ecs->nameCap = 0;
+    ecs->nNames = 0;
+    for (i = 0; i < ECS_TAG_TYPES; i++) {
+        free(ecs->tagBits[i]);
+        ecs->tagBits[i] = NULL;
+    }
+    ecs->nTagWords = 0;
+    ecs->usedTags = 0;
+    free(ecs->snapCb);
+    ecs->snapCb = NULL;
+    ecs->nSnapCb = 0;
+    ecs->snapCbCap = 0;
+    free(ecs->freeEntIdBuf);
+    free(ecs->activeEnt);
+    free(ecs->entDesc);
+    ecs->freeEntIdBuf = NULL;
+    ecs->activeEnt = NULL;
+    ecs->entDesc = NULL;
+    ecs->nActiveEnt = 0;
+    ecs->nEntIds = 0;
+    ecs->entCap = 0;
+    ecs->nComp = 0;
 }
 
 void ecs_status(const ECS *const ecs, uint32_t *const nUsedEntities,
@@ -75,67 +854,352 @@ void ecs_status(const ECS *const ecs, uint32_t *const nUsedEntities,
     if (nUsedEntities)
         *nUsedEntities = ecs->nActiveEnt;
     if (nUsedComp)
-        *nUsedComp = fifo_av_write(&ecs->freeCompId);
+        *nUsedComp = ecs->nComp;
 }
 
-ECSStatus ecs_registerEntity(ECS *const ecs, ECSEntityID *const id_out,
-                             const char *const name) {
-    ECSEntityID id = ECS_INVALID_ID;
-    if (!fifo_av_read(&ecs->freeEntId)) {
-        *id_out = id;
-        logMsg(LOG_LVL_WARN, "entity buffer full");
-        return ECS_RES_ENTITY_BUFF_FULL;
+static void ecs_poolStats(const ECSCompPool *const pool,
+                          ECSCompStats *const out) {
+    size_t dataSize, ownerSize, cbSize, i;
+    const size_t chunkBytes =
+        ecs_chunkBytes(pool, &dataSize, &ownerSize, &cbSize);
+    const size_t slotBytes =
+        pool->elemSize + sizeof(ECSEntityID) +
+        sizeof(ECSComponentCallback) * ECS_COMPONENT_CALLBACK_TYPES +
+        sizeof(uint32_t);
+
+    out->nComp = pool->nComp;
+    out->nParked = pool->nParked;
+    out->peakComp = pool->peakComp;
+    out->capacity = pool->nChunks * ECS_POOL_CHUNK_SIZE;
+    out->elemSize = pool->elemSize;
+    out->bytesUsed = (pool->nComp + pool->nParked) * slotBytes;
+    out->bytesReserved =
+        pool->nChunks * chunkBytes + pool->chunkCap * sizeof(ECSCompChunk) +
+        pool->nSparsePages * sizeof(*pool->sparse) +
+        (pool->obsAdded.cap + pool->obsRemoved.cap) * sizeof(ECSEntityID) +
+        pool->sortCap * sizeof(*pool->sortDest);
+    out->nSparsePages = 0;
+    for (i = 0; i < pool->nSparsePages; i++) {
+        if (pool->sparse[i] == NULL)
+            continue;
+        out->nSparsePages++;
+        out->bytesReserved += ECS_SPARSE_PAGE_SIZE * sizeof(uint32_t);
+    }
+    out->nSystems = 0;
+    for (i = 0; i < ECS_COMPONENT_CALLBACK_TYPES; i++) {
+        out->nSystems += pool->system[i] != NULL;
+        out->nInstanceCb[i] = pool->nInstanceCb[i];
+    }
+}
+
+void ecs_getStats(const ECS *const ecs, ECSStats *const out) {
+    size_t i, maxSlot = 0, pos;
+    uint32_t slot;
+
+    out->nActiveEnt = ecs->nActiveEnt;
+    out->peakActiveEnt = ecs->peakActiveEnt;
+    out->nEntIds = ecs->nEntIds;
+    out->entCap = ecs->entCap;
+    out->nFreeEnt = fifo_av_read(&ecs->freeEntId);
+    out->nParkedEnt = ecs->nParkedEnt;
+
+    // Free slots only fragment the entity tables below the highest active one
+    for (i = 0; i < ecs->nActiveEnt; i++) {
+        slot = ECS_ENTITY_INDEX(ecs->activeEnt[i]);
+        if (slot + 1 > maxSlot)
+            maxSlot = slot + 1;
+    }
+    out->nFreeHoles = 0;
+    pos = ecs->freeEntId.r_pos;
+    for (i = 0; i < out->nFreeEnt; i++) {
+        if (++pos == ecs->freeEntId.size)
+            pos = 0;
+        out->nFreeHoles += (uint32_t)ecs->freeEntId.buf[pos] < maxSlot;
+    }
+    out->fragmentation = maxSlot ? (float)out->nFreeHoles / maxSlot : 0.0f;
+
+    out->entBytes =
+        ecs->entCap * (sizeof(ECSEntityDesc) + sizeof(ECSEntityID)) +
+        (ecs->entCap + 1) * sizeof(ECSEntityID) +
+        ecs->nParkLists * sizeof(ECSParkList);
+    for (i = 0; i < ecs->nParkLists; i++)
+        out->entBytes += ecs->park[i].cap * sizeof(uint32_t);
+    for (i = 0; i < ECS_TAG_TYPES; i++)
+        if (ecs->tagBits[i] != NULL)
+            out->entBytes += ecs->nTagWords * sizeof(uint64_t);
+
+    out->nNames = ecs->nNames;
+    out->nameBytes = ecs->nameCap * sizeof(ECSName);
+    for (i = 0; i < ecs->nameCap; i++)
+        if (ecs->names[i].str != NULL)
+            out->nameBytes += strlen(ecs->names[i].str) + 1;
+
+    out->nQuery = ecs->nQuery;
+    out->queryBytes = ecs->nQuery * sizeof(ECSQuery *);
+    for (i = 0; i < ecs->nQuery; i++) {
+        const ECSQuery *const query = ecs->query[i];
+        out->queryBytes += sizeof(ECSQuery) +
+                           query->cap * (sizeof(ECSEntityID) +
+                                         query->nTypes * sizeof(void *)) +
+                           query->entPosCap * sizeof(uint32_t);
+    }
+
+    out->cmdBytes = ecs->nCmdBuf * sizeof(ECSCmdBuffer) +
+                    ecs->sysJobCap * sizeof(ECSSystemJob);
+    for (i = 0; i < ecs->nCmdBuf; i++)
+        out->cmdBytes += ecs->cmdBuf[i].cmdCap * sizeof(ECSCmd) +
+                         ecs->cmdBuf[i].dataCap +
+                         ecs->cmdBuf[i].newEntCap * sizeof(ECSEntityID);
+
+    out->totalBytes = sizeof(ECS) + out->entBytes + out->nameBytes +
+                      out->queryBytes + out->cmdBytes;
+    for (i = 0; i < ECS_COMPONENT_TYPES; i++) {
+        ecs_poolStats(ecs->pool + i, out->comp + i);
+        out->totalBytes += out->comp[i].bytesReserved;
+    }
+}
+
+ECSStatus ecs_dumpStats(const ECS *const ecs, FILE *const file) {
+    ECSStats stats;
+    const ECSCompStats *comp;
+    uint32_t compType, cbType;
+
+    ecs_getStats(ecs, &stats);
+    fprintf(file,
+            "{\n"
+            "  \"entities\": {\"active\": %zu, \"peak\": %zu, "
+            "\"handedOut\": %zu, \"capacity\": %zu, \"free\": %zu, "
+            "\"parked\": %zu, \"freeHoles\": %zu, "
+            "\"fragmentation\": %.4f, \"bytes\": %zu},\n"
+            "  \"names\": {\"count\": %zu, \"bytes\": %zu},\n"
+            "  \"queries\": {\"count\": %zu, \"bytes\": %zu},\n"
+            "  \"cmdBytes\": %zu,\n"
+            "  \"totalBytes\": %zu,\n"
+            "  \"components\": [",
+            stats.nActiveEnt, stats.peakActiveEnt, stats.nEntIds, stats.entCap,
+            stats.nFreeEnt, stats.nParkedEnt, stats.nFreeHoles,
+            stats.fragmentation, stats.entBytes, stats.nNames, stats.nameBytes,
+            stats.nQuery, stats.queryBytes, stats.cmdBytes, stats.totalBytes);
+    for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        comp = stats.comp + compType;
+        fprintf(file, "%s\n    {\"type\": %u", compType ? "," : "",
+                compType);
+        if (ecs->compTypeStr != NULL)
+            fprintf(file, ", \"name\": \"%s\"", ecs->compTypeStr[compType]);
+        fprintf(file,
+                ", \"count\": %zu, \"parked\": %zu, \"peak\": %zu, "
+                "\"capacity\": %zu, \"elemSize\": %zu, \"bytesUsed\": %zu, "
+                "\"bytesReserved\": %zu, \"sparsePages\": %zu, "
+                "\"systems\": %u, \"instanceCallbacks\": [",
+                comp->nComp, comp->nParked, comp->peakComp, comp->capacity,
+                comp->elemSize, comp->bytesUsed, comp->bytesReserved,
+                comp->nSparsePages, comp->nSystems);
+        for (cbType = 0; cbType < ECS_COMPONENT_CALLBACK_TYPES; cbType++)
+            fprintf(file, "%s%u", cbType ? ", " : "",
+                    comp->nInstanceCb[cbType]);
+        fprintf(file, "]}");
+    }
+    if (fprintf(file, "\n  ]\n}\n") < 0 || ferror(file)) {
+        logMsg(LOG_LVL_ERR, "can't write ECS stats");
+        return ECS_RES_INVALID_PARAMS;
+    }
+    return ECS_RES_OK;
+}
+
+ECSStatus ecs_setCompTypeSize(ECS *const ecs, const uint32_t compType,
+                              const size_t size) {
+    return ecs_setCompTypeLayout(ecs, compType, size, 1);
+}
+
+ECSStatus ecs_setCompTypeLayout(ECS *const ecs, const uint32_t compType,
+                                const size_t size, const size_t align) {
+    if (!ecs_checkCompType(compType))
+        return ECS_RES_INVALID_PARAMS;
+    if (align == 0 || (align & (align - 1))) {
+        logMsg(LOG_LVL_ERR, "invalid alignment for comp. type %u: %u",
+               compType, align);
+        return ECS_RES_INVALID_PARAMS;
+    }
+    const size_t elemSize = (size + align - 1) & ~(align - 1);
+    if (size == 0 || elemSize > ECS_COMPONENT_DATA_SIZE) {
+        logMsg(LOG_LVL_ERR, "invalid size for comp. type %u: %u", compType,
+               size);
+        return ECS_RES_INVALID_PARAMS;
+    }
+    if (ecs->pool[compType].nChunks != 0) {
+        logMsg(LOG_LVL_ERR, "comp. type %u already in use", compType);
+        return ECS_RES_INVALID_PARAMS;
     }
-    id = fifo_read(&ecs->freeEntId);
-    insertsort_u32Inc(ecs->activeEnt, ecs->nActiveEnt++, id);
-    ecs->entDesc[id].name = name;
+    ecs->pool[compType].elemSize = elemSize;
+    ecs->pool[compType].align = align;
+    return ECS_RES_OK;
+}
+
+ECSStatus ecs_setCompRelocCallback(ECS *const ecs, const uint32_t compType,
+                                   ECSCompRelocCallback cb,
+                                   void *const userData) {
+    if (!ecs_checkCompType(compType))
+        return ECS_RES_INVALID_PARAMS;
+    ecs->pool[compType].relocCb = cb;
+    ecs->pool[compType].relocUserData = userData;
+    return ECS_RES_OK;
+}
+
+ECSStatus ecs_setCompSnapshotHooks(ECS *const ecs, const uint32_t compType,
+                                   ECSSnapshotHook save, ECSSnapshotHook load,
+                                   void *const userData) {
+    if (!ecs_checkCompType(compType))
+        return ECS_RES_INVALID_PARAMS;
+    ecs->pool[compType].snapSave = save;
+    ecs->pool[compType].snapLoad = load;
+    ecs->pool[compType].snapUserData = userData;
+    return ECS_RES_OK;
+}
+
+ECSStatus ecs_setCompObserver(ECS *const ecs, const uint32_t compType,
+                              ECSObserverCallback cb, void *const userData) {
+    if (!ecs_checkCompType(compType))
+        return ECS_RES_INVALID_PARAMS;
+    ecs->pool[compType].observer = cb;
+    ecs->pool[compType].observerUserData = userData;
+    return ECS_RES_OK;
+}
 
-    /*printf("Active entities: ");
-    for(uint32_t i = 0; i < ecs->nActiveEnt; i++)
-        printf("%u ", ecs->activeEnt[i]);
-    printf("\n");*/
+void ecs_flushObservers(ECS *const ecs) {
+    ECSCompPool *pool;
+    ECSEntityDesc *desc;
+    ECSEntityID id;
+    size_t i, nAdded;
+
+    for (uint32_t compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        pool = ecs->pool + compType;
+        if (pool->obsAdded.nEnt == 0 && pool->obsRemoved.nEnt == 0)
+            continue;
+        // Keep the first occurrence of the entities that still have the
+        // component
+        nAdded = 0;
+        for (i = 0; i < pool->obsAdded.nEnt; i++) {
+            id = pool->obsAdded.ent[i];
+            if (!ecs_idAlive(ecs, id))
+                continue;
+            desc = ecs_entDesc(ecs, id);
+            if (!(desc->obsPending & ECS_COMP_MASK(compType)))
+                continue;
+            desc->obsPending &= ~ECS_COMP_MASK(compType);
+            pool->obsAdded.ent[nAdded++] = id;
+        }
+        if (pool->observer != NULL && (nAdded || pool->obsRemoved.nEnt))
+            pool->observer(compType, pool->obsRemoved.ent,
+                           pool->obsRemoved.nEnt, pool->obsAdded.ent, nAdded,
+                           pool->observerUserData);
+        pool->obsAdded.nEnt = 0;
+        pool->obsRemoved.nEnt = 0;
+    }
+}
 
-    for (uint32_t i = 0; i < ECS_COMPONENT_TYPES; i++)
-        ecs->entDesc[id].compIndex[i] = ECS_INVALID_ID;
+// Take an entity slot and make it active. The entity tables must have room for
+// it.
+static ECSEntityID ecs_entityAlloc(ECS *const ecs, const char *const name) {
+    ECSEntityDesc *desc;
+    ECSEntityID id;
+    if (ecs->nEntIds < ecs->entCap) {
+        desc = ecs->entDesc + ecs->nEntIds;
+        id = ECS_ENTITY_ID(ecs->nEntIds, desc->generation);
+        ecs->nEntIds++;
+    } else {
+        const uint32_t index = fifo_read(&ecs->freeEntId);
+        desc = ecs->entDesc + index;
+        id = ECS_ENTITY_ID(index, desc->generation);
+    }
+    desc->activePos = ecs->nActiveEnt;
+    ecs->activeEnt[ecs->nActiveEnt++] = id;
+    if (ecs->nActiveEnt > ecs->peakActiveEnt)
+        ecs->peakActiveEnt = ecs->nActiveEnt;
+    ecs_nameAttach(ecs, ECS_ENTITY_INDEX(id), name);
+    desc->compMask = 0;
+    desc->obsPending = 0;
+    return id;
+}
 
+ECSStatus ecs_registerEntity(ECS *const ecs, ECSEntityID *const id_out,
+                             const char *const name) {
+    ECSEntityID id = ECS_INVALID_ID;
+    ecs_checkStructChange(ecs, 1, 0, "entity registered");
+    // Hand out fresh IDs before reusing freed ones, and only grow the entity
+    // tables once both are exhausted
+    if (ecs->nEntIds == ecs->entCap && !fifo_av_read(&ecs->freeEntId)) {
+        size_t newCap = ecs->entCap * 2;
+        if (newCap > ECS_MAX_ENTITY_SLOTS)
+            newCap = ECS_MAX_ENTITY_SLOTS;
+        if (newCap == ecs->entCap || !ecs_entGrow(ecs, newCap)) {
+            *id_out = id;
+            logMsg(LOG_LVL_WARN, "entity buffer full");
+            return ECS_RES_ENTITY_BUFF_FULL;
+        }
+    }
+    id = ecs_entityAlloc(ecs, name);
     *id_out = id;
     logMsg(LOG_LVL_INFO, "registered entity %u/%u (\"%s\")", id,
-           ECS_MAX_ENTITIES - 1, name);
+           ecs->entCap - 1, name);
     return ECS_RES_OK;
 }
 
 ECSStatus ecs_registerComp(ECS *const ecs, const ECSEntityID id,
                            const uint32_t compType, const ECSComponent comp) {
-    ECSEntityDesc *const desc = ecs->entDesc + id;
-    if (!ecs_checkCompType(compType) || !ecs_checkEntityID(id))
+    return ecs_registerCompData(ecs, id, compType, comp.data);
+}
+
+ECSStatus ecs_registerCompData(ECS *const ecs, const ECSEntityID id,
+                               const uint32_t compType,
+                               const void *const data) {
+    if (!ecs_checkCompType(compType) || !ecs_checkEntityID(ecs, id))
         return ECS_RES_INVALID_PARAMS;
 
+    ECSEntityDesc *const desc = ecs_entDesc(ecs, id);
     if (!ecs_checkEntityExists(ecs, id))
         return ECS_RES_ENTITY_NOT_FOUND;
-    if (!fifo_av_read(&ecs->freeCompId)) {
-        logMsg(LOG_LVL_ERR, "component buffer full");
-        return ECS_RES_COMP_BUFF_FULL;
-    }
-    if (desc->compIndex[compType] != ECS_INVALID_ID) {
+    if (desc->compMask & ECS_COMP_MASK(compType)) {
         logMsg(LOG_LVL_ERR, "duplicate component");
         return ECS_RES_COMP_DUPLICATE;
     }
-    const uint32_t compId = fifo_read(&ecs->freeCompId);
-    ecs->comp[compId] = comp;
-    for (uint32_t i = 0; i < ECS_COMPONENT_CALLBACK_TYPES; i++)
-        ecs->comp[compId].callback[i] = 0;
-    desc->compIndex[compType] = compId;
+    ECSCompPool *const pool = ecs->pool + compType;
+    ecs_checkStructChange(ecs, 0, ECS_COMP_MASK(compType),
+                          "component registered");
+    if (pool->nComp + pool->nParked == pool->nChunks * ECS_POOL_CHUNK_SIZE &&
+        !ecs_poolGrow(pool)) {
+        logMsg(LOG_LVL_ERR, "can't grow pool of comp. type %u", compType);
+        return ECS_RES_COMP_BUFF_FULL;
+    }
+    ecs_poolBumpEpoch(pool);
+    ecs_poolMakeRoom(ecs, compType, 1);
+    const uint32_t compId = pool->nComp++;
+    ecs->nComp++;
+    if (pool->nComp > pool->peakComp)
+        pool->peakComp = pool->nComp;
+    memcpy(ecs_poolData(pool, compId), data, pool->elemSize);
+    memset(ecs_poolCallbacks(pool, compId), 0,
+           sizeof(*ecs_poolChunk(pool, compId)->callback));
+    ecs_poolMarkChanged(pool, compId, ecs->tick);
+    *ecs_poolOwner(pool, compId) = id;
+    ecs_poolSetIndex(pool, id, compId);
+    desc->compMask |= ECS_COMP_MASK(compType);
+    ecs_observeAdd(ecs, compType, id);
+    for (size_t i = 0; i < ecs->nQuery; i++) {
+        if ((ecs->query[i]->mask & ECS_COMP_MASK(compType)) &&
+            ecs_queryMatches(ecs->query[i], desc->compMask))
+            ecs_queryAdd(ecs, ecs->query[i], id);
+    }
 
     if (ecs->compTypeStr == NULL) {
         logMsg(LOG_LVL_INFO,
                "registered comp. %u/%u of type %u to entity id %u (\"%s\")",
-               compId, ECS_MAX_COMPONENTS - 1, compType, id,
+               compId, pool->nChunks * ECS_POOL_CHUNK_SIZE - 1, compType, id,
                ecs_getEntityNameCstrP(ecs, id));
     } else {
         logMsg(LOG_LVL_INFO,
                "registered comp. %u/%u of type %d(\"%s\") to entity id %u "
                "(\"%s\")",
-               compId, ECS_MAX_COMPONENTS - 1, compType,
+               compId, pool->nChunks * ECS_POOL_CHUNK_SIZE - 1, compType,
                ecs->compTypeStr[compType], id, ecs_getEntityNameCstrP(ecs, id));
     }
     return ECS_RES_OK;
@@ -143,18 +1207,23 @@ ECSStatus ecs_registerComp(ECS *const ecs, const ECSEntityID id,
 
 ECSStatus ecs_unregisterComp(ECS *const ecs, const ECSEntityID id,
                              const uint32_t compType) {
-    ECSEntityDesc *const desc = ecs->entDesc + id;
-
-    if (!ecs_checkCompType(compType) || !ecs_checkEntityID(id))
+    if (!ecs_checkCompType(compType) || !ecs_checkEntityID(ecs, id))
         return ECS_RES_INVALID_PARAMS;
 
+    ECSEntityDesc *const desc = ecs_entDesc(ecs, id);
     if (!ecs_checkEntityExists(ecs, id))
         return ECS_RES_ENTITY_NOT_FOUND;
-    uint32_t *const compId = desc->compIndex + compType;
-    if (!ecs_checkComponentID(*compId))
+    const uint32_t compId = ecs_compIndex(ecs, id, compType);
+    if (!ecs_checkComponentID(ecs->pool + compType, compId))
         return ECS_RES_COMP_NOT_FOUND;
-    fifo_write(&ecs->freeCompId, *compId);
-    *compId = ECS_INVALID_ID;
+    for (size_t i = 0; i < ecs->nQuery; i++) {
+        if ((ecs->query[i]->mask & ECS_COMP_MASK(compType)) &&
+            ecs_queryMatches(ecs->query[i], desc->compMask))
+            ecs_queryRemove(ecs->query[i], id);
+    }
+    desc->compMask &= ~ECS_COMP_MASK(compType);
+    ecs_poolSetIndex(ecs->pool + compType, id, ECS_INVALID_ID);
+    ecs_poolRemove(ecs, compType, compId);
 
     logMsg(LOG_LVL_INFO,
            "unregistered comp. %u of type %u from entity id %u(\"%s\")", compId,
@@ -162,94 +1231,314 @@ ECSStatus ecs_unregisterComp(ECS *const ecs, const ECSEntityID id,
     return ECS_RES_OK;
 }
 
-ECSStatus ecs_getComp(ECS *const ecs, const ECSEntityID id,
-                      const uint32_t compType, ECSComponent **const comp) {
-    const ECSEntityDesc *const desc = ecs->entDesc + id;
-    *comp = 0;
-    if (!ecs_checkCompType(compType) || !ecs_checkEntityID(id))
-        return ECS_RES_INVALID_PARAMS;
-
-    if (!ecs_checkEntityExists(ecs, id))
-        return ECS_RES_ENTITY_NOT_FOUND;
-    const uint32_t *const compId = desc->compIndex + compType;
-
-    if (!ecs_checkComponentID(*compId))
-        return ECS_RES_COMP_NOT_FOUND;
-    *comp = ecs->comp + *compId;
-    return ECS_RES_OK;
-}
-
 ECSStatus ecs_getCompData(ECS *ecs, const ECSEntityID id,
                           const uint32_t compType, void **const data) {
-    ECSComponent *comp;
-    const ECSStatus stat = ecs_getComp(ecs, id, compType, &comp);
+    ECSComponentID compId;
+    const ECSStatus stat = ecs_getCompID(ecs, id, compType, &compId);
     if (stat != ECS_RES_OK) {
         *data = 0;
         return stat;
     }
-    *data = comp->data;
+    *data = ecs_poolData(ecs->pool + compType, compId);
     return ECS_RES_OK;
 }
 
 ECSStatus ecs_getCompID(const ECS *ecs, const ECSEntityID id,
                         const uint32_t compType, ECSComponentID *const out) {
-    const ECSEntityDesc *const desc = ecs->entDesc + id;
     *out = ECS_INVALID_ID;
-    if (!ecs_checkCompType(compType) || !ecs_checkEntityID(id))
+    if (!ecs_checkCompType(compType) || !ecs_checkEntityID(ecs, id))
         return ECS_RES_INVALID_PARAMS;
 
     if (!ecs_checkEntityExists(ecs, id))
         return ECS_RES_ENTITY_NOT_FOUND;
-    const uint32_t *const compId = desc->compIndex + compType;
+    const uint32_t compId = ecs_compIndex(ecs, id, compType);
 
-    if (!ecs_checkComponentID(*compId))
+    if (!ecs_checkComponentID(ecs->pool + compType, compId))
         return ECS_RES_COMP_NOT_FOUND;
-    *out = *compId;
+    *out = compId;
     return ECS_RES_OK;
 }
 
-ECSStatus ecs_unregisterEntity(ECS *const ecs, const ECSEntityID id) {
-    uint32_t targetEntPos, i, *pComp;
-    ECSEntityDesc *const desc = ecs->entDesc + id;
+void *ecs_getCompDataByID(const ECS *const ecs, const uint32_t compType,
+                          const ECSComponentID compId) {
+    if (!ecs_checkCompType(compType) ||
+        !ecs_checkComponentID(ecs->pool + compType, compId))
+        return NULL;
+    return ecs_poolData(ecs->pool + compType, compId);
+}
 
-    if (!ecs_checkEntityID(id))
-        return ECS_RES_INVALID_PARAMS;
+void *ecs_getCompChunk(const ECS *const ecs, const uint32_t compType,
+                       const size_t chunk, size_t *const count,
+                       const ECSEntityID **const owners) {
+    const ECSCompPool *const pool = ecs->pool + compType;
+    size_t n = 0;
+    if (ecs_checkCompType(compType) &&
+        chunk * ECS_POOL_CHUNK_SIZE < pool->nComp) {
+        n = pool->nComp - chunk * ECS_POOL_CHUNK_SIZE;
+        if (n > ECS_POOL_CHUNK_SIZE)
+            n = ECS_POOL_CHUNK_SIZE;
+    }
+    if (count)
+        *count = n;
+    if (owners)
+        *owners = n ? pool->chunk[chunk].owner : NULL;
+    return n ? pool->chunk[chunk].data : NULL;
+}
 
-    if (!binsearch_s32Inc(ecs->activeEnt, ecs->nActiveEnt, id, &targetEntPos)) {
-        logMsg(LOG_LVL_ERR, "entity ID %u not found", id);
+// Compute the destination of each component of a pool sorted by key
+static uint8_t ecs_sortPermutation(ECS *const ecs, const uint32_t compType,
+                                   ECSSortKeyCallback key,
+                                   void *const userData) {
+    ECSCompPool *const pool = ecs->pool + compType;
+    SortPairU64 *entry;
+    uint32_t *dest;
+    size_t cap = pool->sortCap ? pool->sortCap : 64;
+    uint32_t i;
+
+    if (pool->nComp > pool->sortCap) {
+        while (cap < pool->nComp)
+            cap *= 2;
+        dest = realloc(pool->sortDest, cap * sizeof(*dest));
+        if (dest == NULL)
+            return 0;
+        pool->sortDest = dest;
+        pool->sortCap = cap;
+    }
+    entry = malloc(pool->nComp * 2 * sizeof(*entry));
+    if (entry == NULL)
         return 0;
+    for (i = 0; i < pool->nComp; i++) {
+        const ECSEntityID owner = *ecs_poolOwner(pool, i);
+        entry[i].key = key ? key(compType, i, owner, ecs_poolData(pool, i),
+                                 userData)
+                           : ECS_ENTITY_INDEX(owner);
+        entry[i].val = i;
     }
+    // The radix sort is stable, so equal keys keep their current order
+    sort_radixU64(entry, pool->nComp, entry + pool->nComp, 0);
+    for (i = 0; i < pool->nComp; i++)
+        pool->sortDest[entry[i].val] = i;
+    free(entry);
+    pool->sortLen = pool->nComp;
+    pool->sortPos = 0;
+    pool->sortKey = key;
+    return 1;
+}
 
-    const char *const entName = ecs_getEntityNameCstrP(ecs, id);
+size_t ecs_sortComp(ECS *const ecs, const uint32_t compType,
+                    ECSSortKeyCallback key, void *const userData,
+                    const size_t maxSwaps) {
+    ECSCompPool *const pool = ecs->pool + compType;
+    uint32_t *dest;
+    uint32_t i, j, tmp;
+    size_t nSwaps = 0;
 
-    // Unregister its components
-    for (i = 0, pComp = desc->compIndex; i < ECS_COMPONENT_TYPES;
-         i++, pComp++) {
-        if (*pComp != ECS_INVALID_ID) {
-            fifo_write(&ecs->freeCompId, *pComp);
-            *pComp = ECS_INVALID_ID;
+    if (!ecs_checkCompType(compType) || pool->nComp < 2)
+        return 0;
+    ecs_checkStructChange(ecs, 0, ECS_COMP_MASK(compType),
+                          "components sorted");
+    // Resume the order of the previous call if the pool didn't change since
+    if ((pool->sortLen == 0 || pool->sortEpoch != pool->epoch ||
+         pool->sortKey != key) &&
+        !ecs_sortPermutation(ecs, compType, key, userData)) {
+        logMsg(LOG_LVL_ERR, "can't allocate sort keys of comp. type %u",
+               compType);
+        pool->sortLen = 0;
+        return 0;
+    }
+    dest = pool->sortDest;
+
+    // Walk the permutation cycles, every swap puts the component at j in place
+    for (i = pool->sortPos; i < pool->sortLen; i++) {
+        while (dest[i] != i && (maxSwaps == 0 || nSwaps < maxSwaps)) {
+            j = dest[i];
+            ecs_poolSwap(ecs, compType, i, j, 1);
+            ecs_poolNotifyMoved(ecs, compType, j);
+            tmp = dest[i];
+            dest[i] = dest[j];
+            dest[j] = tmp;
+            nSwaps++;
         }
+        if (dest[i] != i)
+            break;
     }
+    pool->sortPos = i;
+    if (i == pool->sortLen)
+        pool->sortLen = 0;
+    if (nSwaps)
+        ecs_poolBumpEpoch(pool);
+    pool->sortEpoch = pool->epoch;
+    return nSwaps;
+}
 
-    // Unregister entity
-    fifo_write(&ecs->freeEntId, id);
-    for (i = targetEntPos; i < ecs->nActiveEnt - 1; i++)
-        ecs->activeEnt[i] = ecs->activeEnt[i + 1];
-    ecs->nActiveEnt--;
+void ecs_sortReset(ECS *const ecs, ECSSortKeyCallback key) {
+    for (uint32_t i = 0; i < ECS_COMPONENT_TYPES; i++) {
+        if (ecs->pool[i].sortKey == key)
+            ecs->pool[i].sortLen = 0;
+    }
+}
+
+uint32_t ecs_getTick(const ECS *const ecs) { return ecs->tick; }
+
+void ecs_advanceTick(ECS *const ecs) {
+    ECSCompPool *pool;
+    size_t chunk;
+
+    for (uint32_t compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        pool = ecs->pool + compType;
+        if (pool->lastChange != ecs->tick)
+            continue;
+        for (chunk = 0; chunk < pool->nChunks; chunk++) {
+            if (pool->chunk[chunk].lastChange == ecs->tick)
+                memset(pool->chunk[chunk].changed, 0,
+                       sizeof(pool->chunk[chunk].changed));
+        }
+    }
+    ecs->tick++;
+}
+
+ECSStatus ecs_markChanged(ECS *const ecs, const ECSEntityID id,
+                          const uint32_t compType) {
+    if (!ecs_checkCompType(compType) || !ecs_checkEntityID(ecs, id))
+        return ECS_RES_INVALID_PARAMS;
+    if (!ecs_checkEntityExists(ecs, id))
+        return ECS_RES_ENTITY_NOT_FOUND;
+    const uint32_t compId = ecs_compIndex(ecs, id, compType);
+    if (compId == ECS_INVALID_ID)
+        return ECS_RES_COMP_NOT_FOUND;
+    ecs_poolMarkChanged(ecs->pool + compType, compId, ecs->tick);
+    return ECS_RES_OK;
+}
+
+void ecs_markChangedByID(ECS *const ecs, const uint32_t compType,
+                         const ECSComponentID compId) {
+    if (!ecs_checkCompType(compType) ||
+        !ecs_checkComponentID(ecs->pool + compType, compId))
+        return;
+    ecs_poolMarkChanged(ecs->pool + compType, compId, ecs->tick);
+}
+
+uint32_t ecs_getChangeTickByID(const ECS *const ecs, const uint32_t compType,
+                               const ECSComponentID compId) {
+    const uint32_t *tick;
+    if (!ecs_checkCompType(compType) ||
+        !ecs_checkComponentID(ecs->pool + compType, compId))
+        return 0;
+    tick = ecs_poolChunk(ecs->pool + compType, compId)->changeTick +
+           compId % ECS_POOL_CHUNK_SIZE;
+    return __atomic_load_n(tick, __ATOMIC_RELAXED);
+}
+
+const uint64_t *ecs_getCompChunkChanged(const ECS *const ecs,
+                                        const uint32_t compType,
+                                        const size_t chunk) {
+    if (!ecs_checkCompType(compType) ||
+        chunk * ECS_POOL_CHUNK_SIZE >= ecs->pool[compType].nComp ||
+        ecs->pool[compType].chunk[chunk].lastChange != ecs->tick)
+        return NULL;
+    return ecs->pool[compType].chunk[chunk].changed;
+}
+
+ECSStatus ecs_registerQuery(ECS *const ecs, const ECSCompMask mask,
+                            ECSQuery **const out) {
+    ECSQuery *query, **queryList;
+    uint32_t i;
+
+    *out = NULL;
+    if (mask == 0 || (mask >> ECS_COMPONENT_TYPES) != 0) {
+        logMsg(LOG_LVL_ERR, "invalid query mask %x", mask);
+        return ECS_RES_INVALID_PARAMS;
+    }
+    for (i = 0; i < ecs->nQuery; i++) {
+        if (ecs->query[i]->mask == mask) {
+            *out = ecs->query[i];
+            return ECS_RES_OK;
+        }
+    }
+
+    query = calloc(1, sizeof(*query));
+    queryList = realloc(ecs->query, (ecs->nQuery + 1) * sizeof(*queryList));
+    if (query == NULL || queryList == NULL) {
+        free(query);
+        logMsg(LOG_LVL_ERR, "can't allocate query %x", mask);
+        return ECS_RES_COMP_BUFF_FULL;
+    }
+    ecs->query = queryList;
+    query->mask = mask;
+    for (i = 0; i < ECS_COMPONENT_TYPES; i++) {
+        if (mask & ECS_COMP_MASK(i)) {
+            query->column[i] = query->nTypes;
+            query->types[query->nTypes++] = i;
+        }
+    }
+    for (i = 0; i < ecs->nActiveEnt; i++) {
+        if (ecs_queryMatches(query,
+                             ecs_entDesc(ecs, ecs->activeEnt[i])->compMask))
+            ecs_queryAdd(ecs, query, ecs->activeEnt[i]);
+    }
+    ecs->query[ecs->nQuery++] = query;
+
+    logMsg(LOG_LVL_DEBUG, "registered query %x with %u matching entities",
+           mask, query->nEnt);
+    *out = query;
+    return ECS_RES_OK;
+}
+
+void **ecs_queryComp(const ECSQuery *const query, const uint32_t compType) {
+    if (!ecs_checkCompType(compType) ||
+        !(query->mask & ECS_COMP_MASK(compType)))
+        return NULL;
+    return query->comp[query->column[compType]];
+}
+
+ECSStatus ecs_unregisterEntity(ECS *const ecs, const ECSEntityID id) {
+    ECSEntityDesc *const desc = ecs_entDesc(ecs, id);
+    uint32_t i, compId;
+
+    if (!ecs_checkEntityID(ecs, id))
+        return ECS_RES_INVALID_PARAMS;
+
+    if (!ecs_checkEntityExists(ecs, id))
+        return ECS_RES_ENTITY_NOT_FOUND;
+    ecs_checkStructChange(ecs, 1, desc->compMask, "entity unregistered");
+
+    // Unregister its components
+    for (i = 0; i < ecs->nQuery; i++) {
+        if (ecs_queryMatches(ecs->query[i], desc->compMask))
+            ecs_queryRemove(ecs->query[i], id);
+    }
+    for (i = 0; i < ECS_COMPONENT_TYPES; i++) {
+        if (!(desc->compMask & ECS_COMP_MASK(i)))
+            continue;
+        compId = ecs_compIndex(ecs, id, i);
+        ecs_poolSetIndex(ecs->pool + i, id, ECS_INVALID_ID);
+        ecs_poolRemove(ecs, i, compId);
+    }
+    desc->compMask = 0;
+    ecs_slotSetTags(ecs, ECS_ENTITY_INDEX(id), 0, ~(ECSTagMask)0);
+
+    // Unregister entity. The last active entity takes its place.
+    const ECSEntityID lastEnt = ecs->activeEnt[--ecs->nActiveEnt];
+    ecs->activeEnt[desc->activePos] = lastEnt;
+    ecs_entDesc(ecs, lastEnt)->activePos = desc->activePos;
+    desc->activePos = ECS_INVALID_ID;
+    desc->generation = (desc->generation + 1) & ECS_ENTITY_GENERATION_MASK;
+    fifo_write(&ecs->freeEntId, ECS_ENTITY_INDEX(id));
 
     logMsg(LOG_LVL_INFO, "unregistered entity %u (\"%s\") and its components",
-           id, entName);
+           id, desc->name);
+    ecs_nameDetach(ecs, ECS_ENTITY_INDEX(id));
     return ECS_RES_OK;
 }
 
 ECSStatus ecs_getEntityNameCstr(const ECS *const ecs, const ECSEntityID id,
                                 const char **out) {
-    const ECSEntityDesc *const desc = ecs->entDesc + id;
+    const ECSEntityDesc *const desc = ecs_entDesc(ecs, id);
 
-    if (!ecs_checkEntityID(id))
+    if (!ecs_checkEntityID(ecs, id))
         return ECS_RES_INVALID_PARAMS;
 
-    if (!binsearch_s32Inc(ecs->activeEnt, ecs->nActiveEnt, id, 0)) {
+    if (!ecs_entityAlive(ecs, id)) {
         *out = 0;
         return ECS_RES_ENTITY_NOT_FOUND;
     }
@@ -265,26 +1554,62 @@ const char *ecs_getEntityNameCstrP(const ECS *const ecs, const ECSEntityID id) {
     return name;
 }
 
+ECSStatus ecs_setEntityName(ECS *const ecs, const ECSEntityID id,
+                            const char *const name) {
+    if (!ecs_checkEntityID(ecs, id))
+        return ECS_RES_INVALID_PARAMS;
+    if (!ecs_checkEntityExists(ecs, id))
+        return ECS_RES_ENTITY_NOT_FOUND;
+    ecs_checkStructChange(ecs, 1, 0, "entity renamed");
+    ecs_nameDetach(ecs, ECS_ENTITY_INDEX(id));
+    ecs_nameAttach(ecs, ECS_ENTITY_INDEX(id), name);
+    return ECS_RES_OK;
+}
+
+// Get the interned entry of a name, or null if no entity has it
+static const ECSName *ecs_nameFind(const ECS *const ecs,
+                                   const char *const name) {
+    const ECSName *entry;
+    if (ecs->nNames == 0 || name == NULL)
+        return NULL;
+    entry = ecs_nameSlot(ecs, name, str_hash(name));
+    return entry->str ? entry : NULL;
+}
+
 ECSStatus ecs_findEntity(const ECS *const ecs, const char *const nameMatch,
                          ECSEntityID *const out) {
-    ECSComponent *comp;
-    uint32_t entId;
-    for (uint32_t i = 0; i < ecs->nActiveEnt; i++) {
-        entId = ecs->activeEnt[i];
-        if (strcmp(ecs->entDesc[entId].name, nameMatch) == 0) {
-            *out = entId;
-            return ECS_RES_OK;
-        }
+    const ECSName *const entry = ecs_nameFind(ecs, nameMatch);
+    if (entry == NULL) {
+        *out = ECS_INVALID_ID;
+        logMsg(LOG_LVL_WARN, "entity ID not found for name \"%s\"",
+               nameMatch);
+        return ECS_RES_ENTITY_NOT_FOUND;
     }
-    *out = ECS_INVALID_ID;
-    logMsg(LOG_LVL_WARN, "entity ID not found for name \"%s\"", nameMatch);
-    return ECS_RES_ENTITY_NOT_FOUND;
+    *out = ecs->activeEnt[ecs->entDesc[entry->firstEnt].activePos];
+    return ECS_RES_OK;
+}
+
+size_t ecs_findEntities(const ECS *const ecs, const char *const name,
+                        ECSEntityID *const out, const size_t maxOut) {
+    const ECSName *const entry = ecs_nameFind(ecs, name);
+    const ECSEntityDesc *desc;
+    uint32_t index;
+    size_t n = 0;
+
+    if (entry == NULL)
+        return 0;
+    for (index = entry->firstEnt; index != ECS_INVALID_ID && n < maxOut;
+         index = desc->nameNext) {
+        desc = ecs->entDesc + index;
+        out[n++] = ecs->activeEnt[desc->activePos];
+    }
+    return entry->nEnt;
 }
 
 ECSStatus ecs_entityExists(const ECS *const ecs, const ECSEntityID id) {
-    if (id == ECS_INVALID_ID)
+    if (id == ECS_INVALID_ID || ECS_ENTITY_INDEX(id) >= ecs->nEntIds)
         return ECS_RES_ENTITY_NOT_FOUND;
-    if (!binsearch_u32Inc(ecs->activeEnt, ecs->nActiveEnt, id, 0))
+    if (!ecs_entityAlive(ecs, id))
         return ECS_RES_ENTITY_NOT_FOUND;
     return ECS_RES_OK;
 }
@@ -294,27 +1619,461 @@ ECSStatus ecs_compExists(const ECS *ecs, const ECSEntityID ent,
     ECSStatus res = ecs_entityExists(ecs, ent);
     if (res != ECS_RES_OK)
         return res;
-    const ECSComponentID comp = ecs->entDesc[ent].compIndex[compType];
-    if (comp == ECS_INVALID_ID)
+    if (!ecs_checkCompType(compType))
+        return ECS_RES_INVALID_PARAMS;
+    if (!(ecs_entDesc(ecs, ent)->compMask & ECS_COMP_MASK(compType)))
         return ECS_RES_COMP_NOT_FOUND;
     return ECS_RES_OK;
 }
 
+ECSStatus ecs_setSystemCallback(ECS *const ecs, const uint32_t compType,
+                                const uint32_t cbType, ECSSystemCallback cb) {
+    if (!ecs_checkCompType(compType) || !ecs_checkCallbackType(cbType))
+        return ECS_RES_INVALID_PARAMS;
+    ecs->pool[compType].system[cbType] = cb;
+    ecs->pool[compType].sysRead[cbType] = 0;
+    ecs->pool[compType].sysWrite[cbType] = 0;
+    logMsg(LOG_LVL_DEBUG,
+           "assigned system callback of type %u to comp. type %u", cbType,
+           compType);
+    return ECS_RES_OK;
+}
+
+ECSStatus ecs_setSystemAccess(ECS *const ecs, const uint32_t compType,
+                              const uint32_t cbType, const ECSCompMask read,
+                              const ECSCompMask write) {
+    if (!ecs_checkCompType(compType) || !ecs_checkCallbackType(cbType))
+        return ECS_RES_INVALID_PARAMS;
+    if (ecs->pool[compType].system[cbType] == NULL) {
+        logMsg(LOG_LVL_ERR,
+               "no system callback of type %u for comp. type %u", cbType,
+               compType);
+        return ECS_RES_CALLBACK_NOT_FOUND;
+    }
+    ecs->pool[compType].sysRead[cbType] = read;
+    ecs->pool[compType].sysWrite[cbType] = write | ECS_COMP_MASK(compType);
+    return ECS_RES_OK;
+}
+
+void ecs_setJobPool(ECS *const ecs, JobPool *const jobs) {
+    const size_t nCmdBuf = jobs ? jobs->nThreads + 1 : 1;
+    ECSCmdBuffer *cmdBuf;
+
+    ecs->jobs = jobs;
+    if (nCmdBuf <= ecs->nCmdBuf)
+        return;
+    cmdBuf = realloc(ecs->cmdBuf, sizeof(ECSCmdBuffer) * nCmdBuf);
+    if (cmdBuf == NULL) {
+        logMsg(LOG_LVL_FATAL, "can't allocate %u command buffers", nCmdBuf);
+        ecs->jobs = NULL;
+        return;
+    }
+    memset(cmdBuf + ecs->nCmdBuf, 0,
+           sizeof(ECSCmdBuffer) * (nCmdBuf - ecs->nCmdBuf));
+    ecs->cmdBuf = cmdBuf;
+    ecs->nCmdBuf = nCmdBuf;
+}
+
+// Command buffer of the calling thread
+static inline ECSCmdBuffer *ecs_cmdBuffer(const ECS *const ecs) {
+    const size_t i = jobs_threadIndex();
+    return ecs->cmdBuf + (i < ecs->nCmdBuf ? i : 0);
+}
+
+static ECSCmd *ecs_cmdPush(ECSCmdBuffer *const buf, const ECSCmdType type,
+                           const ECSEntityID ent, const uint32_t compType) {
+    ECSCmd *cmd;
+    size_t cap;
+
+    if (buf->nCmd == buf->cmdCap) {
+        cap = buf->cmdCap ? buf->cmdCap * 2 : 64;
+        cmd = realloc(buf->cmd, sizeof(ECSCmd) * cap);
+        if (cmd == NULL) {
+            logMsg(LOG_LVL_ERR, "can't grow command buffer to %u commands",
+                   cap);
+            return NULL;
+        }
+        buf->cmd = cmd;
+        buf->cmdCap = cap;
+    }
+    cmd = buf->cmd + buf->nCmd++;
+    cmd->type = type;
+    cmd->newEnt = 0;
+    cmd->ent = ent;
+    cmd->compType = compType;
+    return cmd;
+}
+
+static ECSStatus ecs_cmdPushComp(ECS *const ecs, const ECSEntityID ent,
+                                 const uint8_t newEnt, const uint32_t compType,
+                                 const ECSComponent *const comp) {
+    ECSCmdBuffer *const buf = ecs_cmdBuffer(ecs);
+    size_t size, cap;
+    uint8_t *data;
+    ECSCmd *cmd;
+
+    if (!ecs_checkCompType(compType))
+        return ECS_RES_INVALID_PARAMS;
+    size = ecs->pool[compType].elemSize;
+    if (buf->dataSize + size > buf->dataCap) {
+        cap = buf->dataCap ? buf->dataCap : 1024;
+        while (cap < buf->dataSize + size)
+            cap *= 2;
+        data = realloc(buf->data, cap);
+        if (data == NULL) {
+            logMsg(LOG_LVL_ERR, "can't grow command buffer to %u bytes", cap);
+            return ECS_RES_COMP_BUFF_FULL;
+        }
+        buf->data = data;
+        buf->dataCap = cap;
+    }
+    cmd = ecs_cmdPush(buf, ECS_CMD_REGISTER_COMP, ent, compType);
+    if (cmd == NULL)
+        return ECS_RES_COMP_BUFF_FULL;
+    cmd->newEnt = newEnt;
+    cmd->dataOffset = buf->dataSize;
+    memcpy(buf->data + buf->dataSize, comp->data, size);
+    buf->dataSize += size;
+    return ECS_RES_OK;
+}
+
+ECSStatus ecs_cmdRegisterEntity(ECS *const ecs, const char *const name,
+                                uint32_t *const handleOut) {
+    ECSCmdBuffer *const buf = ecs_cmdBuffer(ecs);
+    ECSEntityID *newEnt;
+    ECSCmd *cmd;
+    size_t cap;
+
+    if (buf->newEntDone) {
+        buf->nNewEnt = 0;
+        buf->newEntDone = 0;
+    }
+    if (buf->nNewEnt == buf->newEntCap) {
+        cap = buf->newEntCap ? buf->newEntCap * 2 : 64;
+        newEnt = realloc(buf->newEnt, sizeof(ECSEntityID) * cap);
+        if (newEnt == NULL)
+            return ECS_RES_ENTITY_BUFF_FULL;
+        buf->newEnt = newEnt;
+        buf->newEntCap = cap;
+    }
+    cmd = ecs_cmdPush(buf, ECS_CMD_REGISTER_ENTITY, buf->nNewEnt, 0);
+    if (cmd == NULL)
+        return ECS_RES_ENTITY_BUFF_FULL;
+    cmd->newEnt = 1;
+    cmd->name = name;
+    buf->newEnt[buf->nNewEnt] = ECS_INVALID_ID;
+    *handleOut = buf->nNewEnt++;
+    return ECS_RES_OK;
+}
+
+ECSStatus ecs_cmdRegisterComp(ECS *const ecs, const ECSEntityID id,
+                              const uint32_t compType,
+                              const ECSComponent *const comp) {
+    return ecs_cmdPushComp(ecs, id, 0, compType, comp);
+}
+
+ECSStatus ecs_cmdRegisterNewComp(ECS *const ecs, const uint32_t handle,
+                                 const uint32_t compType,
+                                 const ECSComponent *const comp) {
+    const ECSCmdBuffer *const buf = ecs_cmdBuffer(ecs);
+    if (buf->newEntDone || handle >= buf->nNewEnt)
+        return ECS_RES_INVALID_PARAMS;
+    return ecs_cmdPushComp(ecs, handle, 1, compType, comp);
+}
+
+ECSStatus ecs_cmdUnregisterComp(ECS *const ecs, const ECSEntityID id,
+                                const uint32_t compType) {
+    if (!ecs_checkCompType(compType))
+        return ECS_RES_INVALID_PARAMS;
+    if (!ecs_cmdPush(ecs_cmdBuffer(ecs), ECS_CMD_UNREGISTER_COMP, id,
+                     compType))
+        return ECS_RES_COMP_BUFF_FULL;
+    return ECS_RES_OK;
+}
+
+ECSStatus ecs_cmdUnregisterEntity(ECS *const ecs, const ECSEntityID id) {
+    if (!ecs_cmdPush(ecs_cmdBuffer(ecs), ECS_CMD_UNREGISTER_ENTITY, id, 0))
+        return ECS_RES_ENTITY_BUFF_FULL;
+    return ECS_RES_OK;
+}
+
+ECSEntityID ecs_cmdEntityID(const ECS *const ecs, const uint32_t handle) {
+    const ECSCmdBuffer *const buf = ecs_cmdBuffer(ecs);
+    if (!buf->newEntDone || handle >= buf->nNewEnt)
+        return ECS_INVALID_ID;
+    return buf->newEnt[handle];
+}
+
+// Make room for n more entities with at most one reallocation
+static uint8_t ecs_entReserve(ECS *const ecs, const size_t n) {
+    const size_t avail =
+        ecs->entCap - ecs->nEntIds + fifo_av_read(&ecs->freeEntId);
+    size_t newCap = ecs->entCap;
+
+    if (n <= avail)
+        return 1;
+    while (newCap - ecs->nEntIds + fifo_av_read(&ecs->freeEntId) < n)
+        newCap *= 2;
+    if (newCap > ECS_MAX_ENTITY_SLOTS)
+        newCap = ECS_MAX_ENTITY_SLOTS;
+    return ecs_entGrow(ecs, newCap);
+}
+
+// Entity targeted by a command, ECS_INVALID_ID if its registration failed
+static inline ECSEntityID ecs_cmdTarget(const ECSCmdBuffer *const buf,
+                                        const ECSCmd *const cmd) {
+    return cmd->newEnt ? buf->newEnt[cmd->ent] : cmd->ent;
+}
+
+// Commands of the same kind are batched together. Registrations form a
+// single kind, so new entities get their components before the creation
+// callbacks run.
+static inline ECSCmdType ecs_cmdKind(const ECSCmdType type) {
+    return type == ECS_CMD_REGISTER_COMP ? ECS_CMD_REGISTER_ENTITY : type;
+}
+
+// Apply a run of registrations. Entities recorded with a handle below
+// firstHandle were registered, and created, by an earlier run.
+static ECSStatus ecs_flushRegisterRun(ECS *const ecs, ECSCmdBuffer *const work,
+                                      ECSCmd *const begin, ECSCmd *const end,
+                                      const ECSCompMask types,
+                                      const uint32_t firstHandle,
+                                      const uint32_t createCbType,
+                                      void *cbUserData) {
+    ECSStatus res, status = ECS_RES_OK;
+    ECSEntityID id;
+    uint32_t compType;
+    ECSCmd *cmd;
+
+    for (cmd = begin; cmd < end; cmd++) {
+        if (cmd->type != ECS_CMD_REGISTER_ENTITY)
+            continue;
+        res = ecs_registerEntity(ecs, work->newEnt + cmd->ent, cmd->name);
+        if (res != ECS_RES_OK)
+            status = res;
+    }
+    // Components are registered type by type, so each pool is filled at once
+    for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        if (!(types & ECS_COMP_MASK(compType)))
+            continue;
+        for (cmd = begin; cmd < end; cmd++) {
+            if (cmd->type != ECS_CMD_REGISTER_COMP ||
+                cmd->compType != compType)
+                continue;
+            id = ecs_cmdTarget(work, cmd);
+            if (id == ECS_INVALID_ID)
+                continue;
+            res = ecs_registerCompData(ecs, id, compType,
+                                       work->data + cmd->dataOffset);
+            if (res != ECS_RES_OK) {
+                // Don't run the creation callback of an older component
+                cmd->newEnt = 0;
+                cmd->ent = ECS_INVALID_ID;
+                status = res;
+            }
+        }
+    }
+    if (createCbType == ECS_INVALID_ID)
+        return status;
+    // Creation callbacks run once every new component is in place
+    for (cmd = begin; cmd < end; cmd++) {
+        id = ecs_cmdTarget(work, cmd);
+        if (!ecs_idAlive(ecs, id))
+            continue;
+        if (cmd->type == ECS_CMD_REGISTER_ENTITY)
+            ecs_execCallbackAllComp(ecs, id, createCbType, cbUserData);
+        else if ((!cmd->newEnt || cmd->ent < firstHandle) &&
+                 ecs_entDesc(ecs, id)->compMask & ECS_COMP_MASK(cmd->compType))
+            ecs_execCallback(ecs, id, cmd->compType, createCbType, cbUserData);
+    }
+    return status;
+}
+
+// Entities and components can be unregistered more than once, or by an
+// earlier destroy callback, so dead targets are skipped silently
+static ECSStatus ecs_flushUnregisterCompRun(ECS *const ecs,
+                                            const ECSCmd *const begin,
+                                            const ECSCmd *const end,
+                                            const ECSCompMask types,
+                                            const uint32_t destroyCbType,
+                                            void *cbUserData) {
+    ECSStatus res, status = ECS_RES_OK;
+    const ECSCmd *cmd;
+    uint32_t compType;
+
+    for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        if (!(types & ECS_COMP_MASK(compType)))
+            continue;
+        for (cmd = begin; cmd < end; cmd++) {
+            if (cmd->compType != compType || !ecs_idAlive(ecs, cmd->ent) ||
+                !(ecs_entDesc(ecs, cmd->ent)->compMask &
+                  ECS_COMP_MASK(compType)))
+                continue;
+            if (destroyCbType != ECS_INVALID_ID)
+                ecs_execCallback(ecs, cmd->ent, compType, destroyCbType,
+                                 cbUserData);
+            res = ecs_unregisterComp(ecs, cmd->ent, compType);
+            if (res != ECS_RES_OK && res != ECS_RES_COMP_NOT_FOUND)
+                status = res;
+        }
+    }
+    return status;
+}
+
+static ECSStatus ecs_flushUnregisterEntityRun(ECS *const ecs,
+                                              const ECSCmd *const begin,
+                                              const ECSCmd *const end,
+                                              const uint32_t destroyCbType,
+                                              void *cbUserData) {
+    ECSStatus res, status = ECS_RES_OK;
+    const ECSCmd *cmd;
+
+    for (cmd = begin; cmd < end; cmd++) {
+        if (!ecs_idAlive(ecs, cmd->ent))
+            continue;
+        if (destroyCbType != ECS_INVALID_ID)
+            ecs_execCallbackAllComp(ecs, cmd->ent, destroyCbType, cbUserData);
+        res = ecs_unregisterEntity(ecs, cmd->ent);
+        if (res != ECS_RES_OK && res != ECS_RES_ENTITY_NOT_FOUND)
+            status = res;
+    }
+    return status;
+}
+
+static ECSStatus ecs_flushCmdBuffer(ECS *const ecs, ECSCmdBuffer *const buf,
+                                    const uint32_t createCbType,
+                                    const uint32_t destroyCbType,
+                                    void *cbUserData) {
+    // Callbacks can record new commands, so they go to a fresh buffer
+    ECSCmdBuffer work = *buf;
+    ECSStatus res, status = ECS_RES_OK;
+    ECSCmd *cmd, *run, *const end = work.cmd + work.nCmd;
+    ECSCompMask types;
+    uint32_t nNewEnt = 0, firstHandle;
+
+    memset(buf, 0, sizeof(*buf));
+    for (cmd = work.cmd; cmd < end; cmd++)
+        nNewEnt += cmd->type == ECS_CMD_REGISTER_ENTITY;
+    if (!ecs_entReserve(ecs, nNewEnt))
+        logMsg(LOG_LVL_WARN, "can't reserve %u entities", nNewEnt);
+    // Commands are applied in record order, only consecutive commands of the
+    // same kind are batched together
+    nNewEnt = 0;
+    for (run = work.cmd; run < end; run = cmd) {
+        types = 0;
+        firstHandle = nNewEnt;
+        for (cmd = run; cmd < end; cmd++) {
+            if (ecs_cmdKind(cmd->type) != ecs_cmdKind(run->type))
+                break;
+            nNewEnt += cmd->type == ECS_CMD_REGISTER_ENTITY;
+            if (cmd->type != ECS_CMD_REGISTER_ENTITY &&
+                cmd->type != ECS_CMD_UNREGISTER_ENTITY)
+                types |= ECS_COMP_MASK(cmd->compType);
+        }
+        if (ecs_cmdKind(run->type) == ECS_CMD_REGISTER_ENTITY)
+            res = ecs_flushRegisterRun(ecs, &work, run, cmd, types, firstHandle,
+                                       createCbType, cbUserData);
+        else if (run->type == ECS_CMD_UNREGISTER_COMP)
+            res = ecs_flushUnregisterCompRun(ecs, run, cmd, types,
+                                             destroyCbType, cbUserData);
+        else
+            res = ecs_flushUnregisterEntityRun(ecs, run, cmd, destroyCbType,
+                                               cbUserData);
+        if (res != ECS_RES_OK)
+            status = res;
+    }
+
+    work.nCmd = 0;
+    work.dataSize = 0;
+    work.newEntDone = 1;
+    if (buf->nCmd == 0) {
+        // Keep the storage and the assigned IDs
+        free(buf->cmd);
+        free(buf->data);
+        free(buf->newEnt);
+        *buf = work;
+        return status;
+    }
+    free(work.cmd);
+    free(work.data);
+    if (buf->nNewEnt) {
+        // The callbacks recorded new entities, which replace the assigned IDs
+        free(work.newEnt);
+        return status;
+    }
+    free(buf->newEnt);
+    buf->newEnt = work.newEnt;
+    buf->nNewEnt = work.nNewEnt;
+    buf->newEntCap = work.newEntCap;
+    buf->newEntDone = 1;
+    return status;
+}
+
+ECSStatus ecs_flushCmdBuffers(ECS *const ecs, const uint32_t createCbType,
+                              const uint32_t destroyCbType,
+                              void *cbUserData) {
+    ECSStatus res, status = ECS_RES_OK;
+    uint8_t pending;
+    size_t i;
+
+    ecs_checkStructChange(ecs, 1, 0, "commands flushed");
+    do {
+        pending = 0;
+        for (i = 0; i < ecs->nCmdBuf; i++) {
+            if (ecs->cmdBuf[i].nCmd == 0)
+                continue;
+            res = ecs_flushCmdBuffer(ecs, ecs->cmdBuf + i, createCbType,
+                                     destroyCbType, cbUserData);
+            if (res != ECS_RES_OK)
+                status = res;
+            pending = 1;
+        }
+    } while (pending);
+    return status;
+}
+
+// Run the system and per-instance callbacks of a single component
+static void ecs_execCompCallbacks(ECS *const ecs, const ECSEntityID id,
+                                  const uint32_t compType,
+                                  const uint32_t cbType, void *cbUserData) {
+    ECSCompPool *const pool = ecs->pool + compType;
+    uint32_t compId = ecs_poolIndex(pool, id);
+    ECSComponentCallback cb;
+
+    if (pool->system[cbType])
+        pool->system[cbType](cbType, compType, 1, &id,
+                             ecs_poolData(pool, compId), cbUserData);
+    if (pool->nInstanceCb[cbType] == 0)
+        return;
+    // The system callback may have unregistered or moved the component
+    compId = ecs_poolIndex(pool, id);
+    if (compId == ECS_INVALID_ID)
+        return;
+    cb = ecs_poolCallbacks(pool, compId)[cbType];
+    if (cb)
+        cb(cbType, id, compId, compType, ecs_poolData(pool, compId),
+           cbUserData);
+}
+
 ECSStatus ecs_setCallback(ECS *const ecs, const ECSEntityID id,
                           const uint32_t compType, const uint32_t cbType,
                           ECSComponentCallback cb) {
-    ECSEntityDesc *const desc = ecs->entDesc + id;
-
-    if (!ecs_checkCompType(compType) || !ecs_checkEntityID(id))
+    if (!ecs_checkCompType(compType) || !ecs_checkEntityID(ecs, id))
         return ECS_RES_INVALID_PARAMS;
     if (!ecs_checkCallbackType(cbType))
         return ECS_RES_INVALID_PARAMS;
     if (!ecs_checkEntityExists(ecs, id))
         return ECS_RES_ENTITY_NOT_FOUND;
-    const uint32_t compId = desc->compIndex[compType];
+    const uint32_t compId = ecs_compIndex(ecs, id, compType);
     if (compId == ECS_INVALID_ID)
         return ECS_RES_COMP_NOT_FOUND;
-    ecs->comp[compId].callback[cbType] = cb;
+    ECSCompPool *const pool = ecs->pool + compType;
+    ECSComponentCallback *const callbacks = ecs_poolCallbacks(pool, compId);
+    if (callbacks[cbType] == NULL && cb != NULL)
+        pool->nInstanceCb[cbType]++;
+    else if (callbacks[cbType] != NULL && cb == NULL)
+        pool->nInstanceCb[cbType]--;
+    callbacks[cbType] = cb;
 
     logMsg(LOG_LVL_DEBUG,
            "assigned callback of type %u to comp. type %u of entity %u(\"%s\")",
@@ -325,66 +2084,1194 @@ ECSStatus ecs_setCallback(ECS *const ecs, const ECSEntityID id,
 ECSStatus ecs_execCallback(ECS *const ecs, const ECSEntityID id,
                            const uint32_t compType, const uint32_t cbType,
                            void *cbUserData) {
-    ECSEntityDesc *const desc = ecs->entDesc + id;
+    ECSEntityDesc *const desc = ecs_entDesc(ecs, id);
 
-    if (!ecs_checkCompType(compType) || !ecs_checkEntityID(id))
+    if (!ecs_checkCompType(compType) || !ecs_checkEntityID(ecs, id))
         return ECS_RES_INVALID_PARAMS;
     if (!ecs_checkCallbackType(cbType))
         return ECS_RES_INVALID_PARAMS;
     if (!ecs_checkEntityExists(ecs, id))
         return ECS_RES_ENTITY_NOT_FOUND;
-    const uint32_t compId = desc->compIndex[compType];
-    if (compId == ECS_INVALID_ID)
+    if (!(desc->compMask & ECS_COMP_MASK(compType)))
         return ECS_RES_COMP_NOT_FOUND;
-    ECSComponentCallback cb = ecs->comp[compId].callback[cbType];
-    if (cb)
-        cb(cbType, id, compId, compType, ecs->comp + compId, cbUserData);
+    ecs_execCompCallbacks(ecs, id, compType, cbType, cbUserData);
     return ECS_RES_OK;
 }
 
 ECSStatus ecs_execCallbackAllComp(ECS *const ecs, const ECSEntityID id,
                                   const uint32_t cbType, void *cbUserData) {
-    ECSEntityDesc *const desc = ecs->entDesc + id;
-    uint32_t compId;
-
-    if (!ecs_checkEntityID(id))
+    if (!ecs_checkEntityID(ecs, id))
         return ECS_RES_INVALID_PARAMS;
     if (!ecs_checkCallbackType(cbType))
         return ECS_RES_INVALID_PARAMS;
     if (!ecs_checkEntityExists(ecs, id))
         return ECS_RES_ENTITY_NOT_FOUND;
     for (uint32_t compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
-        compId = desc->compIndex[compType];
-        if (compId == ECS_INVALID_ID)
+        // Callbacks can grow the entity tables, so don't keep desc pointers
+        if (!(ecs_entDesc(ecs, id)->compMask & ECS_COMP_MASK(compType)))
             continue;
-        ECSComponentCallback cb = ecs->comp[compId].callback[cbType];
-        if (cb) {
-            cb(cbType, id, compId, compType, ecs->comp + compId, cbUserData);
-        }
+        ecs_execCompCallbacks(ecs, id, compType, cbType, cbUserData);
+        // The entity may have been unregistered by its own callback
+        if (!ecs_entityAlive(ecs, id))
+            break;
     }
     return ECS_RES_OK;
 }
 
+static void ecs_runSystemJob(void *arg) {
+    const ECSSystemJob *const job = arg;
+    job->sys(job->cbType, job->compType, job->count, job->owners, job->data,
+             job->cbUserData);
+}
+
+// Read section on a single component type, entities can still be registered
+static inline void ecs_poolBeginRead(ECSCompPool *const pool) {
+    __atomic_fetch_add(&pool->readers, 1, __ATOMIC_ACQ_REL);
+}
+
+static inline void ecs_poolEndRead(ECSCompPool *const pool) {
+    __atomic_fetch_sub(&pool->readers, 1, __ATOMIC_ACQ_REL);
+}
+
+void ecs_beginRead(ECS *const ecs, const ECSCompMask mask) {
+    __atomic_fetch_add(&ecs->nReaders, 1, __ATOMIC_ACQ_REL);
+    for (uint32_t compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        if (mask & ECS_COMP_MASK(compType))
+            ecs_poolBeginRead(ecs->pool + compType);
+    }
+}
+
+void ecs_endRead(ECS *const ecs, const ECSCompMask mask) {
+#if ECS_CHECK_ACCESS
+    if (__atomic_load_n(&ecs->nReaders, __ATOMIC_RELAXED) == 0)
+        logMsg(LOG_LVL_FATAL, "no ECS read section to end");
+#endif
+    for (uint32_t compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        if (mask & ECS_COMP_MASK(compType))
+            ecs_poolEndRead(ecs->pool + compType);
+    }
+    __atomic_fetch_sub(&ecs->nReaders, 1, __ATOMIC_ACQ_REL);
+}
+
+uint32_t ecs_getEpoch(const ECS *const ecs, const uint32_t compType) {
+    if (!ecs_checkCompType(compType))
+        return 0;
+    return __atomic_load_n(&ecs->pool[compType].epoch, __ATOMIC_ACQUIRE);
+}
+
+static inline uint8_t ecs_accessConflict(const ECSCompMask readA,
+                                         const ECSCompMask writeA,
+                                         const ECSCompMask readB,
+                                         const ECSCompMask writeB) {
+    return (writeA & (readB | writeB)) || (writeB & readA);
+}
+
+// Run the systems of each stage on the job pool, one chunk per job. A stage
+// starts only after the previous one is done.
+static void ecs_runStages(ECS *const ecs, const ECSCompMask *const stageTypes,
+                          const uint32_t nStages, const uint32_t cbType,
+                          void *cbUserData) {
+    const ECSCompPool *pool;
+    ECSSystemJob *job;
+    size_t nJobs, chunk, cap;
+    uint32_t stage, compType;
+
+    // Systems must not change the structure of the ECS while they run
+    ecs_beginRead(ecs, ECS_COMP_MASK_ALL);
+    for (stage = 0; stage < nStages; stage++) {
+        nJobs = 0;
+        for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+            pool = ecs->pool + compType;
+            if (stageTypes[stage] & ECS_COMP_MASK(compType))
+                nJobs += (pool->nComp + ECS_POOL_CHUNK_SIZE - 1) /
+                         ECS_POOL_CHUNK_SIZE;
+        }
+        if (nJobs > ecs->sysJobCap) {
+            cap = ecs->sysJobCap ? ecs->sysJobCap : 16;
+            while (cap < nJobs)
+                cap *= 2;
+            job = realloc(ecs->sysJob, sizeof(ECSSystemJob) * cap);
+            if (job == NULL) {
+                logMsg(LOG_LVL_FATAL, "can't allocate %u system jobs", cap);
+                ecs_endRead(ecs, ECS_COMP_MASK_ALL);
+                return;
+            }
+            ecs->sysJob = job;
+            ecs->sysJobCap = cap;
+        }
+
+        job = ecs->sysJob;
+        for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+            if (!(stageTypes[stage] & ECS_COMP_MASK(compType)))
+                continue;
+            pool = ecs->pool + compType;
+            for (chunk = 0; chunk * ECS_POOL_CHUNK_SIZE < pool->nComp;
+                 chunk++, job++) {
+                job->sys = pool->system[cbType];
+                job->cbType = cbType;
+                job->compType = compType;
+                job->count = pool->nComp - chunk * ECS_POOL_CHUNK_SIZE;
+                if (job->count > ECS_POOL_CHUNK_SIZE)
+                    job->count = ECS_POOL_CHUNK_SIZE;
+                job->owners = pool->chunk[chunk].owner;
+                job->data = pool->chunk[chunk].data;
+                job->cbUserData = cbUserData;
+                if (!jobs_push(ecs->jobs, ecs_runSystemJob, job))
+                    ecs_runSystemJob(job);
+            }
+        }
+        jobs_wait(ecs->jobs);
+    }
+    ecs_endRead(ecs, ECS_COMP_MASK_ALL);
+}
+
 ECSStatus ecs_execCallbackAllEnt(ECS *const ecs, const uint32_t cbType,
                                  void *cbUserData) {
-    ECSComponent *comp;
-    uint32_t entId, compId;
+    ECSCompPool *pool;
+    ECSSystemCallback sys;
+    ECSComponentCallback cb;
+    size_t chunk, count;
+    uint32_t compId, stage, i, nStages = 0;
+    // Systems waiting to be run in parallel, grouped by stage
+    ECSCompMask stageTypes[ECS_COMPONENT_TYPES];
+    ECSCompMask stageRead[ECS_COMPONENT_TYPES];
+    ECSCompMask stageWrite[ECS_COMPONENT_TYPES];
 
     if (!ecs_checkCallbackType(cbType))
         return ECS_RES_INVALID_PARAMS;
-    for (uint32_t i = 0; i < ecs->nActiveEnt; i++) {
-        entId = ecs->activeEnt[i];
-        for (uint32_t compType = 0; compType < ECS_COMPONENT_TYPES;
-             compType++) {
-            compId = ecs->entDesc[entId].compIndex[compType];
-            if (compId == ECS_INVALID_ID)
-                continue;
-            comp = ecs->comp + compId;
-            ECSComponentCallback cb = comp->callback[cbType];
+    for (uint32_t compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        pool = ecs->pool + compType;
+        sys = pool->system[cbType];
+        if (sys && ecs->jobs && pool->sysWrite[cbType]) {
+            // Schedule the system right after the last stage it conflicts
+            // with, so that the type order is kept between conflicting ones
+            for (i = 0, stage = 0; i < nStages; i++)
+                if (ecs_accessConflict(stageRead[i], stageWrite[i],
+                                       pool->sysRead[cbType],
+                                       pool->sysWrite[cbType]))
+                    stage = i + 1;
+            if (stage == nStages) {
+                stageTypes[stage] = stageRead[stage] = stageWrite[stage] = 0;
+                nStages++;
+            }
+            stageTypes[stage] |= ECS_COMP_MASK(compType);
+            stageRead[stage] |= pool->sysRead[cbType];
+            stageWrite[stage] |= pool->sysWrite[cbType];
+            sys = NULL;
+        } else if (nStages && (sys || pool->nInstanceCb[cbType])) {
+            ecs_runStages(ecs, stageTypes, nStages, cbType, cbUserData);
+            nStages = 0;
+        }
+        // Pool size is checked again after every call, since callbacks can
+        // register or unregister components
+        for (chunk = 0; sys && chunk * ECS_POOL_CHUNK_SIZE < pool->nComp;
+             chunk++) {
+            count = pool->nComp - chunk * ECS_POOL_CHUNK_SIZE;
+            if (count > ECS_POOL_CHUNK_SIZE)
+                count = ECS_POOL_CHUNK_SIZE;
+            sys(cbType, compType, count, pool->chunk[chunk].owner,
+                pool->chunk[chunk].data, cbUserData);
+        }
+        if (nStages && pool->nInstanceCb[cbType]) {
+            ecs_runStages(ecs, stageTypes, nStages, cbType, cbUserData);
+            nStages = 0;
+        }
+        if (pool->nInstanceCb[cbType] == 0)
+            continue;
+        // Unregistering a component of this type would swap another one
+        // into the current position and skip it
+        ecs_poolBeginRead(pool);
+        for (compId = 0; compId < pool->nComp; compId++) {
+            cb = ecs_poolCallbacks(pool, compId)[cbType];
             if (cb)
-                cb(cbType, entId, compId, compType, ecs->comp + compId,
-                   cbUserData);
+                cb(cbType, *ecs_poolOwner(pool, compId), compId, compType,
+                   ecs_poolData(pool, compId), cbUserData);
+        }
+        ecs_poolEndRead(pool);
+    }
+    if (nStages)
+        ecs_runStages(ecs, stageTypes, nStages, cbType, cbUserData);
+    return ECS_RES_OK;
+}
+
+// Park list of the entities with exactly the component types of mask, null if
+// there is none
+static ECSParkList *ecs_parkList(const ECS *const ecs,
+                                 const ECSCompMask mask) {
+    for (size_t i = 0; i < ecs->nParkLists; i++)
+        if (ecs->park[i].mask == mask)
+            return ecs->park + i;
+    return NULL;
+}
+
+// Make a parked entity slot active again under a new ID. Its components are
+// still parked.
+static ECSEntityID ecs_unparkSlot(ECS *const ecs, const uint32_t slot,
+                                  const char *const name) {
+    ECSEntityDesc *const desc = ecs->entDesc + slot;
+    const ECSEntityID id = ECS_ENTITY_ID(slot, desc->generation);
+
+    desc->activePos = ecs->nActiveEnt;
+    ecs->activeEnt[ecs->nActiveEnt++] = id;
+    if (ecs->nActiveEnt > ecs->peakActiveEnt)
+        ecs->peakActiveEnt = ecs->nActiveEnt;
+    desc->obsPending = 0;
+    ecs_nameAttach(ecs, slot, name);
+    return id;
+}
+
+ECSStatus ecs_parkEntity(ECS *const ecs, const ECSEntityID id) {
+    ECSEntityDesc *const desc = ecs_entDesc(ecs, id);
+    ECSParkList *list;
+    ECSCompPool *pool;
+    uint32_t compType, compId, *slot;
+    size_t i, cap;
+
+    if (!ecs_checkEntityID(ecs, id))
+        return ECS_RES_INVALID_PARAMS;
+    if (!ecs_checkEntityExists(ecs, id))
+        return ECS_RES_ENTITY_NOT_FOUND;
+    ecs_checkStructChange(ecs, 1, desc->compMask, "entity parked");
+    list = ecs_parkList(ecs, desc->compMask);
+    if (list == NULL) {
+        list = realloc(ecs->park, (ecs->nParkLists + 1) * sizeof(*list));
+        if (list == NULL) {
+            logMsg(LOG_LVL_ERR, "can't park entity %u", id);
+            return ECS_RES_ENTITY_BUFF_FULL;
+        }
+        ecs->park = list;
+        list += ecs->nParkLists++;
+        list->mask = desc->compMask;
+        list->nSlot = 0;
+        list->cap = 0;
+        list->slot = NULL;
+    }
+    if (list->nSlot == list->cap) {
+        cap = list->cap ? list->cap * 2 : 64;
+        slot = realloc(list->slot, cap * sizeof(*slot));
+        if (slot == NULL) {
+            logMsg(LOG_LVL_ERR, "can't park entity %u", id);
+            return ECS_RES_ENTITY_BUFF_FULL;
+        }
+        list->slot = slot;
+        list->cap = cap;
+    }
+
+    for (i = 0; i < ecs->nQuery; i++) {
+        if (ecs_queryMatches(ecs->query[i], desc->compMask))
+            ecs_queryRemove(ecs->query[i], id);
+    }
+    // The components become the first parked ones of their pools
+    for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        if (!(desc->compMask & ECS_COMP_MASK(compType)))
+            continue;
+        pool = ecs->pool + compType;
+        ecs_poolBumpEpoch(pool);
+        ecs_observeRemove(ecs, compType, id);
+        compId = ecs_poolIndex(pool, id);
+        if (compId != pool->nComp - 1)
+            ecs_poolSwap(ecs, compType, compId, pool->nComp - 1, 1);
+        pool->nComp--;
+        pool->nParked++;
+        ecs->nComp--;
+    }
+
+    // Deactivate the slot as ecs_unregisterEntity does, without freeing it
+    ecs_slotSetTags(ecs, ECS_ENTITY_INDEX(id), 0, ~(ECSTagMask)0);
+    const ECSEntityID lastEnt = ecs->activeEnt[--ecs->nActiveEnt];
+    ecs->activeEnt[desc->activePos] = lastEnt;
+    ecs_entDesc(ecs, lastEnt)->activePos = desc->activePos;
+    desc->activePos = ECS_INVALID_ID;
+    desc->generation = (desc->generation + 1) & ECS_ENTITY_GENERATION_MASK;
+    ecs_nameDetach(ecs, ECS_ENTITY_INDEX(id));
+    list->slot[list->nSlot++] = ECS_ENTITY_INDEX(id);
+    ecs->nParkedEnt++;
+    return ECS_RES_OK;
+}
+
+void ecs_clearParked(ECS *const ecs) {
+    ECSEntityDesc *desc;
+    ECSParkList *list;
+    ECSEntityID id;
+    uint32_t compType, compId;
+    size_t i, j;
+
+    ecs_checkStructChange(ecs, 1, 0, "parked entities cleared");
+    for (i = 0; i < ecs->nParkLists; i++) {
+        list = ecs->park + i;
+        for (j = 0; j < list->nSlot; j++) {
+            desc = ecs->entDesc + list->slot[j];
+            id = ECS_ENTITY_ID(list->slot[j], desc->generation);
+            for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+                if (!(desc->compMask & ECS_COMP_MASK(compType)))
+                    continue;
+                compId = ecs_compIndex(ecs, id, compType);
+                ecs_poolSetIndex(ecs->pool + compType, id, ECS_INVALID_ID);
+                ecs_poolRemoveParked(ecs, compType, compId);
+            }
+            desc->compMask = 0;
+            fifo_write(&ecs->freeEntId, list->slot[j]);
+        }
+        free(list->slot);
+    }
+    if (ecs->nParkedEnt)
+        logMsg(LOG_LVL_INFO, "unregistered %u parked entities",
+               ecs->nParkedEnt);
+    free(ecs->park);
+    ecs->park = NULL;
+    ecs->nParkLists = 0;
+    ecs->nParkedEnt = 0;
+}
+
+ECSStatus ecs_addTags(ECS *const ecs, const ECSEntityID id,
+                      const ECSTagMask tags) {
+    if (!ecs_checkEntityID(ecs, id))
+        return ECS_RES_INVALID_PARAMS;
+    if (!ecs_checkEntityExists(ecs, id))
+        return ECS_RES_ENTITY_NOT_FOUND;
+    ecs_slotSetTags(ecs, ECS_ENTITY_INDEX(id), tags, 0);
+    return ECS_RES_OK;
+}
+
+ECSStatus ecs_removeTags(ECS *const ecs, const ECSEntityID id,
+                         const ECSTagMask tags) {
+    if (!ecs_checkEntityID(ecs, id))
+        return ECS_RES_INVALID_PARAMS;
+    if (!ecs_checkEntityExists(ecs, id))
+        return ECS_RES_ENTITY_NOT_FOUND;
+    ecs_slotSetTags(ecs, ECS_ENTITY_INDEX(id), 0, tags);
+    return ECS_RES_OK;
+}
+
+ECSTagMask ecs_getTags(const ECS *const ecs, const ECSEntityID id) {
+    if (!ecs_idAlive(ecs, id))
+        return 0;
+    return ecs_slotTags(ecs, ECS_ENTITY_INDEX(id));
+}
+
+size_t ecs_queryTags(const ECS *const ecs, const ECSTagMask all,
+                     const ECSTagMask any, const ECSTagMask none,
+                     ECSEntityID *const out, const size_t maxOut) {
+    const uint64_t *allBits[ECS_TAG_TYPES], *anyBits[ECS_TAG_TYPES],
+        *noneBits[ECS_TAG_TYPES];
+    uint64_t acc[ECS_TAG_BLOCK / 64], anyAcc[ECS_TAG_BLOCK / 64];
+    uint32_t nAll = 0, nAny = 0, nNone = 0, tag, k, slot;
+    size_t i, w, nWords, n = 0;
+
+    for (tag = 0; tag < ECS_TAG_TYPES; tag++) {
+        const uint64_t *const bits = ecs->tagBits[tag];
+        // No entity ever had a tag without bitset
+        if ((all & ECS_TAG_MASK(tag)) && bits == NULL)
+            return 0;
+        if (bits == NULL)
+            continue;
+        if (all & ECS_TAG_MASK(tag))
+            allBits[nAll++] = bits;
+        if (any & ECS_TAG_MASK(tag))
+            anyBits[nAny++] = bits;
+        if (none & ECS_TAG_MASK(tag))
+            noneBits[nNone++] = bits;
+    }
+    if (any && !nAny)
+        return 0;
+
+    // Free slots have no tag, so only active entities can match the bitsets
+    if (!all && !any) {
+        for (i = 0; i < ecs->nActiveEnt; i++) {
+            slot = ECS_ENTITY_INDEX(ecs->activeEnt[i]);
+            for (k = 0; k < nNone; k++)
+                if (noneBits[k][slot / 64] >> (slot % 64) & 1)
+                    break;
+            if (k < nNone)
+                continue;
+            if (n < maxOut)
+                out[n] = ecs->activeEnt[i];
+            n++;
+        }
+        return n;
+    }
+
+    nWords = (ecs->nEntIds + ECS_TAG_BLOCK - 1) / ECS_TAG_BLOCK *
+             (ECS_TAG_BLOCK / 64);
+    for (w = 0; w < nWords; w += ECS_TAG_BLOCK / 64) {
+        for (k = 0; k < ECS_TAG_BLOCK / 64; k++)
+            acc[k] = ~(uint64_t)0;
+        for (i = 0; i < nAll; i++)
+            for (k = 0; k < ECS_TAG_BLOCK / 64; k++)
+                acc[k] &= allBits[i][w + k];
+        if (nAny) {
+            for (k = 0; k < ECS_TAG_BLOCK / 64; k++)
+                anyAcc[k] = 0;
+            for (i = 0; i < nAny; i++)
+                for (k = 0; k < ECS_TAG_BLOCK / 64; k++)
+                    anyAcc[k] |= anyBits[i][w + k];
+            for (k = 0; k < ECS_TAG_BLOCK / 64; k++)
+                acc[k] &= anyAcc[k];
+        }
+        for (i = 0; i < nNone; i++)
+            for (k = 0; k < ECS_TAG_BLOCK / 64; k++)
+                acc[k] &= ~noneBits[i][w + k];
+
+        for (k = 0; k < ECS_TAG_BLOCK / 64; k++) {
+            for (; acc[k]; acc[k] &= acc[k] - 1) {
+                slot = (w + k) * 64 + __builtin_ctzll(acc[k]);
+                if (n < maxOut)
+                    out[n] = ECS_ENTITY_ID(slot, ecs->entDesc[slot].generation);
+                n++;
+            }
+        }
+    }
+    return n;
+}
+
+void ecs_prefabInit(ECSPrefab *const prefab, const char *const name) {
+    memset(prefab, 0, sizeof(*prefab));
+    prefab->name = name;
+    prefab->self = ECS_PREFAB_SELF;
+}
+
+void ecs_prefabFree(ECSPrefab *const prefab) {
+    for (uint32_t i = 0; i < ECS_COMPONENT_TYPES; i++) {
+        free(prefab->data[i]);
+        prefab->data[i] = NULL;
+    }
+    prefab->mask = 0;
+    prefab->tags = 0;
+}
+
+ECSStatus ecs_prefabSetComp(const ECS *const ecs, ECSPrefab *const prefab,
+                            const uint32_t compType,
+                            const ECSComponent *const comp) {
+    size_t size;
+
+    if (!ecs_checkCompType(compType))
+        return ECS_RES_INVALID_PARAMS;
+    size = ecs->pool[compType].elemSize;
+    if (prefab->data[compType] == NULL) {
+        prefab->data[compType] = malloc(size);
+        if (prefab->data[compType] == NULL)
+            return ECS_RES_COMP_BUFF_FULL;
+    }
+    memcpy(prefab->data[compType], comp->data, size);
+    prefab->mask |= ECS_COMP_MASK(compType);
+    return ECS_RES_OK;
+}
+
+ECSStatus ecs_prefabFromEntity(const ECS *const ecs, ECSPrefab *const prefab,
+                               const ECSEntityID id) {
+    const ECSEntityDesc *const desc = ecs_entDesc(ecs, id);
+    const ECSCompPool *pool;
+    ECSComponent comp;
+    uint32_t compType, compId;
+    ECSStatus res;
+
+    if (!ecs_checkEntityID(ecs, id))
+        return ECS_RES_INVALID_PARAMS;
+    if (!ecs_checkEntityExists(ecs, id))
+        return ECS_RES_ENTITY_NOT_FOUND;
+    for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        if (!(desc->compMask & ECS_COMP_MASK(compType)))
+            continue;
+        compId = ecs_compIndex(ecs, id, compType);
+        pool = ecs->pool + compType;
+        memcpy(comp.data, ecs_poolData(pool, compId), pool->elemSize);
+        res = ecs_prefabSetComp(ecs, prefab, compType, &comp);
+        if (res != ECS_RES_OK)
+            return res;
+        memcpy(prefab->callback[compType], ecs_poolCallbacks(pool, compId),
+               sizeof(prefab->callback[compType]));
+    }
+    prefab->tags = ecs_slotTags(ecs, ECS_ENTITY_INDEX(id));
+    prefab->self = id;
+    return ECS_RES_OK;
+}
+
+ECSStatus ecs_prefabAddEntityRef(ECSPrefab *const prefab,
+                                 const uint32_t compType, const size_t offset) {
+    if (!ecs_checkCompType(compType) ||
+        prefab->nRefs[compType] == ECS_PREFAB_MAX_REFS)
+        return ECS_RES_INVALID_PARAMS;
+    prefab->refOffset[compType][prefab->nRefs[compType]++] = offset;
+    return ECS_RES_OK;
+}
+
+// Run a system callback on a range of dense indices of its pool
+static void ecs_execSystemRange(ECS *const ecs, const uint32_t compType,
+                                const uint32_t cbType, size_t first,
+                                const size_t end, void *cbUserData) {
+    const ECSCompPool *const pool = ecs->pool + compType;
+    const ECSSystemCallback sys = pool->system[cbType];
+    size_t count;
+
+    // Callbacks can unregister components, so the pool size is checked again
+    while (sys && first < end && first < pool->nComp) {
+        count = ECS_POOL_CHUNK_SIZE - first % ECS_POOL_CHUNK_SIZE;
+        if (count > end - first)
+            count = end - first;
+        if (count > pool->nComp - first)
+            count = pool->nComp - first;
+        sys(cbType, compType, count, ecs_poolOwner(pool, first),
+            ecs_poolData(pool, first), cbUserData);
+        first += count;
+    }
+}
+
+ECSStatus ecs_instantiatePrefab(ECS *const ecs, const ECSPrefab *const prefab,
+                                const size_t count, ECSEntityID *const idsOut,
+                                const uint32_t createCbType,
+                                void *cbUserData) {
+    size_t firstComp[ECS_COMPONENT_TYPES];
+    ECSComponentCallback cb;
+    ECSEntityDesc *desc;
+    ECSCompPool *pool;
+    ECSParkList *parked;
+    uint8_t *data;
+    uint32_t compType, cbType, ref, compId;
+    size_t i, nReused;
+
+    if (createCbType != ECS_INVALID_ID && !ecs_checkCallbackType(createCbType))
+        return ECS_RES_INVALID_PARAMS;
+    if (count == 0)
+        return ECS_RES_OK;
+    ecs_checkStructChange(ecs, 1, prefab->mask, "prefab instantiated");
+    parked = ecs_parkList(ecs, prefab->mask);
+    nReused = parked == NULL ? 0 : parked->nSlot;
+    if (nReused > count)
+        nReused = count;
+    if (!ecs_entReserve(ecs, count - nReused)) {
+        logMsg(LOG_LVL_WARN, "can't reserve %u entities", count);
+        return ECS_RES_ENTITY_BUFF_FULL;
+    }
+    for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        pool = ecs->pool + compType;
+        if (!(prefab->mask & ECS_COMP_MASK(compType)))
+            continue;
+        while (pool->nComp + pool->nParked + count - nReused >
+               pool->nChunks * ECS_POOL_CHUNK_SIZE) {
+            if (!ecs_poolGrow(pool)) {
+                logMsg(LOG_LVL_ERR, "can't grow pool of comp. type %u",
+                       compType);
+                return ECS_RES_COMP_BUFF_FULL;
+            }
+        }
+    }
+
+    for (i = 0; i < nReused; i++)
+        idsOut[i] = ecs_unparkSlot(ecs, parked->slot[--parked->nSlot],
+                                   prefab->name);
+    ecs->nParkedEnt -= nReused;
+    for (; i < count; i++)
+        idsOut[i] = ecs_entityAlloc(ecs, prefab->name);
+    if (prefab->tags)
+        for (i = 0; i < count; i++)
+            ecs_slotSetTags(ecs, ECS_ENTITY_INDEX(idsOut[i]), prefab->tags, 0);
+    for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        pool = ecs->pool + compType;
+        if (!(prefab->mask & ECS_COMP_MASK(compType)))
+            continue;
+        firstComp[compType] = pool->nComp;
+        ecs_poolBumpEpoch(pool);
+        // Reactivated components go first, right after the active ones, and
+        // are then reset like the new ones
+        for (i = 0; i < nReused; i++) {
+            compId = ecs_poolIndex(pool, idsOut[i]);
+            if (compId != pool->nComp + i)
+                ecs_poolSwap(ecs, compType, pool->nComp + i, compId, 0);
+            ecs_poolDropCallbacks(pool, pool->nComp + i);
+        }
+        pool->nComp += nReused;
+        pool->nParked -= nReused;
+        ecs_poolMakeRoom(ecs, compType, count - nReused);
+        pool->nComp = firstComp[compType];
+        for (i = 0; i < count; i++) {
+            compId = pool->nComp + i;
+            data = ecs_poolData(pool, compId);
+            memcpy(data, prefab->data[compType], pool->elemSize);
+            for (ref = 0; ref < prefab->nRefs[compType]; ref++) {
+                ECSEntityID *const field =
+                    (ECSEntityID *)(data + prefab->refOffset[compType][ref]);
+                if (*field == prefab->self)
+                    *field = idsOut[i];
+            }
+            memcpy(ecs_poolCallbacks(pool, compId), prefab->callback[compType],
+                   sizeof(prefab->callback[compType]));
+            ecs_poolMarkChanged(pool, compId, ecs->tick);
+            *ecs_poolOwner(pool, compId) = idsOut[i];
+            ecs_poolSetIndex(pool, idsOut[i], compId);
+            desc = ecs_entDesc(ecs, idsOut[i]);
+            desc->compMask = prefab->mask;
+            ecs_observeAdd(ecs, compType, idsOut[i]);
+        }
+        pool->nComp += count;
+        ecs->nComp += count;
+        if (pool->nComp > pool->peakComp)
+            pool->peakComp = pool->nComp;
+        for (cbType = 0; cbType < ECS_COMPONENT_CALLBACK_TYPES; cbType++)
+            if (prefab->callback[compType][cbType])
+                pool->nInstanceCb[cbType] += count;
+    }
+    for (i = 0; i < ecs->nQuery; i++) {
+        if (!ecs_queryMatches(ecs->query[i], prefab->mask))
+            continue;
+        for (size_t j = 0; j < count; j++)
+            ecs_queryAdd(ecs, ecs->query[i], idsOut[j]);
+    }
+    logMsg(LOG_LVL_INFO, "instantiated %u entities of prefab \"%s\"", count,
+           prefab->name);
+
+    if (createCbType == ECS_INVALID_ID)
+        return ECS_RES_OK;
+    for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        if (!(prefab->mask & ECS_COMP_MASK(compType)))
+            continue;
+        ecs_execSystemRange(ecs, compType, createCbType, firstComp[compType],
+                            firstComp[compType] + count, cbUserData);
+        cb = prefab->callback[compType][createCbType];
+        for (i = 0; cb && i < count; i++) {
+            if (!ecs_idAlive(ecs, idsOut[i]))
+                continue;
+            compId = ecs_compIndex(ecs, idsOut[i], compType);
+            if (compId != ECS_INVALID_ID)
+                cb(createCbType, idsOut[i], compId, compType,
+                   ecs_poolData(ecs->pool + compType, compId), cbUserData);
+        }
+    }
+    return ECS_RES_OK;
+}
+
+#define ECS_SNAPSHOT_ALIGN(size) (((size) + 7) & ~(size_t)7)
+
+// Index of a callback in the snapshot callback table, ECS_INVALID_ID if it
+// was not registered
+static uint32_t ecs_snapshotCallbackIndex(const ECS *const ecs,
+                                          const ECSComponentCallback cb) {
+    for (size_t i = 0; i < ecs->nSnapCb; i++)
+        if (ecs->snapCb[i] == cb)
+            return i;
+    return ECS_INVALID_ID;
+}
+
+ECSStatus ecs_registerSnapshotCallback(ECS *const ecs,
+                                       const ECSComponentCallback cb) {
+    ECSComponentCallback *snapCb;
+    size_t cap;
+
+    if (cb == NULL)
+        return ECS_RES_INVALID_PARAMS;
+    if (ecs_snapshotCallbackIndex(ecs, cb) != ECS_INVALID_ID)
+        return ECS_RES_OK;
+    if (ecs->nSnapCb == ecs->snapCbCap) {
+        cap = ecs->snapCbCap ? ecs->snapCbCap * 2 : 16;
+        snapCb = realloc(ecs->snapCb, cap * sizeof(*snapCb));
+        if (snapCb == NULL) {
+            logMsg(LOG_LVL_ERR, "can't grow snapshot callback table to %u",
+                   cap);
+            return ECS_RES_CALLBACK_NOT_FOUND;
+        }
+        ecs->snapCb = snapCb;
+        ecs->snapCbCap = cap;
+    }
+    ecs->snapCb[ecs->nSnapCb++] = cb;
+    return ECS_RES_OK;
+}
+
+// Total size of a snapshot described by its header
+static size_t ecs_snapshotLayoutSize(const ECSSnapshotHeader *const hdr) {
+    size_t size = ECS_SNAPSHOT_ALIGN(sizeof(*hdr));
+    size += ECS_SNAPSHOT_ALIGN(hdr->nEntIds * sizeof(ECSSnapshotEnt));
+    size += ECS_SNAPSHOT_ALIGN(hdr->nActiveEnt * sizeof(ECSEntityID));
+    size += ECS_SNAPSHOT_ALIGN(hdr->nFreeEnt * sizeof(ECSEntityID));
+    for (uint32_t compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        size += ECS_SNAPSHOT_ALIGN(hdr->nComp[compType] * sizeof(ECSEntityID));
+        size += ECS_SNAPSHOT_ALIGN((size_t)hdr->nComp[compType] *
+                                   hdr->elemSize[compType]);
+        if (hdr->callbackMask & ECS_COMP_MASK(compType))
+            size += ECS_SNAPSHOT_ALIGN((size_t)hdr->nComp[compType] *
+                                       ECS_COMPONENT_CALLBACK_TYPES *
+                                       sizeof(uint32_t));
+    }
+    return size + ECS_SNAPSHOT_ALIGN(hdr->nameBytes);
+}
+
+static void ecs_snapshotHeader(const ECS *const ecs,
+                               ECSSnapshotHeader *const hdr) {
+    uint32_t compType, cbType;
+
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic = ECS_SNAPSHOT_MAGIC;
+    hdr->version = ECS_SNAPSHOT_VERSION;
+    hdr->compTypes = ECS_COMPONENT_TYPES;
+    hdr->nEntIds = ecs->nEntIds;
+    hdr->nActiveEnt = ecs->nActiveEnt;
+    // Parked entities are saved as free slots
+    hdr->nFreeEnt = fifo_av_read(&ecs->freeEntId) + ecs->nParkedEnt;
+    for (size_t i = 0; i < ecs->nameCap; i++)
+        if (ecs->names[i].str != NULL)
+            hdr->nameBytes += strlen(ecs->names[i].str) + 1;
+    for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        hdr->elemSize[compType] = ecs->pool[compType].elemSize;
+        hdr->nComp[compType] = ecs->pool[compType].nComp;
+        for (cbType = 0; cbType < ECS_COMPONENT_CALLBACK_TYPES; cbType++)
+            if (ecs->pool[compType].nInstanceCb[cbType])
+                hdr->callbackMask |= ECS_COMP_MASK(compType);
+    }
+}
+
+size_t ecs_snapshotSize(const ECS *const ecs) {
+    ECSSnapshotHeader hdr;
+    ecs_snapshotHeader(ecs, &hdr);
+    return ecs_snapshotLayoutSize(&hdr);
+}
+
+ECSStatus ecs_saveSnapshot(const ECS *const ecs, void *const buf,
+                           const size_t size) {
+    ECSSnapshotHeader hdr;
+    ECSSnapshotEnt *ent;
+    const ECSEntityDesc *desc;
+    const ECSCompPool *pool;
+    uint8_t *pos = buf;
+    ECSComponentCallback cb;
+    uint32_t *callbacks;
+    ECSStatus res;
+    size_t i, j, chunk, count, nameLen, nameOffset = 0;
+    uint32_t compType, cbType, index;
+
+    ecs_snapshotHeader(ecs, &hdr);
+    if (size < ecs_snapshotLayoutSize(&hdr)) {
+        logMsg(LOG_LVL_ERR, "snapshot buffer too small: %u vs %u", size,
+               ecs_snapshotLayoutSize(&hdr));
+        return ECS_RES_INVALID_PARAMS;
+    }
+    memset(buf, 0, ecs_snapshotLayoutSize(&hdr));
+    memcpy(pos, &hdr, sizeof(hdr));
+    pos += ECS_SNAPSHOT_ALIGN(sizeof(hdr));
+
+    ent = (ECSSnapshotEnt *)pos;
+    for (i = 0; i < ecs->nEntIds; i++) {
+        desc = ecs->entDesc + i;
+        ent[i].generation = desc->generation;
+        ent[i].activePos = desc->activePos;
+        ent[i].compMask =
+            desc->activePos == ECS_INVALID_ID ? 0 : desc->compMask;
+        ent[i].nameOffset = ECS_INVALID_ID;
+        ent[i].tags = ecs_slotTags(ecs, i);
+    }
+    pos += ECS_SNAPSHOT_ALIGN(hdr.nEntIds * sizeof(ECSSnapshotEnt));
+    memcpy(pos, ecs->activeEnt, hdr.nActiveEnt * sizeof(ECSEntityID));
+    pos += ECS_SNAPSHOT_ALIGN(hdr.nActiveEnt * sizeof(ECSEntityID));
+    for (i = 0; i < hdr.nFreeEnt - ecs->nParkedEnt; i++)
+        ((ECSEntityID *)pos)[i] =
+            ecs->freeEntId.buf[(ecs->freeEntId.r_pos + 1 + i) %
+                               ecs->freeEntId.size];
+    for (j = 0; j < ecs->nParkLists; j++) {
+        memcpy((ECSEntityID *)pos + i, ecs->park[j].slot,
+               ecs->park[j].nSlot * sizeof(ECSEntityID));
+        i += ecs->park[j].nSlot;
+    }
+    pos += ECS_SNAPSHOT_ALIGN(hdr.nFreeEnt * sizeof(ECSEntityID));
+
+    for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        pool = ecs->pool + compType;
+        for (chunk = 0; chunk * ECS_POOL_CHUNK_SIZE < pool->nComp; chunk++) {
+            count = pool->nComp - chunk * ECS_POOL_CHUNK_SIZE;
+            if (count > ECS_POOL_CHUNK_SIZE)
+                count = ECS_POOL_CHUNK_SIZE;
+            memcpy((ECSEntityID *)pos + chunk * ECS_POOL_CHUNK_SIZE,
+                   pool->chunk[chunk].owner, count * sizeof(ECSEntityID));
+        }
+        pos += ECS_SNAPSHOT_ALIGN(pool->nComp * sizeof(ECSEntityID));
+        for (chunk = 0; chunk * ECS_POOL_CHUNK_SIZE < pool->nComp; chunk++) {
+            count = pool->nComp - chunk * ECS_POOL_CHUNK_SIZE;
+            if (count > ECS_POOL_CHUNK_SIZE)
+                count = ECS_POOL_CHUNK_SIZE;
+            memcpy(pos + chunk * ECS_POOL_CHUNK_SIZE * pool->elemSize,
+                   pool->chunk[chunk].data, count * pool->elemSize);
+        }
+        for (i = 0; pool->snapSave != NULL && i < pool->nComp; i++) {
+            res = pool->snapSave(*ecs_poolOwner(pool, i), compType,
+                                 pos + i * pool->elemSize, pool->snapUserData);
+            if (res != ECS_RES_OK) {
+                logMsg(LOG_LVL_ERR,
+                       "comp. type %u of entity %u can't be saved in a "
+                       "snapshot",
+                       compType, *ecs_poolOwner(pool, i));
+                return res;
+            }
+        }
+        pos += ECS_SNAPSHOT_ALIGN(pool->nComp * pool->elemSize);
+        if (!(hdr.callbackMask & ECS_COMP_MASK(compType)))
+            continue;
+        callbacks = (uint32_t *)pos;
+        for (i = 0; i < pool->nComp; i++) {
+            for (cbType = 0; cbType < ECS_COMPONENT_CALLBACK_TYPES;
+                 cbType++, callbacks++) {
+                cb = ecs_poolCallbacks(pool, i)[cbType];
+                if (cb == NULL)
+                    continue;
+                index = ecs_snapshotCallbackIndex(ecs, cb);
+                if (index == ECS_INVALID_ID) {
+                    logMsg(LOG_LVL_ERR,
+                           "callback %u of comp. type %u of entity %u not "
+                           "registered for snapshots",
+                           cbType, compType, *ecs_poolOwner(pool, i));
+                    return ECS_RES_CALLBACK_NOT_FOUND;
+                }
+                *callbacks = index + 1;
+            }
+        }
+        pos += ECS_SNAPSHOT_ALIGN(pool->nComp * ECS_COMPONENT_CALLBACK_TYPES *
+                                  sizeof(uint32_t));
+    }
+
+    // Every interned name is stored once, for all the entities using it
+    for (i = 0; i < ecs->nameCap; i++) {
+        if (ecs->names[i].str == NULL)
+            continue;
+        nameLen = strlen(ecs->names[i].str) + 1;
+        memcpy(pos + nameOffset, ecs->names[i].str, nameLen);
+        for (index = ecs->names[i].firstEnt; index != ECS_INVALID_ID;
+             index = ecs->entDesc[index].nameNext)
+            ent[index].nameOffset = nameOffset;
+        nameOffset += nameLen;
+    }
+    return ECS_RES_OK;
+}
+
+// Sections of a snapshot buffer
+typedef struct ECSSnapshotView {
+    ECSSnapshotHeader hdr;
+    const ECSSnapshotEnt *ent;
+    const ECSEntityID *activeEnt;
+    const ECSEntityID *freeEnt;
+    const ECSEntityID *owners[ECS_COMPONENT_TYPES];
+    const uint8_t *data[ECS_COMPONENT_TYPES];
+    // Null for the types without stored callbacks
+    const uint32_t *callbacks[ECS_COMPONENT_TYPES];
+    const char *names;
+} ECSSnapshotView;
+
+static ECSStatus ecs_snapshotCorrupted(const char *const what,
+                                       const size_t i) {
+    logMsg(LOG_LVL_ERR, "corrupted snapshot: %s %u", what, i);
+    return ECS_RES_INVALID_PARAMS;
+}
+
+// Check that every index of the snapshot is consistent, so that loading it
+// can't fail halfway or corrupt the ECS
+static ECSStatus ecs_snapshotCheckIndices(const ECS *const ecs,
+                                          const ECSSnapshotView *const view,
+                                          uint8_t *const seen) {
+    const ECSSnapshotHeader *const hdr = &view->hdr;
+    const ECSSnapshotEnt *ent;
+    uint32_t nOwned[ECS_COMPONENT_TYPES] = {0};
+    uint32_t compType;
+    ECSEntityID id;
+    size_t i, index;
+
+    for (i = 0; i < hdr->nEntIds; i++) {
+        ent = view->ent + i;
+        if (ent->generation > ECS_ENTITY_GENERATION_MASK ||
+            (ent->compMask & ~ECS_COMP_MASK_ALL))
+            return ecs_snapshotCorrupted("entity slot", i);
+        if (ent->nameOffset != ECS_INVALID_ID &&
+            ent->nameOffset >= hdr->nameBytes)
+            return ecs_snapshotCorrupted("name offset of slot", i);
+        if (ent->activePos == ECS_INVALID_ID) {
+            if (ent->compMask)
+                return ecs_snapshotCorrupted("components of free slot", i);
+            continue;
+        }
+        if (ent->activePos >= hdr->nActiveEnt ||
+            view->activeEnt[ent->activePos] !=
+                ECS_ENTITY_ID(i, ent->generation))
+            return ecs_snapshotCorrupted("active position of slot", i);
+        for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++)
+            nOwned[compType] += !!(ent->compMask & ECS_COMP_MASK(compType));
+    }
+    // Each active entity points back to its slot, so both lists match
+    for (i = 0; i < hdr->nActiveEnt; i++) {
+        index = ECS_ENTITY_INDEX(view->activeEnt[i]);
+        if (index >= hdr->nEntIds || view->ent[index].activePos != i)
+            return ecs_snapshotCorrupted("active entity", i);
+    }
+    // There are as many free slots as inactive ones, so each must be listed
+    // once
+    for (i = 0; i < hdr->nFreeEnt; i++) {
+        index = view->freeEnt[i];
+        if (index >= hdr->nEntIds ||
+            view->ent[index].activePos != ECS_INVALID_ID || seen[index])
+            return ecs_snapshotCorrupted("free slot", i);
+        seen[index] = 1;
+    }
+    // Owners are active, hence not marked by the free slots, and each one is
+    // marked with its component type
+    for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        if (hdr->nComp[compType] != nOwned[compType])
+            return ecs_snapshotCorrupted("component count of type", compType);
+        for (i = 0; i < hdr->nComp[compType]; i++) {
+            id = view->owners[compType][i];
+            index = ECS_ENTITY_INDEX(id);
+            if (index >= hdr->nEntIds ||
+                view->ent[index].activePos == ECS_INVALID_ID ||
+                ECS_ENTITY_GENERATION(id) != view->ent[index].generation ||
+                !(view->ent[index].compMask & ECS_COMP_MASK(compType)) ||
+                seen[index] == compType + 2)
+                return ecs_snapshotCorrupted("owner of component", i);
+            seen[index] = compType + 2;
+        }
+    }
+    // Callbacks must be in the table of this program
+    for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        for (i = 0; view->callbacks[compType] != NULL &&
+                    i < hdr->nComp[compType] * ECS_COMPONENT_CALLBACK_TYPES;
+             i++)
+            if (view->callbacks[compType][i] > ecs->nSnapCb)
+                return ecs_snapshotCorrupted("callback index",
+                                             view->callbacks[compType][i]);
+    }
+    // Names are read up to their NUL
+    if (hdr->nameBytes && view->names[hdr->nameBytes - 1] != '\0')
+        return ecs_snapshotCorrupted("name section of size", hdr->nameBytes);
+    return ECS_RES_OK;
+}
+
+// Locate the sections of a snapshot and validate it
+static ECSStatus ecs_snapshotView(const ECS *const ecs, const void *const buf,
+                                  const size_t size,
+                                  ECSSnapshotView *const view) {
+    ECSSnapshotHeader *const hdr = &view->hdr;
+    const uint8_t *pos = buf;
+    ECSStatus res;
+    uint32_t compType;
+    uint8_t *seen;
+
+    if (size < sizeof(*hdr))
+        return ECS_RES_INVALID_PARAMS;
+    memcpy(hdr, buf, sizeof(*hdr));
+    if (hdr->magic != ECS_SNAPSHOT_MAGIC ||
+        hdr->version != ECS_SNAPSHOT_VERSION) {
+        logMsg(LOG_LVL_ERR, "not a snapshot of version %u",
+               ECS_SNAPSHOT_VERSION);
+        return ECS_RES_INVALID_PARAMS;
+    }
+    if (hdr->compTypes != ECS_COMPONENT_TYPES ||
+        hdr->nEntIds > ECS_MAX_ENTITY_SLOTS ||
+        hdr->nActiveEnt + hdr->nFreeEnt != hdr->nEntIds ||
+        size < ecs_snapshotLayoutSize(hdr)) {
+        logMsg(LOG_LVL_ERR, "corrupted snapshot");
+        return ECS_RES_INVALID_PARAMS;
+    }
+    for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        if (hdr->elemSize[compType] != ecs->pool[compType].elemSize) {
+            logMsg(LOG_LVL_ERR, "size of comp. type %u is %u in snapshot",
+                   compType, hdr->elemSize[compType]);
+            return ECS_RES_INVALID_PARAMS;
+        }
+    }
+
+    pos += ECS_SNAPSHOT_ALIGN(sizeof(*hdr));
+    view->ent = (const ECSSnapshotEnt *)pos;
+    pos += ECS_SNAPSHOT_ALIGN(hdr->nEntIds * sizeof(ECSSnapshotEnt));
+    view->activeEnt = (const ECSEntityID *)pos;
+    pos += ECS_SNAPSHOT_ALIGN(hdr->nActiveEnt * sizeof(ECSEntityID));
+    view->freeEnt = (const ECSEntityID *)pos;
+    pos += ECS_SNAPSHOT_ALIGN(hdr->nFreeEnt * sizeof(ECSEntityID));
+    for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        view->owners[compType] = (const ECSEntityID *)pos;
+        pos += ECS_SNAPSHOT_ALIGN(hdr->nComp[compType] * sizeof(ECSEntityID));
+        view->data[compType] = pos;
+        pos += ECS_SNAPSHOT_ALIGN((size_t)hdr->nComp[compType] *
+                                  hdr->elemSize[compType]);
+        view->callbacks[compType] = NULL;
+        if (!(hdr->callbackMask & ECS_COMP_MASK(compType)))
+            continue;
+        view->callbacks[compType] = (const uint32_t *)pos;
+        pos += ECS_SNAPSHOT_ALIGN((size_t)hdr->nComp[compType] *
+                                  ECS_COMPONENT_CALLBACK_TYPES *
+                                  sizeof(uint32_t));
+    }
+    view->names = (const char *)pos;
+
+    seen = calloc(hdr->nEntIds + 1, 1);
+    if (seen == NULL) {
+        logMsg(LOG_LVL_ERR, "can't allocate snapshot check of %u slots",
+               hdr->nEntIds);
+        return ECS_RES_ENTITY_BUFF_FULL;
+    }
+    res = ecs_snapshotCheckIndices(ecs, view, seen);
+    free(seen);
+    return res;
+}
+
+ECSStatus ecs_checkSnapshot(const ECS *const ecs, const void *const buf,
+                            const size_t size) {
+    ECSSnapshotView view;
+    return ecs_snapshotView(ecs, buf, size, &view);
+}
+
+ECSStatus ecs_loadSnapshot(ECS *const ecs, const void *const buf,
+                           const size_t size) {
+    ECSSnapshotView view;
+    const ECSSnapshotHeader *const hdr = &view.hdr;
+    const uint32_t *callbacks;
+    ECSEntityDesc *desc;
+    ECSCompPool *pool;
+    ECSComponentCallback *cb;
+    size_t i, chunk, count, newCap;
+    uint32_t compType, cbType;
+    ECSStatus res;
+
+    res = ecs_snapshotView(ecs, buf, size, &view);
+    if (res != ECS_RES_OK)
+        return res;
+    ecs_checkStructChange(ecs, 1, ECS_COMP_MASK_ALL, "snapshot loaded");
+    if (hdr->nEntIds > ecs->entCap) {
+        newCap = ecs->entCap;
+        while (newCap < hdr->nEntIds)
+            newCap *= 2;
+        if (newCap > ECS_MAX_ENTITY_SLOTS)
+            newCap = ECS_MAX_ENTITY_SLOTS;
+        if (!ecs_entGrow(ecs, newCap))
+            return ECS_RES_ENTITY_BUFF_FULL;
+    }
+    for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        pool = ecs->pool + compType;
+        while (pool->nChunks * ECS_POOL_CHUNK_SIZE < hdr->nComp[compType]) {
+            if (!ecs_poolGrow(pool))
+                return ECS_RES_COMP_BUFF_FULL;
+        }
+    }
+
+    // Entities
+    for (i = 0; i < ecs->nameCap; i++)
+        free(ecs->names[i].str);
+    if (ecs->names != NULL)
+        memset(ecs->names, 0, ecs->nameCap * sizeof(ECSName));
+    ecs->nNames = 0;
+    for (i = 0; i < ecs->nParkLists; i++)
+        ecs->park[i].nSlot = 0;
+    ecs->nParkedEnt = 0;
+    for (i = 0; i < ECS_TAG_TYPES; i++)
+        if (ecs->tagBits[i] != NULL)
+            memset(ecs->tagBits[i], 0, ecs->nTagWords * sizeof(uint64_t));
+    for (i = 0; i < ecs->nEntIds || i < hdr->nEntIds; i++) {
+        desc = ecs->entDesc + i;
+        desc->obsPending = 0;
+        desc->name = NULL;
+        desc->namePrev = desc->nameNext = ECS_INVALID_ID;
+        if (i >= hdr->nEntIds) {
+            // Slots handed out again later keep a newer generation than the
+            // handles taken before the load
+            desc->generation =
+                (desc->generation + 1) & ECS_ENTITY_GENERATION_MASK;
+            desc->activePos = ECS_INVALID_ID;
+            desc->compMask = 0;
+            continue;
+        }
+        ecs_slotSetTags(ecs, i, view.ent[i].tags, 0);
+        desc->generation = view.ent[i].generation;
+        desc->activePos = view.ent[i].activePos;
+        desc->compMask = view.ent[i].compMask;
+    }
+    memcpy(ecs->activeEnt, view.activeEnt,
+           hdr->nActiveEnt * sizeof(ECSEntityID));
+    ecs->nActiveEnt = hdr->nActiveEnt;
+    if (ecs->nActiveEnt > ecs->peakActiveEnt)
+        ecs->peakActiveEnt = ecs->nActiveEnt;
+    ecs->nEntIds = hdr->nEntIds;
+    fifo_init(&ecs->freeEntId, (int32_t *)ecs->freeEntIdBuf, ecs->entCap + 1,
+              FIFO_MODE_NO_OVERRUN);
+    for (i = 0; i < hdr->nFreeEnt; i++)
+        fifo_write(&ecs->freeEntId, view.freeEnt[i]);
+
+    // Components
+    ecs->nComp = 0;
+    for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        pool = ecs->pool + compType;
+        ecs_poolBumpEpoch(pool);
+        pool->nComp = hdr->nComp[compType];
+        pool->nParked = 0;
+        ecs->nComp += pool->nComp;
+        if (pool->nComp > pool->peakComp)
+            pool->peakComp = pool->nComp;
+        for (chunk = 0; chunk * ECS_POOL_CHUNK_SIZE < pool->nComp; chunk++) {
+            count = pool->nComp - chunk * ECS_POOL_CHUNK_SIZE;
+            if (count > ECS_POOL_CHUNK_SIZE)
+                count = ECS_POOL_CHUNK_SIZE;
+            memcpy(pool->chunk[chunk].owner,
+                   view.owners[compType] + chunk * ECS_POOL_CHUNK_SIZE,
+                   count * sizeof(ECSEntityID));
+            memcpy(pool->chunk[chunk].data,
+                   view.data[compType] +
+                       chunk * ECS_POOL_CHUNK_SIZE * pool->elemSize,
+                   count * pool->elemSize);
+        }
+
+        memset(pool->nInstanceCb, 0, sizeof(pool->nInstanceCb));
+        pool->obsAdded.nEnt = 0;
+        pool->obsRemoved.nEnt = 0;
+        for (chunk = 0; chunk < pool->nChunks; chunk++)
+            memset(pool->chunk[chunk].changed, 0,
+                   sizeof(pool->chunk[chunk].changed));
+        // The sparse index is rebuilt from the owners
+        for (i = 0; i < pool->nSparsePages; i++) {
+            if (pool->sparse[i] != NULL)
+                memset(pool->sparse[i], 0xff,
+                       ECS_SPARSE_PAGE_SIZE * sizeof(uint32_t));
+        }
+        callbacks = view.callbacks[compType];
+        for (i = 0; i < pool->nComp; i++) {
+            ecs_poolSetIndex(pool, *ecs_poolOwner(pool, i), i);
+            ecs_poolMarkChanged(pool, i, ecs->tick);
+            cb = ecs_poolCallbacks(pool, i);
+            memset(cb, 0, sizeof(*ecs_poolChunk(pool, i)->callback));
+            if (callbacks == NULL)
+                continue;
+            for (cbType = 0; cbType < ECS_COMPONENT_CALLBACK_TYPES;
+                 cbType++, callbacks++) {
+                if (*callbacks == 0)
+                    continue;
+                cb[cbType] = ecs->snapCb[*callbacks - 1];
+                pool->nInstanceCb[cbType]++;
+            }
+        }
+        ecs_poolShrink(pool);
+    }
+
+    for (i = 0; i < hdr->nEntIds; i++)
+        if (view.ent[i].nameOffset != ECS_INVALID_ID)
+            ecs_nameAttach(ecs, i, view.names + view.ent[i].nameOffset);
+
+    // Refill the queries and drop the pending commands
+    for (i = 0; i < ecs->nQuery; i++) {
+        ECSQuery *const query = ecs->query[i];
+        query->nEnt = 0;
+        memset(query->entPos, 0xff, query->entPosCap * sizeof(uint32_t));
+        for (size_t j = 0; j < ecs->nActiveEnt; j++)
+            if (ecs_queryMatches(query,
+                                 ecs_entDesc(ecs, ecs->activeEnt[j])->compMask))
+                ecs_queryAdd(ecs, query, ecs->activeEnt[j]);
+    }
+    for (i = 0; i < ecs->nCmdBuf; i++) {
+        ecs->cmdBuf[i].nCmd = 0;
+        ecs->cmdBuf[i].dataSize = 0;
+        ecs->cmdBuf[i].nNewEnt = 0;
+        ecs->cmdBuf[i].newEntDone = 0;
+    }
+
+    // Restore the pointers held by the components
+    for (compType = 0; compType < ECS_COMPONENT_TYPES; compType++) {
+        pool = ecs->pool + compType;
+        for (i = 0; pool->snapLoad != NULL && i < pool->nComp; i++) {
+            res = pool->snapLoad(*ecs_poolOwner(pool, i), compType,
+                                 ecs_poolData(pool, i), pool->snapUserData);
+            if (res != ECS_RES_OK)
+                logMsg(LOG_LVL_WARN,
+                       "comp. type %u of entity %u not fully restored",
+                       compType, *ecs_poolOwner(pool, i));
         }
     }
+    logMsg(LOG_LVL_INFO, "loaded snapshot of %u entities and %u components",
+           ecs->nActiveEnt, ecs->nComp);
     return ECS_RES_OK;
 }
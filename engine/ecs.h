@@ -1,22 +1,73 @@
 #pragma once
 
 #define ECS_COMPONENT_TYPES 10
-#define ECS_MAX_ENTITIES 256
-#define ECS_MAX_COMPONENTS 1024
+// Default entity capacity reserved by ecs_init
+#define ECS_DEFAULT_RESERVE 256
+// Components per pool chunk. Must be a power of 2, at least 64.
+#define ECS_POOL_CHUNK_SIZE 256
+// Entity slots per page of the pool sparse index. Must be a power of 2.
+#define ECS_SPARSE_PAGE_SIZE 1024
 #define ECS_COMPONENT_DATA_SIZE 216
 #define ECS_COMPONENT_CALLBACK_TYPES 8
+// Tags are data-less component types stored as bitsets over the entity slots
+#define ECS_TAG_TYPES 64
+// Entity slots scanned at once by ecs_queryTags. Must be a multiple of 64.
+#define ECS_TAG_BLOCK 256
 
 #define ECS_INVALID_ID 0xffffffff
 
+// Abort on structural changes made while a read section is open on the
+// changed component types. On unless NDEBUG is defined.
+#ifndef ECS_CHECK_ACCESS
+#ifdef NDEBUG
+#define ECS_CHECK_ACCESS 0
+#else
+#define ECS_CHECK_ACCESS 1
+#endif
+#endif
+
+// Entity IDs are made of a slot index (low bits) and the generation of the
+// slot (high bits). The generation is bumped whenever the slot is freed, so
+// IDs of unregistered entities are never valid again after slot reuse.
+#define ECS_ENTITY_INDEX_BITS 20
+#define ECS_ENTITY_INDEX_MASK ((1u << ECS_ENTITY_INDEX_BITS) - 1)
+#define ECS_ENTITY_GENERATION_MASK (0xffffffffu >> ECS_ENTITY_INDEX_BITS)
+// Max. entity count. The last slot index is never used, so that no valid ID
+// can be equal to ECS_INVALID_ID.
+#define ECS_MAX_ENTITY_SLOTS ECS_ENTITY_INDEX_MASK
+
+// Entity reference in prefab component data, replaced by the ID of each
+// instance. Its slot index is never used by valid IDs.
+#define ECS_PREFAB_SELF ECS_ENTITY_INDEX_MASK
+// Max. entity reference fields per component type in a prefab
+#define ECS_PREFAB_MAX_REFS 4
+
+#define ECS_ENTITY_INDEX(id) ((id) & ECS_ENTITY_INDEX_MASK)
+#define ECS_ENTITY_GENERATION(id) ((id) >> ECS_ENTITY_INDEX_BITS)
+#define ECS_ENTITY_ID(index, generation)                                       \
+    (((generation) << ECS_ENTITY_INDEX_BITS) | (index))
+
 #include "./dsa.h"
 #include "./fifo.h"
+#include "./jobs.h"
 #include "./logger.h"
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
 typedef uint32_t ECSEntityID;
 typedef uint32_t ECSComponentID;
+// Bit mask of component types
+typedef uint32_t ECSCompMask;
+
+#define ECS_COMP_MASK(compType) ((ECSCompMask)1 << (compType))
+#define ECS_COMP_MASK_ALL                                                      \
+    ((ECSCompMask)(((uint64_t)1 << ECS_COMPONENT_TYPES) - 1))
+// Bit mask of tags
+typedef uint64_t ECSTagMask;
+
+#define ECS_TAG_MASK(tag) ((ECSTagMask)1 << (tag))
 
 typedef enum ECSStatusEnum {
     ECS_RES_OK,
@@ -38,56 +89,444 @@ const static char *ECSStatusStr[] = {"ECS_RES_OK",
                                      "ECS_RES_COMP_DUPLICATE",
                                      "ECS_RES_CALLBACK_NOT_FOUND"};
 
-typedef struct ECSComponent ECSComponent;
 typedef void (*ECSComponentCallback)(uint32_t cbType, ECSEntityID entId,
                                      ECSComponentID compId, uint32_t compType,
-                                     struct ECSComponent *comp,
-                                     void *cbUserData);
+                                     void *compData, void *cbUserData);
+// Called after a component's data was moved to another address inside its
+// type's pool (e.g. to fill the hole left by an unregistered component).
+typedef void (*ECSCompRelocCallback)(ECSEntityID entId, uint32_t compType,
+                                     void *compData, void *userData);
+// Run by snapshots on each component of a type holding pointers. The save
+// hook gets the copy written to the snapshot, and replaces its pointers by
+// something a load can resolve, or fails the save. The load hook gets each
+// loaded component and restores them.
+typedef ECSStatus (*ECSSnapshotHook)(ECSEntityID entId, uint32_t compType,
+                                     void *compData, void *userData);
+// Callback of a whole component type. compData holds count packed components
+// owned by the entities in entIds.
+typedef void (*ECSSystemCallback)(uint32_t cbType, uint32_t compType,
+                                  size_t count, const ECSEntityID *entIds,
+                                  void *compData, void *cbUserData);
+// Sort key of a component for ecs_sortComp
+typedef uint64_t (*ECSSortKeyCallback)(uint32_t compType, ECSComponentID compId,
+                                       ECSEntityID entId, const void *compData,
+                                       void *userData);
+// Called by ecs_flushObservers with the entities that lost (removed) and
+// gained (added) a component of the observed type since the previous flush.
+// Removals come first: an entity whose component was unregistered and then
+// registered again is in both lists. Added entities still own the component,
+// and components added and removed between two flushes aren't reported.
+typedef void (*ECSObserverCallback)(uint32_t compType,
+                                    const ECSEntityID *removed,
+                                    size_t nRemoved, const ECSEntityID *added,
+                                    size_t nAdded, void *userData);
+
+// Entity IDs waiting to be delivered to an observer
+typedef struct ECSObserverList {
+    ECSEntityID *ent;
+    size_t nEnt;
+    // Capacity of ent, grows geometrically
+    size_t cap;
+} ECSObserverList;
 
+// Component data passed on registration. Only the first elemSize bytes of the
+// component type's pool are actually stored. Prefer ecs_registerCompData to
+// avoid copying the whole blob for small types.
 typedef struct ECSComponent {
-    // User component data
     uint8_t data[ECS_COMPONENT_DATA_SIZE];
-    // Callback function ptrs.
-    ECSComponentCallback callback[ECS_COMPONENT_CALLBACK_TYPES];
 } ECSComponent;
 
+// Fixed-size block of ECS_POOL_CHUNK_SIZE components. Chunks are never moved,
+// so component pointers stay valid while the pool grows.
+typedef struct ECSCompChunk {
+    // Component data, ECS_POOL_CHUNK_SIZE * elemSize bytes
+    uint8_t *data;
+    // Parent entity ID for each component
+    ECSEntityID *owner;
+    // Callback function ptrs. for each component
+    ECSComponentCallback (*callback)[ECS_COMPONENT_CALLBACK_TYPES];
+    // Tick of the last write of each component
+    uint32_t *changeTick;
+    // Components written during the current tick, one bit each
+    uint64_t changed[ECS_POOL_CHUNK_SIZE / 64];
+    // Tick of the last write of any component of the chunk
+    uint32_t lastChange;
+} ECSCompChunk;
+
+// Densely packed storage of all the components of a single type, as a sparse
+// set: the owners are the dense entity list, and the sparse index maps entity
+// slots to dense indices. Dense index i lives in chunk i / ECS_POOL_CHUNK_SIZE.
+// Unregistering a component moves the last one of the pool in its place.
+// The components of parked entities are kept right after the active ones.
+typedef struct ECSCompPool {
+    // Size of one component in bytes, a multiple of align
+    size_t elemSize;
+    // Alignment of the components, a power of 2
+    size_t align;
+    // Registered components count
+    size_t nComp;
+    // Components of parked entities count
+    size_t nParked;
+    // Highest registered components count so far
+    size_t peakComp;
+    // Allocated chunks count
+    size_t nChunks;
+    // Chunk table capacity, grows geometrically
+    size_t chunkCap;
+    ECSCompChunk *chunk;
+    // Dense index of the component of each entity slot, ECS_INVALID_ID if the
+    // entity has none. Pages of ECS_SPARSE_PAGE_SIZE slots are allocated on
+    // first use, so the index grows with the spread of the owners only.
+    uint32_t **sparse;
+    size_t nSparsePages;
+    // Optional relocation callback
+    ECSCompRelocCallback relocCb;
+    void *relocUserData;
+    // Optional snapshot hooks
+    ECSSnapshotHook snapSave;
+    ECSSnapshotHook snapLoad;
+    void *snapUserData;
+    // Callbacks run on all the components of the type
+    ECSSystemCallback system[ECS_COMPONENT_CALLBACK_TYPES];
+    // Component types read and written by each system callback. A system
+    // with no write mask has undeclared access and always runs serially.
+    ECSCompMask sysRead[ECS_COMPONENT_CALLBACK_TYPES];
+    ECSCompMask sysWrite[ECS_COMPONENT_CALLBACK_TYPES];
+    // Number of components with a per-instance callback, for each type
+    uint32_t nInstanceCb[ECS_COMPONENT_CALLBACK_TYPES];
+    // Tick of the last write of any component of the type
+    uint32_t lastChange;
+    // Open read sections on the type
+    uint32_t readers;
+    // Bumped by every registration, unregistration or move of a component
+    uint32_t epoch;
+    // Permutation left by an incremental ecs_sortComp: destination of each
+    // component, walked from sortPos. Valid while the epoch is sortEpoch and
+    // the key callback is sortKey.
+    uint32_t *sortDest;
+    size_t sortCap;
+    size_t sortLen;
+    size_t sortPos;
+    uint32_t sortEpoch;
+    ECSSortKeyCallback sortKey;
+    // Optional observer, and its pending notifications
+    ECSObserverCallback observer;
+    void *observerUserData;
+    ECSObserverList obsAdded;
+    ECSObserverList obsRemoved;
+} ECSCompPool;
+
 typedef struct ECSEntityDesc {
-    // User entity alias.
+    // User entity alias, interned by the ECS. Can be null.
     const char *name;
-    // Component indices in ecs_t comp for each type.
-    // Unassigned types have ECS_INVALID_ID index.
-    // This is the only place where a component's type is stored in the ECS.
-    uint32_t compIndex[ECS_COMPONENT_TYPES];
+    // Slot indices of the previous and next entities with the same name
+    uint32_t namePrev;
+    uint32_t nameNext;
+    // Current generation of the slot
+    uint32_t generation;
+    // Position in activeEnt, or ECS_INVALID_ID if the slot is free
+    uint32_t activePos;
+    // Types of the registered components
+    ECSCompMask compMask;
+    // Types of the components added since the last observer flush
+    ECSCompMask obsPending;
 } ECSEntityDesc;
 
+// Slot indices of the parked entities with the same component types
+typedef struct ECSParkList {
+    ECSCompMask mask;
+    size_t nSlot;
+    size_t cap;
+    uint32_t *slot;
+} ECSParkList;
+
+// Interned entity name, shared by all the entities with that name
+typedef struct ECSName {
+    // Owned copy of the name, null for empty table slots
+    char *str;
+    uint32_t hash;
+    // Number of entities with the name, and slot index of the first one
+    uint32_t nEnt;
+    uint32_t firstEnt;
+} ECSName;
+
+// Cached set of the entities owning all the component types of a mask, with
+// pointers to their components. The ECS keeps it up to date as components are
+// registered, unregistered or moved inside their pools.
+typedef struct ECSQuery {
+    ECSCompMask mask;
+    // Component types of the mask, in ascending order
+    uint32_t nTypes;
+    uint32_t types[ECS_COMPONENT_TYPES];
+    // Index in types of each component type
+    uint8_t column[ECS_COMPONENT_TYPES];
+    // Matching entities count
+    size_t nEnt;
+    // Capacity of ent and comp
+    size_t cap;
+    // Matching entity IDs, in no particular order
+    ECSEntityID *ent;
+    // For each of types, the component of every entity in ent
+    void **comp[ECS_COMPONENT_TYPES];
+    // Position in ent for each entity slot index, ECS_INVALID_ID if absent
+    uint32_t *entPos;
+    size_t entPosCap;
+} ECSQuery;
+
+// System callback run on a single pool chunk by a worker thread
+typedef struct ECSSystemJob {
+    ECSSystemCallback sys;
+    uint32_t cbType;
+    uint32_t compType;
+    size_t count;
+    const ECSEntityID *owners;
+    void *data;
+    void *cbUserData;
+} ECSSystemJob;
+
+// Entity archetype: default data and per-instance callbacks of a set of
+// component types, copied as is into every instance.
+typedef struct ECSPrefab {
+    // Name of the instances
+    const char *name;
+    ECSCompMask mask;
+    // Tags of the instances
+    ECSTagMask tags;
+    // Entity ID replaced by the instance ID in the reference fields
+    ECSEntityID self;
+    // Default data of each component type in mask, elemSize bytes
+    uint8_t *data[ECS_COMPONENT_TYPES];
+    ECSComponentCallback callback[ECS_COMPONENT_TYPES]
+                                 [ECS_COMPONENT_CALLBACK_TYPES];
+    // Byte offsets of the ECSEntityID fields referring to the entity itself
+    uint32_t nRefs[ECS_COMPONENT_TYPES];
+    size_t refOffset[ECS_COMPONENT_TYPES][ECS_PREFAB_MAX_REFS];
+} ECSPrefab;
+
+#define ECS_SNAPSHOT_MAGIC 0x53434553 // "SECS"
+#define ECS_SNAPSHOT_VERSION 4
+
+// Snapshot layout: this header, then 8-byte aligned sections:
+// - ECSSnapshotEnt for each handed out entity slot
+// - activeEnt and the free entity slot indices, in FIFO order
+// - for each component type: owners, packed data, and per-instance callbacks
+//   if the type has any (ECS_COMPONENT_CALLBACK_TYPES uint32 per component,
+//   0 or 1 + the index given by ecs_registerSnapshotCallback)
+// - nameBytes bytes of NUL-terminated entity names
+// The ECS itself stores no pointer, so a snapshot can be loaded straight from
+// a mapped file, and by any build registering the same callbacks in the same
+// order. Pointers inside components are handled by the snapshot hooks.
+typedef struct ECSSnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t compTypes;
+    uint32_t nEntIds;
+    uint32_t nActiveEnt;
+    uint32_t nFreeEnt;
+    uint32_t nameBytes;
+    // Component types whose per-instance callbacks are stored
+    ECSCompMask callbackMask;
+    uint32_t elemSize[ECS_COMPONENT_TYPES];
+    uint32_t nComp[ECS_COMPONENT_TYPES];
+} ECSSnapshotHeader;
+
+typedef struct ECSSnapshotEnt {
+    uint32_t generation;
+    uint32_t activePos;
+    ECSCompMask compMask;
+    // Offset in the name section, ECS_INVALID_ID for unnamed entities
+    uint32_t nameOffset;
+    ECSTagMask tags;
+} ECSSnapshotEnt;
+
+typedef enum ECSCmdTypeEnum {
+    ECS_CMD_REGISTER_ENTITY,
+    ECS_CMD_REGISTER_COMP,
+    ECS_CMD_UNREGISTER_COMP,
+    ECS_CMD_UNREGISTER_ENTITY
+} ECSCmdType;
+
+// Deferred entity or component operation
+typedef struct ECSCmd {
+    ECSCmdType type;
+    // Set if ent is the handle of an entity registered by the same buffer
+    uint8_t newEnt;
+    ECSEntityID ent;
+    uint32_t compType;
+    union {
+        // Name of a registered entity
+        const char *name;
+        // Offset of a registered component's data in the buffer
+        size_t dataOffset;
+    };
+} ECSCmd;
+
+// Operations recorded by one thread, applied at the next flush
+typedef struct ECSCmdBuffer {
+    size_t nCmd;
+    size_t cmdCap;
+    ECSCmd *cmd;
+    // Data of the registered components
+    size_t dataSize;
+    size_t dataCap;
+    uint8_t *data;
+    // Entities registered by the buffer, by handle. IDs are assigned on flush.
+    size_t nNewEnt;
+    size_t newEntCap;
+    ECSEntityID *newEnt;
+    // Set once newEnt holds the IDs assigned by the last flush
+    uint8_t newEntDone;
+} ECSCmdBuffer;
+
+// Occupancy and memory of a component pool
+typedef struct ECSCompStats {
+    size_t nComp;
+    size_t nParked;
+    size_t peakComp;
+    // Component slots in the allocated chunks
+    size_t capacity;
+    size_t elemSize;
+    // Bytes of the component slots in use (data, owner, callbacks, change
+    // tick), and bytes allocated by the pool, sparse index and observer lists
+    // included
+    size_t bytesUsed;
+    size_t bytesReserved;
+    size_t nSparsePages;
+    // Set system callbacks, and components with a per-instance callback, for
+    // each callback type
+    uint32_t nSystems;
+    uint32_t nInstanceCb[ECS_COMPONENT_CALLBACK_TYPES];
+} ECSCompStats;
+
+// Occupancy and memory of the whole ECS
+typedef struct ECSStats {
+    size_t nActiveEnt;
+    size_t peakActiveEnt;
+    // Entity slots handed out so far, and allocated
+    size_t nEntIds;
+    size_t entCap;
+    size_t nFreeEnt;
+    size_t nParkedEnt;
+    // Free slots below the highest active slot, i.e. holes in the entity
+    // tables, and their ratio to the slots up to the highest active one
+    size_t nFreeHoles;
+    float fragmentation;
+    size_t nNames;
+    size_t nQuery;
+    // Bytes allocated by the entity tables, names, queries and command
+    // buffers
+    size_t entBytes;
+    size_t nameBytes;
+    size_t queryBytes;
+    size_t cmdBytes;
+    // Bytes allocated by the whole ECS, pools included
+    size_t totalBytes;
+    ECSCompStats comp[ECS_COMPONENT_TYPES];
+} ECSStats;
+
 typedef struct ECS {
     // Registered entities count
     size_t nActiveEnt;
-    // FIFO for free entity IDs
+    // Highest registered entities count so far
+    size_t peakActiveEnt;
+    // Number of entity slots handed out so far. Slots below it are either
+    // active or waiting in freeEntId.
+    size_t nEntIds;
+    // Capacity of activeEnt, entDesc and freeEntIdBuf, grows geometrically
+    size_t entCap;
+    // FIFO for free entity slot indices
     FIFO freeEntId;
-    // free_ent_id buffer
-    ECSEntityID freeEntIdBuf[ECS_MAX_ENTITIES + 1];
-    // Registered entity IDs. Buffer sorted in ascending order
-    ECSEntityID activeEnt[ECS_MAX_ENTITIES];
-    // Description for each entity ID
-    ECSEntityDesc entDesc[ECS_MAX_ENTITIES];
-
-    // FIFO for free component IDs
-    FIFO freeCompId;
-    // free_comp_id buffer
-    ECSComponentID freeCompIdBuf[ECS_MAX_COMPONENTS + 1];
-    // Description for each component ID
-    ECSComponent comp[ECS_MAX_COMPONENTS];
+    // free_ent_id buffer, entCap + 1 entries
+    ECSEntityID *freeEntIdBuf;
+    // Registered entity IDs, in no particular order
+    ECSEntityID *activeEnt;
+    // Description for each entity slot index
+    ECSEntityDesc *entDesc;
+    // Name index: open addressing hash table with linear probing, nameCap is
+    // a power of 2
+    size_t nNames;
+    size_t nameCap;
+    ECSName *names;
+
+    // Bitset of each tag, ECS_TAG_BLOCK-aligned nTagWords words allocated on
+    // first use of the tag
+    size_t nTagWords;
+    uint64_t *tagBits[ECS_TAG_TYPES];
+    // Tags with a bitset
+    ECSTagMask usedTags;
+
+    // Parked entities, grouped by component types
+    size_t nParkedEnt;
+    size_t nParkLists;
+    ECSParkList *park;
+
+    // Registered components count, across all types
+    size_t nComp;
+    // Change tick, starts at 1. Component writes are stamped with it.
+    uint32_t tick;
+    // Open read sections, on any component type
+    uint32_t nReaders;
+    // Component storage for each type
+    ECSCompPool pool[ECS_COMPONENT_TYPES];
+
+    // Registered queries
+    size_t nQuery;
+    ECSQuery **query;
+
+    // Optional worker pool for systems with declared access
+    JobPool *jobs;
+    // Job descriptors of the stage being run, grows geometrically
+    size_t sysJobCap;
+    ECSSystemJob *sysJob;
+    // Command buffer of each job pool thread, the first one is for any thread
+    // outside the pool
+    size_t nCmdBuf;
+    ECSCmdBuffer *cmdBuf;
+
+    // Per-instance callbacks that snapshots can store, by registration order
+    size_t nSnapCb;
+    size_t snapCbCap;
+    ECSComponentCallback *snapCb;
 
     // Component names by type. Only used for logging.
     const char **compTypeStr;
 } ECS;
 
 void ecs_init(ECS *ecs);
+// Initialize the ECS with room for nEntities entities before any reallocation
+void ecs_initReserve(ECS *ecs, size_t nEntities);
+// Free all the memory owned by the ECS
+void ecs_free(ECS *ecs);
 void ecs_status(const ECS *ecs, uint32_t *nUsedEntities, uint32_t *nUsedComp);
+// Collect the occupancy and memory statistics of the ECS and its pools
+void ecs_getStats(const ECS *ecs, ECSStats *out);
+// Write ecs_getStats as a JSON object to file
+ECSStatus ecs_dumpStats(const ECS *ecs, FILE *file);
+// Set the size in bytes of a component type. Must be called before any
+// component of that type is registered. Default is ECS_COMPONENT_DATA_SIZE.
+ECSStatus ecs_setCompTypeSize(ECS *ecs, uint32_t compType, size_t size);
+// Set the size and alignment of a component type, the size being rounded up
+// to the alignment. Same constraints as ecs_setCompTypeSize.
+ECSStatus ecs_setCompTypeLayout(ECS *ecs, uint32_t compType, size_t size,
+                                size_t align);
+// Store the components of a type as packed instances of a C type
+#define ECS_SET_COMP_TYPE(ecs, compType, type)                                 \
+    ecs_setCompTypeLayout((ecs), (compType), sizeof(type), _Alignof(type))
+// Set the callback executed whenever a component of the specified type is moved
+// inside its pool. Pointers to the old location are invalid after the move.
+ECSStatus ecs_setCompRelocCallback(ECS *ecs, uint32_t compType,
+                                   ECSCompRelocCallback cb, void *userData);
+// Set the observer of a component type (null to remove it). Additions and
+// removals are only recorded while an observer is set.
+ECSStatus ecs_setCompObserver(ECS *ecs, uint32_t compType,
+                              ECSObserverCallback cb, void *userData);
+// Deliver the pending additions and removals to the observers. Observers must
+// not register or unregister components, except through the ecs_cmd*
+// functions.
+void ecs_flushObservers(ECS *ecs);
 
 // Register entity to the ECS with optional alias string (can be null) and
-// write its assigned id to id_out.
+// write its assigned id to id_out. The name is copied.
 // If registration failed, ECS_INVALID_ID is written to id_out.
 ECSStatus ecs_registerEntity(ECS *ecs, ECSEntityID *const idOut,
                              const char *name);
@@ -98,9 +537,16 @@ ECSStatus ecs_getEntityNameCstr(const ECS *ecs, ECSEntityID id,
                                 const char **out);
 // ecs_getEntityNameCstr wrapper to get a string pointer directly
 const char *ecs_getEntityNameCstrP(const ECS *ecs, ECSEntityID id);
-// Find active entity by its alias string. If it is not found, 0 is written to
-// out
+// Set the alias string of an active entity (can be null). The name is copied.
+ECSStatus ecs_setEntityName(ECS *ecs, ECSEntityID id, const char *name);
+// Find an active entity by its alias string. If many entities share it, the
+// last one named is found. If it is not found, ECS_INVALID_ID is written to
+// out.
 ECSStatus ecs_findEntity(const ECS *ecs, const char *name, ECSEntityID *out);
+// Write up to maxOut active entities with the alias string to out, and return
+// how many entities have it
+size_t ecs_findEntities(const ECS *ecs, const char *name, ECSEntityID *out,
+                        size_t maxOut);
 // Check if entity exists
 ECSStatus ecs_entityExists(const ECS *ecs, ECSEntityID id);
 // Check if component exists
@@ -109,21 +555,229 @@ ECSStatus ecs_compExists(const ECS *ecs, ECSEntityID ent, uint32_t compType);
 // Register component to entity. The callbacks in comp are ignored!
 ECSStatus ecs_registerComp(ECS *ecs, ECSEntityID id, uint32_t compType,
                            const ECSComponent comp);
+// Register component to entity, copying elemSize bytes from data
+ECSStatus ecs_registerCompData(ECS *ecs, ECSEntityID id, uint32_t compType,
+                               const void *data);
 // Unregister component from entity
 ECSStatus ecs_unregisterComp(ECS *ecs, ECSEntityID id, uint32_t compType);
-// Get entity's component by its type. If the component is not found, 0 is
-// written to comp
-ECSStatus ecs_getComp(ECS *ecs, ECSEntityID id, uint32_t compType,
-                      ECSComponent **comp);
-// ecs_GetComp wrapper for getting the component data
+// Get entity's component data by its type. If the component is not found, 0
+// is written to data. The pointer is valid until a component of the same type
+// is unregistered.
 ECSStatus ecs_getCompData(ECS *ecs, ECSEntityID id, uint32_t compType,
                           void **data);
-// Get the ID of the component with the specified type and parent entity ID
+// Get the ID of the component with the specified type and parent entity ID.
+// The ID is the component's index in its type's pool, so it has the same
+// lifetime as the ecs_getCompData pointer.
 ECSStatus ecs_getCompID(const ECS *ecs, ECSEntityID id, uint32_t compType,
                         ECSComponentID *out);
+// Get component data by its type and ID
+void *ecs_getCompDataByID(const ECS *ecs, uint32_t compType,
+                          ECSComponentID compId);
+// Get the packed data of the components of a type stored in a pool chunk.
+// The number of components in the chunk is written to count and their parent
+// entity IDs to owners (both can be null). Returns null past the last chunk.
+void *ecs_getCompChunk(const ECS *ecs, uint32_t compType, size_t chunk,
+                       size_t *count, const ECSEntityID **owners);
+// Reorder the components of a type by ascending key, or by owner slot index if
+// key is null, so that iterating the pool follows that order. Moved components
+// go through the relocation callback and are marked as written. Each swap puts
+// at least one component in place; at most maxSwaps are done (0 for no limit),
+// so calling it until it returns 0 sorts the pool incrementally. The order
+// computed by a call is kept by the next ones with the same key callback until
+// it is reached or the pool changes structurally, without querying the keys
+// again. Returns the number of swaps.
+size_t ecs_sortComp(ECS *ecs, uint32_t compType, ECSSortKeyCallback key,
+                    void *userData, size_t maxSwaps);
+// Drop the orders kept by incremental ecs_sortComp calls with key, so that the
+// next call queries the keys again. Needed when the keys changed while the
+// pools didn't.
+void ecs_sortReset(ECS *ecs, ECSSortKeyCallback key);
+
+// Get the cached query matching the entities that own all the component types
+// in mask. Queries with the same mask are shared and live as long as the ECS.
+ECSStatus ecs_registerQuery(ECS *ecs, ECSCompMask mask, ECSQuery **out);
+// Get the component pointers of a query for one of its component types, with
+// the same order as query->ent. Returns null if the type isn't in the mask.
+void **ecs_queryComp(const ECSQuery *query, uint32_t compType);
+
+// Set the system callback of a component type, run on all its components in
+// batches. Can be null to remove it. Resets the declared access of the system.
+ECSStatus ecs_setSystemCallback(ECS *ecs, uint32_t compType, uint32_t cbType,
+                                ECSSystemCallback cb);
+// Declare the component types read and written by a system callback, its own
+// type is always written. Declared systems may run on worker threads, together
+// with the systems they don't conflict with and on many pool chunks at once:
+// they must only access the declared components of the entities they are
+// passed, and must not register or unregister entities or components.
+ECSStatus ecs_setSystemAccess(ECS *ecs, uint32_t compType, uint32_t cbType,
+                              ECSCompMask read, ECSCompMask write);
+// Set the worker pool used by ecs_execCallbackAllEnt to run systems with
+// declared access. Can be null to run everything on the calling thread.
+// Must not be called while commands are pending.
+void ecs_setJobPool(ECS *ecs, JobPool *jobs);
+
+/* Tags */
+// Tags are cleared when the entity is unregistered or parked. They aren't
+// protected by read sections: don't change them from systems running on
+// worker threads.
+// Add tags to an active entity
+ECSStatus ecs_addTags(ECS *ecs, ECSEntityID id, ECSTagMask tags);
+// Remove tags from an active entity
+ECSStatus ecs_removeTags(ECS *ecs, ECSEntityID id, ECSTagMask tags);
+// Get the tags of an active entity, 0 if it doesn't exist
+ECSTagMask ecs_getTags(const ECS *ecs, ECSEntityID id);
+// Write up to maxOut active entities with all the tags of all, at least one of
+// any (if not 0) and none of none to out. Returns how many entities match.
+// If all or any is set, the bitsets are scanned ECS_TAG_BLOCK slots at a time
+// and entities come in slot order, otherwise every active entity is checked.
+size_t ecs_queryTags(const ECS *ecs, ECSTagMask all, ECSTagMask any,
+                     ECSTagMask none, ECSEntityID *out, size_t maxOut);
+
+/* Prefabs */
+// Initialize an empty prefab. Its self reference is ECS_PREFAB_SELF.
+void ecs_prefabInit(ECSPrefab *prefab, const char *name);
+// Free the component data of a prefab
+void ecs_prefabFree(ECSPrefab *prefab);
+// Set the default data of a component type in a prefab
+ECSStatus ecs_prefabSetComp(const ECS *ecs, ECSPrefab *prefab,
+                            uint32_t compType, const ECSComponent *comp);
+// Copy the components, per-instance callbacks and tags of an active entity
+// into a prefab. Reference fields holding the entity's own ID will point to
+// each instance.
+ECSStatus ecs_prefabFromEntity(const ECS *ecs, ECSPrefab *prefab,
+                               ECSEntityID id);
+// Mark the ECSEntityID field at a byte offset of a component type as a
+// reference to the entity itself
+ECSStatus ecs_prefabAddEntityRef(ECSPrefab *prefab, uint32_t compType,
+                                 size_t offset);
+// Register count copies of a prefab, writing their IDs to idsOut. Parked
+// entities with the same component types are reactivated first. Entity
+// slots and pool chunks are reserved in bulk, and component data is copied
+// without per-component checks or logging. The createCbType callbacks (can be
+// ECS_INVALID_ID) are then run type by type on the whole batch. Component data
+// is copied as is, so it must not own resources.
+ECSStatus ecs_instantiatePrefab(ECS *ecs, const ECSPrefab *prefab,
+                                size_t count, ECSEntityID *idsOut,
+                                uint32_t createCbType, void *cbUserData);
+
+/* Entity parking */
+// Deactivate an entity, keeping its slot and components for the next
+// ecs_instantiatePrefab of the same component types, which only resets their
+// data. The ID is no longer valid and no callback is run: the entity is
+// removed from queries and observers see its components removed, as if it
+// was unregistered. Parked entities are saved as free slots by snapshots.
+ECSStatus ecs_parkEntity(ECS *ecs, ECSEntityID id);
+// Unregister all the parked entities, freeing their components
+void ecs_clearParked(ECS *ecs);
+
+/* Snapshots */
+// Let snapshots store a per-instance callback. Callbacks are saved as their
+// registration index, so the loading program must register the same ones in
+// the same order. Registering a callback again does nothing.
+ECSStatus ecs_registerSnapshotCallback(ECS *ecs, ECSComponentCallback cb);
+// Set the hooks run on the components of a type by snapshots, either can be
+// null. Load hooks must not change the structure of the ECS, and a failing
+// one must leave its component safe to use.
+ECSStatus ecs_setCompSnapshotHooks(ECS *ecs, uint32_t compType,
+                                   ECSSnapshotHook save, ECSSnapshotHook load,
+                                   void *userData);
+// Size in bytes of a snapshot of the current state
+size_t ecs_snapshotSize(const ECS *ecs);
+// Write a snapshot of all the entities, components, names and free lists to
+// buf, which must hold at least ecs_snapshotSize bytes. Fails if a
+// per-instance callback was not registered with ecs_registerSnapshotCallback,
+// or if a save hook fails.
+ECSStatus ecs_saveSnapshot(const ECS *ecs, void *buf, size_t size);
+// Check that a snapshot can be loaded, without changing the ECS. Every index
+// it holds is validated.
+ECSStatus ecs_checkSnapshot(const ECS *ecs, const void *buf, size_t size);
+// Replace the state of the ECS with a snapshot, checked first as by
+// ecs_checkSnapshot. The component type sizes must match the ones of the
+// snapshot. Systems, relocation callbacks and queries are kept, queries being
+// refilled; pending commands and observer notifications are dropped. Only
+// the load hooks are run, once everything is in place: pointers to the old
+// components must be dropped by the caller. All the loaded components count
+// as written. Entity slots past the
+// snapshot's get a new generation, so older handles to them stay invalid.
+ECSStatus ecs_loadSnapshot(ECS *ecs, const void *buf, size_t size);
+
+/* Change tracking */
+// Registering a component counts as a write, and so does moving it inside its
+// pool. Other writes must be reported with ecs_markChanged*.
+// Get the current change tick
+uint32_t ecs_getTick(const ECS *ecs);
+// Start a new tick, clearing the changed bits of the current one
+void ecs_advanceTick(ECS *ecs);
+// Mark an entity's component as written during the current tick. Safe to call
+// from systems running on the job pool.
+ECSStatus ecs_markChanged(ECS *ecs, ECSEntityID id, uint32_t compType);
+void ecs_markChangedByID(ECS *ecs, uint32_t compType, ECSComponentID compId);
+// Get the tick of the last write of a component
+uint32_t ecs_getChangeTickByID(const ECS *ecs, uint32_t compType,
+                               ECSComponentID compId);
+// Get the bitset of the components of a pool chunk written during the current
+// tick, bit i of word i / 64 being the i-th component of ecs_getCompChunk.
+// Returns null if none of them was written.
+const uint64_t *ecs_getCompChunkChanged(const ECS *ecs, uint32_t compType,
+                                        size_t chunk);
+
+/* Concurrent reads */
+// Structural changes (registering or unregistering entities and components,
+// loading snapshots, flushing commands) must happen on a single thread. Open
+// read sections mark the spans during which other threads read the ECS: they
+// forbid structural changes of their component types, and of entities and
+// names as a whole, which is checked when ECS_CHECK_ACCESS is set. Component
+// data, lookups of those types and queries made of them can then be read
+// from any thread, and non-structural writes (component fields, change marks)
+// follow the usual data race rules.
+// Open a read section on the component types of mask. Can be called from any
+// thread, sections can overlap.
+void ecs_beginRead(ECS *ecs, ECSCompMask mask);
+// Close a read section opened with the same mask
+void ecs_endRead(ECS *ecs, ECSCompMask mask);
+// Get the structural epoch of a component type. It changes whenever a
+// component of the type is registered, unregistered or moved, so pointers and
+// IDs cached while it stays the same are still valid.
+uint32_t ecs_getEpoch(const ECS *ecs, uint32_t compType);
+
+/* Deferred operations */
+// The ecs_cmd* functions record an operation in the command buffer of the
+// calling thread instead of applying it, so they are safe to call while the
+// ECS is being iterated or from systems running on the job pool. Operations
+// are applied by ecs_flushCmdBuffers.
 
+// Record the registration of an entity. Its handle, only valid for the
+// calling thread's buffer, is written to handleOut.
+ECSStatus ecs_cmdRegisterEntity(ECS *ecs, const char *name,
+                                uint32_t *handleOut);
+// Record the registration of a component to an active entity. The component
+// data is copied.
+ECSStatus ecs_cmdRegisterComp(ECS *ecs, ECSEntityID id, uint32_t compType,
+                              const ECSComponent *comp);
+// Record the registration of a component to an entity recorded by
+// ecs_cmdRegisterEntity
+ECSStatus ecs_cmdRegisterNewComp(ECS *ecs, uint32_t handle, uint32_t compType,
+                                 const ECSComponent *comp);
+// Record the unregistration of a component
+ECSStatus ecs_cmdUnregisterComp(ECS *ecs, ECSEntityID id, uint32_t compType);
+// Record the unregistration of an entity
+ECSStatus ecs_cmdUnregisterEntity(ECS *ecs, ECSEntityID id);
+// Get the ID assigned by the last flush to an entity recorded by the calling
+// thread. It stays available until the thread records a new entity.
+ECSEntityID ecs_cmdEntityID(const ECS *ecs, uint32_t handle);
+// Apply the commands of all the buffers, each buffer in record order.
+// Consecutive commands of the same kind are applied together, grouped by
+// component type. createCbType is run on the new components once the whole
+// run of registrations is in place, and destroyCbType on the components
+// about to be unregistered. Both can be ECS_INVALID_ID.
+// Commands recorded by those callbacks are applied by the same flush.
+// Must be called from a single thread, while the ECS is not being iterated.
+ECSStatus ecs_flushCmdBuffers(ECS *ecs, uint32_t createCbType,
+                              uint32_t destroyCbType, void *cbUserData);
 // Set callback to active component selected by its type and active entity it
-// belongs to.
+// belongs to. Per-instance callbacks run after the system callback of the
+// component type, and are meant for the few components that need custom
+// behaviour.
 ECSStatus ecs_setCallback(ECS *ecs, ECSEntityID id, uint32_t compType,
                           uint32_t cbType, ECSComponentCallback cb);
 // Execute callback selected by its type, active component type and active
@@ -135,5 +789,8 @@ ECSStatus ecs_execCallback(ECS *ecs, ECSEntityID id, uint32_t compType,
 ECSStatus ecs_execCallbackAllComp(ECS *ecs, ECSEntityID id, uint32_t cbType,
                                   void *cbUserData);
 // Execute callback selected by its type, on all active components of all active
-// entities.
+// entities. Components are visited by type: system callbacks first, then
+// per-instance ones. If a job pool is set, consecutive systems with declared
+// access are grouped in stages of non-conflicting systems, in type order, and
+// each stage runs in parallel on the pool.
 ECSStatus ecs_execCallbackAllEnt(ECS *ecs, uint32_t cbType, void *cbUserData);
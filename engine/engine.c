@@ -1,6 +1,24 @@
 #include "./engine.h"
 #include "ecs.h"
+#include "mathutils.h"
 #include "physcoll.h"
+#include <stddef.h>
+
+static void engine_cbPhysicsOnReloc(ECSEntityID entId, uint32_t compType,
+                                    void *compData, void *userData);
+static void engine_registerSystems(Engine *engine);
+static uint64_t engine_sortKeyHierarchy(uint32_t compType,
+                                        ECSComponentID compId,
+                                        ECSEntityID entId,
+                                        const void *compData, void *userData);
+static ECSStatus engine_snapSaveCollider(ECSEntityID entId, uint32_t compType,
+                                         void *compData, void *userData);
+static ECSStatus engine_snapLoadCollider(ECSEntityID entId, uint32_t compType,
+                                         void *compData, void *userData);
+static void engine_obsLightSources(uint32_t compType,
+                                   const ECSEntityID *removed, size_t nRemoved,
+                                   const ECSEntityID *added, size_t nAdded,
+                                   void *userData);
 
 void engine_init(Engine *const engine) {
     if (sizeof(EngineECSCompData) > ECS_COMPONENT_DATA_SIZE) {
@@ -14,21 +32,79 @@ void engine_init(Engine *const engine) {
 
     engine->timescale = 1;
     engine->nPendingMsg = 0;
+    engine->msgDst = NULL;
+    engine->msgDstCap = 0;
     engine->render.models = hashmap_init();
     engine->render.shaders = hashmap_init();
-    engine->render.meshRend = array_init();
-    engine->render.lightSrc = array_init();
+    engine->render.lightSrc = vecU32_init();
     engine->render.camera = ECS_INVALID_ID;
     engine->phys = physics_initSystem();
     engine->physDeltaTime = 1.f / 80.f;
     engine->physLastUpdate = GetTime();
+    engine->transforms.node = NULL;
+    engine->transforms.scratch = NULL;
+    engine->transforms.nNodes = 0;
+    engine->transforms.epoch = 0;
+    engine->transforms.cap = 0;
+    engine->transforms.dirty = 1;
+    engine->transforms.sortedEpoch = ECS_INVALID_ID;
 
     ecs_init(&engine->ecs);
     engine->ecs.compTypeStr = EngineECSCompTypeStr;
+    // The main thread runs jobs too while waiting for them
+    if (jobs_init(&engine->jobs, jobs_cpuCount() - 1))
+        ecs_setJobPool(&engine->ecs, &engine->jobs);
+    // Components are stored with their own size, not the one of the union
+    ECS_SET_COMP_TYPE(&engine->ecs, ENGINE_COMP_INFO, EngineCompInfo);
+    ECS_SET_COMP_TYPE(&engine->ecs, ENGINE_COMP_RIGIDBODY, RigidBody);
+    ECS_SET_COMP_TYPE(&engine->ecs, ENGINE_COMP_TRANSFORM, EngineCompTransform);
+    ECS_SET_COMP_TYPE(&engine->ecs, ENGINE_COMP_CAMERA, EngineCompCamera);
+    ECS_SET_COMP_TYPE(&engine->ecs, ENGINE_COMP_MESHRENDERER,
+                      EngineCompMeshRenderer);
+    ECS_SET_COMP_TYPE(&engine->ecs, ENGINE_COMP_LIGHTSOURCE,
+                      EngineCompLightSrc);
+    ECS_SET_COMP_TYPE(&engine->ecs, ENGINE_COMP_COLLIDER, Collider);
+    ECS_SET_COMP_TYPE(&engine->ecs, ENGINE_COMP_SCRIPT, EngineCompScript);
+    // The physics system keeps pointers to these components
+    ecs_setCompRelocCallback(&engine->ecs, ENGINE_COMP_RIGIDBODY,
+                             engine_cbPhysicsOnReloc, engine);
+    ecs_setCompRelocCallback(&engine->ecs, ENGINE_COMP_TRANSFORM,
+                             engine_cbPhysicsOnReloc, engine);
+    ecs_setCompRelocCallback(&engine->ecs, ENGINE_COMP_COLLIDER,
+                             engine_cbPhysicsOnReloc, engine);
+    ecs_setCompObserver(&engine->ecs, ENGINE_COMP_LIGHTSOURCE,
+                        engine_obsLightSources, engine);
+    // Collider meshes are pointers into the models
+    ecs_setCompSnapshotHooks(&engine->ecs, ENGINE_COMP_COLLIDER,
+                             engine_snapSaveCollider, engine_snapLoadCollider,
+                             engine);
+    engine_registerSystems(engine);
+    ecs_registerQuery(&engine->ecs, ECS_COMP_MASK(ENGINE_COMP_MESHRENDERER),
+                      &engine->render.meshRend);
 
     logMsg(LOG_LVL_INFO, "whole engine occupies %u bytes", sizeof(Engine));
 }
 
+void engine_free(Engine *const engine) {
+    // Join the workers first, systems may still reference the ECS
+    jobs_free(&engine->jobs);
+    ecs_free(&engine->ecs);
+    free(engine->msgDst);
+    engine->msgDst = NULL;
+    engine->msgDstCap = 0;
+    free(engine->transforms.node);
+    free(engine->transforms.scratch);
+    engine->transforms.node = NULL;
+    engine->transforms.scratch = NULL;
+    engine->transforms.nNodes = 0;
+    engine->transforms.cap = 0;
+    vecU32_free(&engine->render.lightSrc);
+    // Models and shaders are owned by whoever registered them
+    hashmap_free(&engine->render.models);
+    hashmap_free(&engine->render.shaders);
+    logMsg(LOG_LVL_INFO, "engine freed");
+}
+
 // Should be called right after the entity is fully registered in the ECS
 void engine_entityPostCreate(Engine *const engine, const ECSEntityID id) {
     EngineCallbackData cbData;
@@ -43,27 +119,326 @@ void engine_entityDestroy(Engine *const engine, const ECSEntityID id) {
     ecs_unregisterEntity(&engine->ecs, id);
 }
 
+EngineStatus engine_createPrefab(Engine *const engine, ECSPrefab *const prefab,
+                                 const ECSEntityID templateEnt) {
+    if (ecs_compExists(&engine->ecs, templateEnt, ENGINE_COMP_SCRIPT) ==
+        ECS_RES_OK) {
+        logMsg(LOG_LVL_ERR, "can't make a prefab of entity %u with a script",
+               templateEnt);
+        return ENGINE_STATUS_REGISTER_FAILED;
+    }
+    if (ecs_prefabFromEntity(&engine->ecs, prefab, templateEnt) != ECS_RES_OK)
+        return ENGINE_STATUS_REGISTER_FAILED;
+    // Anchors to the template itself must point to each instance
+    ecs_prefabAddEntityRef(prefab, ENGINE_COMP_TRANSFORM,
+                           offsetof(EngineCompTransform, anchor));
+    ecs_prefabAddEntityRef(prefab, ENGINE_COMP_MESHRENDERER,
+                           offsetof(EngineCompMeshRenderer, transform));
+    ecs_prefabAddEntityRef(prefab, ENGINE_COMP_LIGHTSOURCE,
+                           offsetof(EngineCompLightSrc, transform));
+    // No create callback ran on the template, so there's nothing to destroy
+    ecs_unregisterEntity(&engine->ecs, templateEnt);
+    return ENGINE_STATUS_OK;
+}
+
+EngineStatus engine_instantiatePrefab(Engine *const engine,
+                                      const ECSPrefab *const prefab,
+                                      const size_t count,
+                                      ECSEntityID *const idsOut) {
+    EngineCallbackData cbData;
+    cbData.engine = engine;
+    if (ecs_instantiatePrefab(&engine->ecs, prefab, count, idsOut,
+                              ENGINE_CB_CREATE, &cbData) != ECS_RES_OK)
+        return ENGINE_STATUS_REGISTER_FAILED;
+    return ENGINE_STATUS_OK;
+}
+
+void engine_entityPark(Engine *const engine, const ECSEntityID id) {
+    EngineCallbackData cbData;
+    cbData.engine = engine;
+    ecs_execCallbackAllComp(&engine->ecs, id, ENGINE_CB_DESTROY, &cbData);
+    ecs_parkEntity(&engine->ecs, id);
+}
+
+void engine_entityDestroyDeferred(Engine *const engine, const ECSEntityID id) {
+    ecs_cmdUnregisterEntity(&engine->ecs, id);
+}
+
+void engine_flushCommands(Engine *const engine) {
+    EngineCallbackData cbData;
+    cbData.engine = engine;
+    ecs_flushCmdBuffers(&engine->ecs, ENGINE_CB_CREATE, ENGINE_CB_DESTROY,
+                        &cbData);
+    ecs_flushObservers(&engine->ecs);
+}
+
+#define ENGINE_SNAPSHOT_MAGIC 0x53454e45
+#define ENGINE_SNAPSHOT_VERSION 1
+
+// Prepended to the ECS snapshot in snapshot files
+typedef struct EngineSnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    ECSEntityID camera;
+    float timescale;
+    uint64_t ecsSize;
+} EngineSnapshotHeader;
+
+// Convex hulls are saved by model, and the contacts belong to the physics
+// system
+static ECSStatus engine_snapSaveCollider(ECSEntityID entId, uint32_t compType,
+                                         void *compData, void *userData) {
+    Collider *const coll = compData;
+
+    coll->contacts = NULL;
+    coll->nContacts = 0;
+    switch (coll->type) {
+    case COLLIDER_TYPE_CONVEX_HULL:
+        if (coll->convexHull.modelId == UINT32_MAX) {
+            logMsg(LOG_LVL_ERR, "convex hull of entity %u is not from a model",
+                   entId);
+            return ECS_RES_INVALID_PARAMS;
+        }
+        coll->convexHull.vertices = NULL;
+        coll->convexHull.indices = NULL;
+        break;
+    case COLLIDER_TYPE_HEIGHTMAP:
+        logMsg(LOG_LVL_ERR, "heightmap collider of entity %u can't be saved",
+               entId);
+        return ECS_RES_INVALID_PARAMS;
+    default:
+        break;
+    }
+    return ECS_RES_OK;
+}
+
+// Rebuild convex hulls from their model. Colliders that can't be rebuilt are
+// disabled and left without type.
+static ECSStatus engine_snapLoadCollider(ECSEntityID entId, uint32_t compType,
+                                         void *compData, void *userData) {
+    Collider *const coll = compData;
+    Model *mdl = NULL;
+
+    coll->contacts = NULL;
+    coll->nContacts = 0;
+    if (coll->type == COLLIDER_TYPE_CONVEX_HULL)
+        mdl = engine_render_getModel(userData, coll->convexHull.modelId);
+    else if (coll->type != COLLIDER_TYPE_HEIGHTMAP)
+        return ECS_RES_OK;
+    if (mdl == NULL || mdl->meshCount == 0) {
+        logMsg(LOG_LVL_ERR, "can't rebuild collider of entity %u", entId);
+        coll->enabled = 0;
+        coll->type = COLLIDER_TOTAL_TYPES;
+        return ECS_RES_INVALID_PARAMS;
+    }
+    coll->convexHull.vertices = mdl->meshes[0].vertices;
+    coll->convexHull.indices = mdl->meshes[0].indices;
+    coll->convexHull.nVertices = mdl->meshes[0].vertexCount;
+    return ECS_RES_OK;
+}
+
+EngineStatus engine_saveSnapshot(Engine *const engine, const char *path) {
+    EngineSnapshotHeader hdr;
+    FILE *file;
+    void *buf;
+    uint8_t ok;
+
+    hdr.magic = ENGINE_SNAPSHOT_MAGIC;
+    hdr.version = ENGINE_SNAPSHOT_VERSION;
+    hdr.camera = engine->render.camera;
+    hdr.timescale = engine->timescale;
+    hdr.ecsSize = ecs_snapshotSize(&engine->ecs);
+    buf = malloc(hdr.ecsSize);
+    if (buf == NULL) {
+        logMsg(LOG_LVL_ERR, "can't allocate %u bytes for snapshot",
+               hdr.ecsSize);
+        return ENGINE_STATUS_SNAPSHOT_FAILED;
+    }
+    if (ecs_saveSnapshot(&engine->ecs, buf, hdr.ecsSize) != ECS_RES_OK) {
+        logMsg(LOG_LVL_ERR, "can't save snapshot of the ECS");
+        free(buf);
+        return ENGINE_STATUS_SNAPSHOT_FAILED;
+    }
+
+    file = fopen(path, "wb");
+    if (file == NULL) {
+        logMsg(LOG_LVL_ERR, "can't open snapshot file %s", path);
+        free(buf);
+        return ENGINE_STATUS_SNAPSHOT_FAILED;
+    }
+    ok = fwrite(&hdr, sizeof(hdr), 1, file) == 1 &&
+         fwrite(buf, hdr.ecsSize, 1, file) == 1;
+    ok = fclose(file) == 0 && ok;
+    free(buf);
+    if (!ok) {
+        logMsg(LOG_LVL_ERR, "can't write snapshot file %s", path);
+        return ENGINE_STATUS_SNAPSHOT_FAILED;
+    }
+    logMsg(LOG_LVL_INFO, "saved snapshot to %s", path);
+    return ENGINE_STATUS_OK;
+}
+
+// Fill the light source list with all the owners of a LightSource component
+static void engine_collectLightSrcs(Engine *const engine) {
+    const ECSEntityID *owners;
+    size_t chunk, count;
+
+    vecU32_clear(&engine->render.lightSrc);
+    for (chunk = 0; ecs_getCompChunk(&engine->ecs, ENGINE_COMP_LIGHTSOURCE,
+                                     chunk, &count, &owners) != NULL;
+         chunk++)
+        vecU32_append(&engine->render.lightSrc, owners, count);
+}
+
+// Run the destroy callbacks of all the entities, which are about to be
+// replaced
+static void engine_destroyAllCallbacks(Engine *const engine) {
+    const size_t n = engine->ecs.nActiveEnt;
+    EngineCallbackData cbData;
+    ECSEntityID *ids;
+
+    // Callbacks can register entities, so the list is copied first
+    ids = malloc(n * sizeof(*ids));
+    if (ids == NULL && n) {
+        logMsg(LOG_LVL_ERR, "can't allocate %zu entity IDs", n);
+        return;
+    }
+    memcpy(ids, engine->ecs.activeEnt, n * sizeof(*ids));
+    cbData.engine = engine;
+    for (size_t i = 0; i < n; i++)
+        if (ecs_entityExists(&engine->ecs, ids[i]) == ECS_RES_OK)
+            ecs_execCallbackAllComp(&engine->ecs, ids[i], ENGINE_CB_DESTROY,
+                                    &cbData);
+    free(ids);
+}
+
+// Register the loaded rigid bodies, colliders and light sources again
+static void engine_rebuildRegistries(Engine *const engine) {
+    EngineCompTransform *trans;
+    const ECSEntityID *owners;
+    uint8_t *data;
+    size_t chunk, count, i;
+
+    for (chunk = 0; (data = ecs_getCompChunk(&engine->ecs,
+                                             ENGINE_COMP_RIGIDBODY, chunk,
+                                             &count, &owners)) != NULL;
+         chunk++) {
+        for (i = 0; i < count; i++)
+            physics_addRigidBody(&engine->phys, owners[i],
+                                 (RigidBody *)data + i);
+    }
+    for (chunk = 0; (data = ecs_getCompChunk(&engine->ecs,
+                                             ENGINE_COMP_COLLIDER, chunk,
+                                             &count, &owners)) != NULL;
+         chunk++) {
+        for (i = 0; i < count; i++) {
+            trans = engine_getTransform(engine, owners[i]);
+            if (trans != NULL)
+                physics_addCollider(&engine->phys, owners[i],
+                                    (Collider *)data + i,
+                                    &trans->globalMatrix);
+        }
+    }
+    engine_collectLightSrcs(engine);
+}
+
+EngineStatus engine_loadSnapshot(Engine *const engine, const char *path) {
+    EngineSnapshotHeader hdr;
+    ECSStatus res;
+    FILE *file;
+    void *buf;
+
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        logMsg(LOG_LVL_ERR, "can't open snapshot file %s", path);
+        return ENGINE_STATUS_SNAPSHOT_FAILED;
+    }
+    if (fread(&hdr, sizeof(hdr), 1, file) != 1 ||
+        hdr.magic != ENGINE_SNAPSHOT_MAGIC ||
+        hdr.version != ENGINE_SNAPSHOT_VERSION) {
+        logMsg(LOG_LVL_ERR, "%s is not an engine snapshot", path);
+        fclose(file);
+        return ENGINE_STATUS_SNAPSHOT_FAILED;
+    }
+    buf = malloc(hdr.ecsSize);
+    if (buf == NULL || fread(buf, hdr.ecsSize, 1, file) != 1) {
+        logMsg(LOG_LVL_ERR, "can't read snapshot file %s", path);
+        free(buf);
+        fclose(file);
+        return ENGINE_STATUS_SNAPSHOT_FAILED;
+    }
+    fclose(file);
+    if (ecs_checkSnapshot(&engine->ecs, buf, hdr.ecsSize) != ECS_RES_OK) {
+        logMsg(LOG_LVL_ERR, "can't load snapshot %s", path);
+        free(buf);
+        return ENGINE_STATUS_SNAPSHOT_FAILED;
+    }
+
+    engine_destroyAllCallbacks(engine);
+    // The physics system points into the component pools being replaced
+    physics_clear(&engine->phys);
+    res = ecs_loadSnapshot(&engine->ecs, buf, hdr.ecsSize);
+    free(buf);
+    engine_rebuildRegistries(engine);
+    if (res != ECS_RES_OK) {
+        logMsg(LOG_LVL_ERR, "can't load snapshot %s", path);
+        return ENGINE_STATUS_SNAPSHOT_FAILED;
+    }
+    engine->render.camera = hdr.camera;
+    engine->timescale = hdr.timescale;
+    engine->nPendingMsg = 0;
+    return ENGINE_STATUS_OK;
+}
+
+EngineStatus engine_dumpStats(Engine *const engine, const char *path) {
+    FILE *file;
+    uint8_t ok;
+
+    file = fopen(path, "w");
+    if (file == NULL) {
+        logMsg(LOG_LVL_ERR, "can't open stats file %s", path);
+        return ENGINE_STATUS_STATS_FAILED;
+    }
+    ok = ecs_dumpStats(&engine->ecs, file) == ECS_RES_OK;
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        logMsg(LOG_LVL_ERR, "can't write stats file %s", path);
+        return ENGINE_STATUS_STATS_FAILED;
+    }
+    logMsg(LOG_LVL_INFO, "dumped ECS stats to %s", path);
+    return ENGINE_STATUS_OK;
+}
+
 static void engine_dispatchMessage(Engine *const engine, EngineMsg *const msg) {
-    uint32_t ent;
-    EngineECSCompData *compData;
+    const ECSTagMask dstTags = ECS_TAG_MASK(ENGINE_TAG_INFO) | msg->dstMask;
+    ECSEntityID *dst;
+    size_t i, nDst, cap;
     EngineCallbackData cbData;
     cbData.engine = engine;
     cbData.msgRecv.msg = msg;
-    // "broadcast" message
+    // "broadcast" message, only entities with an Info component can receive it
     if (msg->dstId == ECS_INVALID_ID) {
-        for (ent = 0; ent < engine->ecs.nActiveEnt; ent++) {
-            ecs_getCompData(&engine->ecs, engine->ecs.activeEnt[ent],
-                            ENGINE_COMP_INFO, (void **)&compData);
-            if (compData == NULL) {
-                logMsg(LOG_LVL_FATAL,
-                       "entity %u(\"%s\") has no Info component!", ent,
-                       ecs_getEntityNameCstrP(&engine->ecs, ent));
+        nDst = ecs_queryTags(&engine->ecs, dstTags, 0, 0, engine->msgDst,
+                             engine->msgDstCap);
+        if (nDst > engine->msgDstCap) {
+            cap = engine->msgDstCap ? engine->msgDstCap : 64;
+            while (cap < nDst)
+                cap *= 2;
+            dst = realloc(engine->msgDst, cap * sizeof(*dst));
+            if (dst == NULL) {
+                logMsg(LOG_LVL_ERR, "can't allocate %u message receivers",
+                       nDst);
                 return;
             }
-            if ((compData->info.typeMask & msg->dstMask) == msg->dstMask) {
-                ecs_execCallbackAllComp(&engine->ecs, ent, ENGINE_CB_MSGRECV,
-                                        &cbData);
-            }
+            engine->msgDst = dst;
+            engine->msgDstCap = cap;
+            ecs_queryTags(&engine->ecs, dstTags, 0, 0, dst, cap);
+        }
+        for (i = 0; i < nDst; i++) {
+            // Earlier receivers may have unregistered it
+            if (ecs_entityExists(&engine->ecs, engine->msgDst[i]) == ECS_RES_OK)
+                ecs_execCallbackAllComp(&engine->ecs, engine->msgDst[i],
+                                        ENGINE_CB_MSGRECV, &cbData);
         }
     } else {
         if (ecs_entityExists(&engine->ecs, msg->dstId) != ECS_RES_OK) {
@@ -93,16 +468,10 @@ static void engine_execUpdateCallbacks(Engine *const engine,
     ecs_execCallbackAllEnt(&engine->ecs, ENGINE_CB_UPDATE, &cbData);
 }
 
-static void engine_updateTransform(Engine *const engine,
-                                   EngineECSCompData *cData) {
-    EngineECSCompData *parentTrans = NULL;
-    if (cData->trans.anchor != ECS_INVALID_ID) {
-        ecs_getCompData(&engine->ecs, cData->trans.anchor,
-                        ENGINE_COMP_TRANSFORM, (void **)&parentTrans);
-        if (parentTrans->trans._globalUpdate)
-            engine_updateTransform(engine, parentTrans);
-    }
-    EngineCompTransform *const trans = &cData->trans;
+// Compute the matrices of a transform from its local values and the current
+// global matrix of its anchor
+static void engine_computeTransform(EngineCompTransform *const trans,
+                                    const EngineCompTransform *const parent) {
     if (trans->localUpdate) {
         trans->localMatrix =
             MatrixScale(trans->scale.x, trans->scale.y, trans->scale.z);
@@ -112,44 +481,332 @@ static void engine_updateTransform(Engine *const engine,
             trans->localMatrix,
             MatrixTranslate(trans->pos.x, trans->pos.y, trans->pos.z));
     }
-    if (parentTrans == NULL)
+    if (parent == NULL)
         trans->globalMatrix = trans->localMatrix;
     else {
         trans->globalMatrix =
-            MatrixMultiply(trans->localMatrix, parentTrans->trans.globalMatrix);
+            MatrixMultiply(trans->localMatrix, parent->globalMatrix);
     }
-    // trans->globalMatrix = MatrixIdentity();
     trans->localUpdate = 0;
-    trans->_globalUpdate = 0;
 }
 
-static void engine_updateTransforms(Engine *const engine) {
-    ECSEntityID entId;
-    EngineECSCompData *cData;
-    ECSStatus stat;
-    for (uint32_t i = 0; i < engine->ecs.nActiveEnt; i++) {
-        entId = engine->ecs.activeEnt[i];
-        stat = ecs_getCompData(&engine->ecs, entId, ENGINE_COMP_TRANSFORM,
-                               (void **)&cData);
-        if (cData == NULL) {
-            logMsg(LOG_LVL_FATAL, "can't find transform for entity %u", entId);
-            return;
+static uint8_t engine_reserveTransformNodes(EngineTransformHierarchy *hier,
+                                            const size_t n) {
+    EngineTransformNode *node;
+    uint32_t *scratch;
+    size_t cap = hier->cap ? hier->cap : 64;
+
+    if (n <= hier->cap)
+        return 1;
+    while (cap < n)
+        cap *= 2;
+    node = realloc(hier->node, cap * sizeof(*node));
+    if (node == NULL)
+        return 0;
+    hier->node = node;
+    scratch = realloc(hier->scratch, cap * 3 * sizeof(*scratch));
+    if (scratch == NULL)
+        return 0;
+    hier->scratch = scratch;
+    hier->cap = cap;
+    return 1;
+}
+
+// Sort the transforms by depth, walking the hierarchy breadth first from the
+// roots. Transforms whose anchors form a cycle are left out.
+static void engine_rebuildTransformHierarchy(Engine *const engine) {
+    EngineTransformHierarchy *const hier = &engine->transforms;
+    const size_t nTrans = engine->ecs.pool[ENGINE_COMP_TRANSFORM].nComp;
+    EngineCompTransform *trans;
+    EngineTransformNode *node;
+    uint32_t *parentOf, *firstChild, *nextSibling;
+    uint32_t c, child, prev;
+    ECSComponentID parentId;
+    size_t i;
+
+    if (!engine_reserveTransformNodes(hier, nTrans))
+        logMsg(LOG_LVL_FATAL, "can't allocate %u transform nodes", nTrans);
+    parentOf = hier->scratch;
+    firstChild = parentOf + hier->cap;
+    nextSibling = firstChild + hier->cap;
+    for (c = 0; c < nTrans; c++) {
+        firstChild[c] = ECS_INVALID_ID;
+        trans = ecs_getCompDataByID(&engine->ecs, ENGINE_COMP_TRANSFORM, c);
+        trans->_node = ECS_INVALID_ID;
+        parentOf[c] = ECS_INVALID_ID;
+        if (trans->anchor == ECS_INVALID_ID)
+            continue;
+        if (ecs_getCompID(&engine->ecs, trans->anchor, ENGINE_COMP_TRANSFORM,
+                          &parentId) != ECS_RES_OK) {
+            logMsg(LOG_LVL_WARN, "anchor %u of transform %u has no transform",
+                   trans->anchor, c);
+            continue;
         }
-        cData->trans._globalUpdate = 1;
-    }
-    for (uint32_t i = 0; i < engine->ecs.nActiveEnt; i++) {
-        entId = engine->ecs.activeEnt[i];
-        ecs_getCompData(&engine->ecs, entId, ENGINE_COMP_TRANSFORM,
-                        (void **)&cData);
-        if (cData->trans._globalUpdate) {
-            engine_updateTransform(engine, cData);
+        parentOf[c] = parentId;
+    }
+    // Children lists in component order
+    for (c = nTrans; c-- > 0;) {
+        if (parentOf[c] == ECS_INVALID_ID)
+            continue;
+        nextSibling[c] = firstChild[parentOf[c]];
+        firstChild[parentOf[c]] = c;
+    }
+
+    hier->nNodes = 0;
+    for (c = 0; c < nTrans; c++) {
+        if (parentOf[c] != ECS_INVALID_ID)
+            continue;
+        node = hier->node + hier->nNodes++;
+        node->compId = c;
+        node->parent = ECS_INVALID_ID;
+        node->depth = 0;
+    }
+    // The node array is the queue of the breadth first walk, so children end
+    // up right after each other
+    for (i = 0; i < hier->nNodes; i++) {
+        hier->node[i].firstChild = ECS_INVALID_ID;
+        hier->node[i].nextSibling = ECS_INVALID_ID;
+        prev = ECS_INVALID_ID;
+        for (child = firstChild[hier->node[i].compId]; child != ECS_INVALID_ID;
+             child = nextSibling[child]) {
+            node = hier->node + hier->nNodes;
+            node->compId = child;
+            node->parent = i;
+            node->depth = hier->node[i].depth + 1;
+            if (prev == ECS_INVALID_ID)
+                hier->node[i].firstChild = hier->nNodes;
+            else
+                hier->node[prev].nextSibling = hier->nNodes;
+            prev = hier->nNodes++;
+        }
+    }
+    for (i = 0; i < hier->nNodes; i++) {
+        hier->node[i].trans = ecs_getCompDataByID(
+            &engine->ecs, ENGINE_COMP_TRANSFORM, hier->node[i].compId);
+        hier->node[i].trans->_node = i;
+        hier->node[i].changed = 0;
+    }
+    if (hier->nNodes != nTrans)
+        logMsg(LOG_LVL_ERR, "anchors of %u transforms form a cycle",
+               nTrans - hier->nNodes);
+    hier->epoch = ecs_getEpoch(&engine->ecs, ENGINE_COMP_TRANSFORM);
+    hier->dirty = 0;
+    // Node indices changed, sorts in hierarchy order have to start over
+    ecs_sortReset(&engine->ecs, engine_sortKeyHierarchy);
+    hier->sortedEpoch = ECS_INVALID_ID;
+}
+
+// Rebuild the hierarchy if anchors changed, or if transforms were added,
+// removed or moved in their pool
+static void engine_refreshTransformHierarchy(Engine *const engine) {
+    EngineTransformHierarchy *const hier = &engine->transforms;
+    if (hier->dirty ||
+        hier->epoch != ecs_getEpoch(&engine->ecs, ENGINE_COMP_TRANSFORM))
+        engine_rebuildTransformHierarchy(engine);
+}
+
+// Only the transforms whose local matrix or anchor changed are recomputed.
+// Recomputed transforms are marked as written for the current tick.
+static void engine_updateTransforms(Engine *const engine) {
+    EngineTransformHierarchy *const hier = &engine->transforms;
+    EngineTransformNode *node;
+    const EngineTransformNode *parent;
+
+    engine_refreshTransformHierarchy(engine);
+    for (size_t i = 0; i < hier->nNodes; i++) {
+        node = hier->node + i;
+        parent = node->parent == ECS_INVALID_ID ? NULL
+                                                : hier->node + node->parent;
+        node->changed = node->trans->localUpdate ||
+                        (parent != NULL && parent->changed);
+        if (!node->changed)
+            continue;
+        engine_computeTransform(node->trans, parent ? parent->trans : NULL);
+        ecs_markChangedByID(&engine->ecs, ENGINE_COMP_TRANSFORM, node->compId);
+    }
+}
+
+EngineStatus engine_setTransformAnchor(Engine *const engine,
+                                       const ECSEntityID ent,
+                                       const ECSEntityID anchor) {
+    EngineCompTransform *const trans = engine_getTransform(engine, ent);
+    if (trans == NULL)
+        return ENGINE_STATUS_NO_TRANSFORM_ANCHOR;
+    if (anchor != ECS_INVALID_ID && engine_getTransform(engine, anchor) == NULL)
+        return ENGINE_STATUS_NO_TRANSFORM_ANCHOR;
+    trans->anchor = anchor;
+    // The global matrix has to be recomputed with the new anchor
+    trans->localUpdate = 1;
+    engine->transforms.dirty = 1;
+    return ENGINE_STATUS_OK;
+}
+
+// Sort keys of engine_sortComponents
+typedef struct EngineSortCtx {
+    Engine *engine;
+    // Origin and scale of the quantized positions
+    Vector3 min;
+    Vector3 scale;
+} EngineSortCtx;
+
+// Transform component ID of the owner of a component, ECS_INVALID_ID if it
+// has none
+static uint32_t engine_sortTransformID(const Engine *const engine,
+                                       const uint32_t compType,
+                                       const ECSComponentID compId,
+                                       const ECSEntityID entId) {
+    ECSComponentID transId;
+    if (compType == ENGINE_COMP_TRANSFORM)
+        return compId;
+    if (ecs_getCompID(&engine->ecs, entId, ENGINE_COMP_TRANSFORM, &transId) !=
+        ECS_RES_OK)
+        return ECS_INVALID_ID;
+    return transId;
+}
+
+static uint64_t engine_sortKeyHierarchy(uint32_t compType,
+                                        ECSComponentID compId,
+                                        ECSEntityID entId,
+                                        const void *compData, void *userData) {
+    const EngineSortCtx *const ctx = userData;
+    const uint32_t transId =
+        engine_sortTransformID(ctx->engine, compType, compId, entId);
+    const EngineCompTransform *trans;
+
+    if (transId == ECS_INVALID_ID)
+        return UINT64_MAX;
+    trans = ecs_getCompDataByID(&ctx->engine->ecs, ENGINE_COMP_TRANSFORM,
+                                transId);
+    // ECS_INVALID_ID for transforms out of the hierarchy
+    return trans->_node;
+}
+
+static uint64_t engine_sortKeySpatial(uint32_t compType, ECSComponentID compId,
+                                      ECSEntityID entId, const void *compData,
+                                      void *userData) {
+    const EngineSortCtx *const ctx = userData;
+    const uint32_t transId =
+        engine_sortTransformID(ctx->engine, compType, compId, entId);
+    const EngineCompTransform *trans;
+    Vector3 pos;
+
+    if (transId == ECS_INVALID_ID)
+        return UINT64_MAX;
+    trans = ecs_getCompDataByID(&ctx->engine->ecs, ENGINE_COMP_TRANSFORM,
+                                transId);
+    pos = (Vector3){trans->globalMatrix.m12, trans->globalMatrix.m13,
+                    trans->globalMatrix.m14};
+    pos = Vector3Multiply(Vector3Subtract(pos, ctx->min), ctx->scale);
+    return MortonCode3(pos.x, pos.y, pos.z);
+}
+
+size_t engine_sortComponents(Engine *const engine, const uint32_t compType,
+                             const EngineSortOrder order,
+                             const size_t maxSwaps) {
+    EngineTransformHierarchy *const hier = &engine->transforms;
+    const EngineCompTransform *trans;
+    EngineSortCtx ctx;
+    Vector3 max, pos;
+    size_t chunk, count, i, nSwaps = 0;
+    uint8_t hierValid;
+
+    ctx.engine = engine;
+    if (order == ENGINE_SORT_HIERARCHY)
+        engine_refreshTransformHierarchy(engine);
+    // Moved transforms update their node, so a valid hierarchy stays valid
+    hierValid = compType == ENGINE_COMP_TRANSFORM && !hier->dirty &&
+                hier->epoch == ecs_getEpoch(&engine->ecs, compType);
+    switch (order) {
+    case ENGINE_SORT_ENTITY:
+        nSwaps = ecs_sortComp(&engine->ecs, compType, NULL, NULL, maxSwaps);
+        break;
+    case ENGINE_SORT_HIERARCHY:
+        nSwaps = ecs_sortComp(&engine->ecs, compType, engine_sortKeyHierarchy,
+                              &ctx, maxSwaps);
+        break;
+    case ENGINE_SORT_SPATIAL:
+        // Positions are quantized to 21 bits over the bounds of all the
+        // transforms
+        ctx.min = (Vector3){FLT_MAX, FLT_MAX, FLT_MAX};
+        max = (Vector3){-FLT_MAX, -FLT_MAX, -FLT_MAX};
+        for (chunk = 0;
+             (trans = ecs_getCompChunk(&engine->ecs, ENGINE_COMP_TRANSFORM,
+                                       chunk, &count, NULL)) != NULL;
+             chunk++) {
+            for (i = 0; i < count; i++) {
+                pos = (Vector3){trans[i].globalMatrix.m12,
+                                trans[i].globalMatrix.m13,
+                                trans[i].globalMatrix.m14};
+                ctx.min = Vector3Min(ctx.min, pos);
+                max = Vector3Max(max, pos);
+            }
         }
+        max = Vector3Subtract(max, ctx.min);
+        ctx.scale.x = max.x > 0 ? 0x1fffff / max.x : 0;
+        ctx.scale.y = max.y > 0 ? 0x1fffff / max.y : 0;
+        ctx.scale.z = max.z > 0 ? 0x1fffff / max.z : 0;
+        nSwaps = ecs_sortComp(&engine->ecs, compType, engine_sortKeySpatial,
+                              &ctx, maxSwaps);
+        break;
+    }
+    if (hierValid)
+        hier->epoch = ecs_getEpoch(&engine->ecs, compType);
+    return nSwaps;
+}
+
+// Bring the transform pool back to hierarchy order a few swaps at a time, so
+// that the transform pass walks memory linearly. Only done after structural
+// changes.
+static void engine_sortTransforms(Engine *const engine) {
+    EngineTransformHierarchy *const hier = &engine->transforms;
+    if (!hier->dirty &&
+        hier->sortedEpoch == ecs_getEpoch(&engine->ecs, ENGINE_COMP_TRANSFORM))
+        return;
+    if (engine_sortComponents(engine, ENGINE_COMP_TRANSFORM,
+                              ENGINE_SORT_HIERARCHY,
+                              ENGINE_SORT_SWAPS_PER_STEP) == 0)
+        hier->sortedEpoch = ecs_getEpoch(&engine->ecs, ENGINE_COMP_TRANSFORM);
+}
+
+// Recompute the world space boxes of the mesh renderers whose transform or
+// box changed since the last step. Done here so that rendering stays read only.
+static void engine_updateBoundingBoxes(Engine *const engine) {
+    const ECSQuery *const meshRend = engine->render.meshRend;
+    EngineCompMeshRenderer **const meshRendComps =
+        (EngineCompMeshRenderer **)ecs_queryComp(meshRend,
+                                                 ENGINE_COMP_MESHRENDERER);
+    EngineCompMeshRenderer *meshRendComp;
+    const EngineCompTransform *trans;
+    ECSComponentID transId, meshRendId;
+    uint32_t transTick, meshRendTick;
+
+    for (uint32_t i = 0; i < meshRend->nEnt; i++) {
+        meshRendComp = meshRendComps[i];
+        if (ecs_getCompID(&engine->ecs, meshRendComp->transform,
+                          ENGINE_COMP_TRANSFORM, &transId) != ECS_RES_OK)
+            continue;
+        ecs_getCompID(&engine->ecs, meshRend->ent[i], ENGINE_COMP_MESHRENDERER,
+                      &meshRendId);
+        transTick = ecs_getChangeTickByID(&engine->ecs, ENGINE_COMP_TRANSFORM,
+                                          transId);
+        meshRendTick = ecs_getChangeTickByID(
+            &engine->ecs, ENGINE_COMP_MESHRENDERER, meshRendId);
+        if (transTick <= meshRendComp->_boundingBoxTick &&
+            meshRendTick <= meshRendComp->_boundingBoxTick)
+            continue;
+        trans = ecs_getCompDataByID(&engine->ecs, ENGINE_COMP_TRANSFORM,
+                                    transId);
+        meshRendComp->_boundingBoxTrans =
+            BoxTransform(meshRendComp->boundingBox, trans->globalMatrix);
+        meshRendComp->_boundingBoxTick = ecs_getTick(&engine->ecs);
     }
 }
 
 void engine_stepUpdate(Engine *const engine, const float deltaTime) {
     const static int physSubsteps = 1;
 
+    ecs_advanceTick(&engine->ecs);
+    engine_sortTransforms(engine);
     if (GetTime() > engine->physLastUpdate + engine->physDeltaTime) {
         engine->physLastUpdate = GetTime();
         for (int i = 0; i < physSubsteps; i++) {
@@ -161,6 +818,8 @@ void engine_stepUpdate(Engine *const engine, const float deltaTime) {
     }
 
     engine_execUpdateCallbacks(engine, deltaTime);
+    engine_flushCommands(engine);
+    engine_updateBoundingBoxes(engine);
 }
 
 EngineStatus engine_render_addModel(Engine *const engine,
@@ -208,45 +867,21 @@ Shader engine_render_getShader(Engine *engine, EngineShaderID id) {
     return *shader;
 }
 
-static EngineStatus
-engine_render_registerMeshRenderer(Engine *const engine,
-                                   const ECSComponentID id) {
-    if (array_has(&engine->render.meshRend, (ArrayVal)id)) {
-        logMsg(LOG_LVL_ERR, "duplicate mesh renderer id %u", id);
-        return ENGINE_STATUS_RENDER_DUPLICATE_ITEM;
-    }
-    array_pushBack(&engine->render.meshRend, (ArrayVal)id);
-    logMsg(LOG_LVL_DEBUG, "registered mesh renderer id %u", id);
-    return ENGINE_STATUS_OK;
-}
-
-static EngineStatus
-engine_render_unregisterMeshRenderer(Engine *const engine,
-                                     const ECSComponentID id) {
-    const uint32_t pos = array_at(&engine->render.meshRend, (ArrayVal)id);
-    if (!array_del(&engine->render.meshRend, pos)) {
-        logMsg(LOG_LVL_ERR, "mesh renderer id %u not found", id);
-        return ENGINE_STATUS_RENDER_ITEM_NOT_FOUND;
-    }
-    logMsg(LOG_LVL_DEBUG, "unregistered mesh renderer id %u", id);
-    return ENGINE_STATUS_OK;
-}
-
 EngineStatus engine_render_registerLightSrc(Engine *const engine,
-                                            const ECSComponentID id) {
-    if (array_has(&engine->render.lightSrc, (ArrayVal)id)) {
+                                            const ECSEntityID id) {
+    if (vecU32_find(&engine->render.lightSrc, id) !=
+        engine->render.lightSrc.n) {
         logMsg(LOG_LVL_ERR, "duplicate light source id %u", id);
         return ENGINE_STATUS_RENDER_DUPLICATE_ITEM;
     }
-    array_pushBack(&engine->render.lightSrc, (ArrayVal)id);
+    vecU32_push(&engine->render.lightSrc, id);
     logMsg(LOG_LVL_DEBUG, "registered light source id %u", id);
     return ENGINE_STATUS_OK;
 }
 
 EngineStatus engine_render_unregisterLightSrc(Engine *const engine,
-                                              const ECSComponentID id) {
-    const uint32_t pos = array_at(&engine->render.lightSrc, (ArrayVal)id);
-    if (!array_del(&engine->render.lightSrc, pos)) {
+                                              const ECSEntityID id) {
+    if (!vecU32_erase(&engine->render.lightSrc, id)) {
         logMsg(LOG_LVL_ERR, "light source id %u not found", id);
         return ENGINE_STATUS_RENDER_ITEM_NOT_FOUND;
     }
@@ -254,7 +889,7 @@ EngineStatus engine_render_unregisterLightSrc(Engine *const engine,
     return ENGINE_STATUS_OK;
 }
 
-void engine_render_setCamera(Engine *engine, const ECSComponentID id) {
+void engine_render_setCamera(Engine *engine, const ECSEntityID id) {
     engine->render.camera = id;
 }
 
@@ -322,241 +957,304 @@ EngineStatus engine_entityBroadcastMsg(Engine *const engine,
 }
 
 // Engine callbacks for the Entity Component System
-static void engine_cbMeshRendererOnCreate(uint32_t cbType, ECSEntityID entId,
-                                          ECSComponentID compId,
-                                          uint32_t compType,
-                                          struct ECSComponent *comp,
-                                          void *cbUserData) {
-    const EngineCallbackData *cbData = cbUserData;
-    engine_render_registerMeshRenderer(cbData->engine, entId);
-}
-
-static void engine_cbMeshRendererOnDestroy(uint32_t cbType, ECSEntityID entId,
-                                           ECSComponentID compId,
-                                           uint32_t compType,
-                                           struct ECSComponent *comp,
-                                           void *cbUserData) {
-    const EngineCallbackData *cbData = cbUserData;
-    engine_render_unregisterMeshRenderer(cbData->engine, entId);
+static void engine_cbPhysicsOnReloc(ECSEntityID entId, uint32_t compType,
+                                    void *compData, void *userData) {
+    Engine *const engine = userData;
+    EngineCompTransform *trans;
+    EngineTransformNode *node;
+    Collider *coll;
+
+    switch (compType) {
+    case ENGINE_COMP_RIGIDBODY:
+        physics_relocateRigidBody(&engine->phys, entId, compData);
+        break;
+    case ENGINE_COMP_TRANSFORM:
+        trans = compData;
+        // Keep the hierarchy node pointing at the moved transform
+        if (trans->_node < engine->transforms.nNodes) {
+            node = engine->transforms.node + trans->_node;
+            node->trans = trans;
+            ecs_getCompID(&engine->ecs, entId, ENGINE_COMP_TRANSFORM,
+                          &node->compId);
+        }
+        if (ecs_compExists(&engine->ecs, entId, ENGINE_COMP_COLLIDER) !=
+            ECS_RES_OK)
+            break;
+        coll = engine_getCollider(engine, entId);
+        physics_relocateCollider(&engine->phys, entId, coll,
+                                 &trans->globalMatrix);
+        break;
+    case ENGINE_COMP_COLLIDER:
+        if (ecs_compExists(&engine->ecs, entId, ENGINE_COMP_TRANSFORM) !=
+            ECS_RES_OK)
+            break;
+        trans = engine_getTransform(engine, entId);
+        physics_relocateCollider(&engine->phys, entId, compData,
+                                 &trans->globalMatrix);
+        break;
+    }
 }
 
-static void engine_cbRigidBodyOnCreate(uint32_t cbType, ECSEntityID entId,
-                                       ECSComponentID compId, uint32_t compType,
-                                       struct ECSComponent *comp,
-                                       void *cbUserData) {
+static void engine_cbRigidBodyOnCreate(uint32_t cbType, uint32_t compType,
+                                       size_t count, const ECSEntityID *entIds,
+                                       void *compData, void *cbUserData) {
     const EngineCallbackData *cbData = cbUserData;
-    EngineCompTransform *trans = engine_getTransform(cbData->engine, entId);
-    Collider *coll = engine_getCollider(cbData->engine, entId);
-    RigidBody *rb = &((EngineECSCompData *)comp->data)->rigidBody;
-    Matrix *mat;
+    RigidBody *const rigidBodies = compData;
+    EngineCompTransform *trans;
+    Collider *coll;
+    RigidBody *rb;
     BoundingBox *bb;
+    ECSEntityID entId;
 
-    if (trans == NULL) {
-        logMsg(LOG_LVL_FATAL, "no transform found for rigidbody in ent. %u",
-               entId);
-        return;
-    }
-    if (coll == NULL) {
-        logMsg(LOG_LVL_FATAL, "no collider found for rigidbody in ent. %u",
-               entId);
-        return;
-    }
+    for (size_t i = 0; i < count; i++) {
+        entId = entIds[i];
+        rb = rigidBodies + i;
+        trans = engine_getTransform(cbData->engine, entId);
+        coll = engine_getCollider(cbData->engine, entId);
+        if (trans == NULL) {
+            logMsg(LOG_LVL_FATAL, "no transform found for rigidbody in ent. %u",
+                   entId);
+            continue;
+        }
+        if (coll == NULL) {
+            logMsg(LOG_LVL_FATAL, "no collider found for rigidbody in ent. %u",
+                   entId);
+            continue;
+        }
 
-    // mat = &trans->globalMatrix;
-    bb = &coll->bounds;
-    // Vector3 fullWidth = (Vector3){mat->m0 * 2, mat->m5 * 2, mat->m10 * 2};
-    Vector3 fullWidth = Vector3Scale(trans->scale, 2);
-    fullWidth = Vector3Multiply(fullWidth, (Vector3){bb->max.x - bb->min.x,
-                                                     bb->max.y - bb->min.y,
-                                                     bb->max.z - bb->min.z});
-    Vector3 dimsSqr = Vector3Multiply(fullWidth, fullWidth);
-    if (rb->mass != 0.0f) {
-        // assuming bounidng box shape
-        rb->inverseInertia = (Vector3){12.f / (dimsSqr.y + dimsSqr.z),
-                                       12.f / (dimsSqr.x + dimsSqr.z),
-                                       12.f / (dimsSqr.x + dimsSqr.y)};
-        logMsg(LOG_LVL_INFO, "init %s to inv inertia %.2f, %.2f, %.2f",
-               ecs_getEntityNameCstrP(&cbData->engine->ecs, entId),
-               rb->inverseInertia.x, rb->inverseInertia.y,
-               rb->inverseInertia.z);
-    }
-
-    trans->pos = rb->pos;
-    trans->localUpdate = 1;
+        bb = &coll->bounds;
+        Vector3 fullWidth = Vector3Scale(trans->scale, 2);
+        fullWidth = Vector3Multiply(
+            fullWidth, (Vector3){bb->max.x - bb->min.x, bb->max.y - bb->min.y,
+                                 bb->max.z - bb->min.z});
+        Vector3 dimsSqr = Vector3Multiply(fullWidth, fullWidth);
+        if (rb->mass != 0.0f) {
+            // assuming bounidng box shape
+            rb->inverseInertia = (Vector3){12.f / (dimsSqr.y + dimsSqr.z),
+                                           12.f / (dimsSqr.x + dimsSqr.z),
+                                           12.f / (dimsSqr.x + dimsSqr.y)};
+            logMsg(LOG_LVL_INFO, "init %s to inv inertia %.2f, %.2f, %.2f",
+                   ecs_getEntityNameCstrP(&cbData->engine->ecs, entId),
+                   rb->inverseInertia.x, rb->inverseInertia.y,
+                   rb->inverseInertia.z);
+        }
+
+        trans->pos = rb->pos;
+        trans->localUpdate = 1;
 
-    physics_addRigidBody(&cbData->engine->phys, entId, rb);
+        physics_addRigidBody(&cbData->engine->phys, entId, rb);
+    }
 }
 
-static void engine_cbRigidBodyOnUpdate(uint32_t cbType, ECSEntityID entId,
-                                       ECSComponentID compId, uint32_t compType,
-                                       struct ECSComponent *comp,
-                                       void *cbUserData) {
+static void engine_cbRigidBodyOnUpdate(uint32_t cbType, uint32_t compType,
+                                       size_t count, const ECSEntityID *entIds,
+                                       void *compData, void *cbUserData) {
     const EngineCallbackData *cbData = cbUserData;
-    EngineCompTransform *trans = engine_getTransform(cbData->engine, entId);
-    RigidBody *rb = &((EngineECSCompData *)comp->data)->rigidBody;
-
-    Vector3 cogRotated = Vector3RotateByQuaternion(rb->cog, rb->rot);
-
-    trans->pos = Vector3Subtract(rb->pos, cogRotated);
-    trans->rot = rb->rot;
-    trans->localUpdate = 1;
+    const RigidBody *const rigidBodies = compData;
+    EngineCompTransform *trans;
+    const RigidBody *rb;
+
+    for (size_t i = 0; i < count; i++) {
+        rb = rigidBodies + i;
+        trans = engine_getTransform(cbData->engine, entIds[i]);
+        Vector3 cogRotated = Vector3RotateByQuaternion(rb->cog, rb->rot);
+
+        trans->pos = Vector3Subtract(rb->pos, cogRotated);
+        trans->rot = rb->rot;
+        trans->localUpdate = 1;
+    }
 }
 
-static void engine_cbRigidBodyOnDestroy(uint32_t cbType, ECSEntityID entId,
-                                        ECSComponentID compId,
-                                        uint32_t compType,
-                                        struct ECSComponent *comp,
-                                        void *cbUserData) {
+static void engine_cbRigidBodyOnDestroy(uint32_t cbType, uint32_t compType,
+                                        size_t count, const ECSEntityID *entIds,
+                                        void *compData, void *cbUserData) {
     const EngineCallbackData *cbData = cbUserData;
-    physics_removeRigidBody(&cbData->engine->phys, entId);
+    for (size_t i = 0; i < count; i++)
+        physics_removeRigidBody(&cbData->engine->phys, entIds[i]);
 }
 
-static void engine_cbColliderOnCreate(uint32_t cbType, ECSEntityID entId,
-                                      ECSComponentID compId, uint32_t compType,
-                                      struct ECSComponent *comp,
-                                      void *cbUserData) {
+static void engine_cbColliderOnCreate(uint32_t cbType, uint32_t compType,
+                                      size_t count, const ECSEntityID *entIds,
+                                      void *compData, void *cbUserData) {
     const EngineCallbackData *cbData = cbUserData;
-    EngineCompTransform *trans = engine_getTransform(cbData->engine, entId);
-    Collider *coll = &((EngineECSCompData *)comp->data)->coll;
+    Collider *const colliders = compData;
+    EngineCompTransform *trans;
 
-    if (trans == NULL) {
-        logMsg(LOG_LVL_FATAL, "no transform found for collider in ent. %u",
-               entId);
-        return;
+    for (size_t i = 0; i < count; i++) {
+        trans = engine_getTransform(cbData->engine, entIds[i]);
+        if (trans == NULL) {
+            logMsg(LOG_LVL_FATAL, "no transform found for collider in ent. %u",
+                   entIds[i]);
+            continue;
+        }
+        physics_addCollider(&cbData->engine->phys, entIds[i], colliders + i,
+                            &trans->globalMatrix);
     }
-
-    physics_addCollider(&cbData->engine->phys, entId, coll,
-                        &trans->globalMatrix);
 }
 
-static void engine_cbColliderOnDestroy(uint32_t cbType, ECSEntityID entId,
-                                       ECSComponentID compId, uint32_t compType,
-                                       struct ECSComponent *comp,
-                                       void *cbUserData) {
+static void engine_cbColliderOnDestroy(uint32_t cbType, uint32_t compType,
+                                       size_t count, const ECSEntityID *entIds,
+                                       void *compData, void *cbUserData) {
     const EngineCallbackData *cbData = cbUserData;
-    physics_removeCollider(&cbData->engine->phys, entId);
+    for (size_t i = 0; i < count; i++)
+        physics_removeCollider(&cbData->engine->phys, entIds[i]);
 }
 
-static void engine_cbLightSourceOnCreate(uint32_t cbType, ECSEntityID entId,
-                                         ECSComponentID compId,
-                                         uint32_t compType,
-                                         struct ECSComponent *comp,
-                                         void *cbUserData) {
-    const EngineCallbackData *cbData = cbUserData;
-    engine_render_registerLightSrc(cbData->engine, compId);
+static void engine_obsLightSources(uint32_t compType,
+                                   const ECSEntityID *removed, size_t nRemoved,
+                                   const ECSEntityID *added, size_t nAdded,
+                                   void *userData) {
+    // Light sources are few: rebuilding the list is cheaper than looking up
+    // each removed one in it
+    engine_collectLightSrcs(userData);
 }
 
-static void engine_cbLightSourceOnDestroy(uint32_t cbType, ECSEntityID entId,
-                                          ECSComponentID compId,
-                                          uint32_t compType,
-                                          struct ECSComponent *comp,
-                                          void *cbUserData) {
+static void engine_cbLightSourceOnUpdate(uint32_t cbType, uint32_t compType,
+                                         size_t count,
+                                         const ECSEntityID *entIds,
+                                         void *compData, void *cbUserData) {
     const EngineCallbackData *cbData = cbUserData;
-    engine_render_unregisterLightSrc(cbData->engine, compId);
-}
-
-static void engine_cbLightSourceOnUpdate(uint32_t cbType, ECSEntityID entId,
-                                         ECSComponentID compId,
-                                         uint32_t compType,
-                                         struct ECSComponent *comp,
-                                         void *cbUserData) {
-    const EngineCallbackData *cbData = cbUserData;
-    const EngineCompTransform *trans =
-        engine_getTransform(cbData->engine, entId);
-    EngineCompLightSrc *light = (EngineCompLightSrc *)comp->data;
+    EngineCompLightSrc *const lights = compData;
+    const EngineCompTransform *trans;
     const Matrix *mat;
 
-    if (light->type == ENGINE_LIGHTSRC_POINT) {
+    for (size_t i = 0; i < count; i++) {
+        if (lights[i].type != ENGINE_LIGHTSRC_POINT)
+            continue;
+        trans = engine_getTransform(cbData->engine, entIds[i]);
         if (trans == NULL) {
-            logMsg(LOG_LVL_ERR,
-                   "no trans. found for point light in ent %u, comp %u", entId,
-                   compId);
-            return;
+            logMsg(LOG_LVL_ERR, "no trans. found for point light in ent %u",
+                   entIds[i]);
+            continue;
         }
         mat = &trans->globalMatrix;
-        light->pos = (Vector3){mat->m12, mat->m13, mat->m14};
+        lights[i].pos = (Vector3){mat->m12, mat->m13, mat->m14};
     }
 }
 
-static void engine_cbCameraOnUpdate(uint32_t cbType, ECSEntityID entId,
-                                    ECSComponentID compId, uint32_t compType,
-                                    struct ECSComponent *comp,
-                                    void *cbUserData) {
+static void engine_cbCameraOnUpdate(uint32_t cbType, uint32_t compType,
+                                    size_t count, const ECSEntityID *entIds,
+                                    void *compData, void *cbUserData) {
     EngineCallbackData *cbData = cbUserData;
-    EngineCompTransform *trans = engine_getTransform(cbData->engine, entId);
-    EngineCompCamera *cam =
-        (EngineCompCamera *)
-            comp->data; // engine_getCamera(cbData->engine, entId);
-    Matrix *mat = &trans->globalMatrix;
-    if (trans == NULL) {
-        logMsg(LOG_LVL_ERR, "camera id %u's entity has no transform", compId);
-        return;
-    }
+    EngineCompCamera *const cams = compData;
+    EngineCompTransform *trans;
+    Matrix *mat;
 
-    cam->cam.position = (Vector3){mat->m12, mat->m13, mat->m14};
+    for (size_t i = 0; i < count; i++) {
+        trans = engine_getTransform(cbData->engine, entIds[i]);
+        if (trans == NULL) {
+            logMsg(LOG_LVL_ERR, "camera of entity %u has no transform",
+                   entIds[i]);
+            continue;
+        }
+        mat = &trans->globalMatrix;
+        cams[i].cam.position = (Vector3){mat->m12, mat->m13, mat->m14};
+    }
 }
 
-static void engine_cbTransformOnCreate(uint32_t cbType, ECSEntityID entId,
-                                       ECSComponentID compId, uint32_t compType,
-                                       struct ECSComponent *comp,
-                                       void *cbUserData) {
+static void engine_cbTransformOnCreate(uint32_t cbType, uint32_t compType,
+                                       size_t count, const ECSEntityID *entIds,
+                                       void *compData, void *cbUserData) {
     EngineCallbackData *cbData = cbUserData;
-    EngineCompTransform *trans = engine_getTransform(cbData->engine, entId);
-    if (trans == NULL) {
-        logMsg(LOG_LVL_FATAL, "cannot find transform in component %u", compId);
-        return;
+    EngineCompTransform *const trans = compData;
+    Engine *const engine = cbData->engine;
+
+    // Give the new transforms their matrices right away, the hierarchy is
+    // only sorted again on the next update
+    for (size_t i = 0; i < count; i++) {
+        engine_computeTransform(&trans[i],
+                                trans[i].anchor == ECS_INVALID_ID
+                                    ? NULL
+                                    : engine_getTransform(engine,
+                                                          trans[i].anchor));
     }
-    engine_updateTransform(cbData->engine, (EngineECSCompData *)comp->data);
+}
+
+// Assign the system callbacks of the engine component types
+static void engine_registerSystems(Engine *const engine) {
+    ecs_setSystemCallback(&engine->ecs, ENGINE_COMP_TRANSFORM, ENGINE_CB_CREATE,
+                          engine_cbTransformOnCreate);
+    ecs_setSystemCallback(&engine->ecs, ENGINE_COMP_CAMERA, ENGINE_CB_UPDATE,
+                          engine_cbCameraOnUpdate);
+    ecs_setSystemCallback(&engine->ecs, ENGINE_COMP_LIGHTSOURCE,
+                          ENGINE_CB_UPDATE, engine_cbLightSourceOnUpdate);
+    ecs_setSystemCallback(&engine->ecs, ENGINE_COMP_RIGIDBODY, ENGINE_CB_CREATE,
+                          engine_cbRigidBodyOnCreate);
+    ecs_setSystemCallback(&engine->ecs, ENGINE_COMP_RIGIDBODY, ENGINE_CB_UPDATE,
+                          engine_cbRigidBodyOnUpdate);
+    ecs_setSystemCallback(&engine->ecs, ENGINE_COMP_RIGIDBODY,
+                          ENGINE_CB_DESTROY, engine_cbRigidBodyOnDestroy);
+    ecs_setSystemCallback(&engine->ecs, ENGINE_COMP_COLLIDER, ENGINE_CB_CREATE,
+                          engine_cbColliderOnCreate);
+    ecs_setSystemCallback(&engine->ecs, ENGINE_COMP_COLLIDER, ENGINE_CB_DESTROY,
+                          engine_cbColliderOnDestroy);
+
+    // Update systems only touch the components of their own entities, so they
+    // can run on the worker threads
+    ecs_setSystemAccess(&engine->ecs, ENGINE_COMP_RIGIDBODY, ENGINE_CB_UPDATE,
+                        ECS_COMP_MASK(ENGINE_COMP_RIGIDBODY),
+                        ECS_COMP_MASK(ENGINE_COMP_TRANSFORM));
+    ecs_setSystemAccess(&engine->ecs, ENGINE_COMP_CAMERA, ENGINE_CB_UPDATE,
+                        ECS_COMP_MASK(ENGINE_COMP_TRANSFORM),
+                        ECS_COMP_MASK(ENGINE_COMP_CAMERA));
+    ecs_setSystemAccess(&engine->ecs, ENGINE_COMP_LIGHTSOURCE,
+                        ENGINE_CB_UPDATE, ECS_COMP_MASK(ENGINE_COMP_TRANSFORM),
+                        ECS_COMP_MASK(ENGINE_COMP_LIGHTSOURCE));
 }
 
 EngineStatus engine_createInfo(Engine *const engine, const ECSEntityID ent,
                                const EngineEntType entTypeMask) {
     const EngineECSCompType type = ENGINE_COMP_INFO;
-    ECSComponent compRaw;
-    EngineCompInfo *const comp = &(((EngineECSCompData *)&compRaw.data)->info);
+    EngineCompInfo compData;
+    EngineCompInfo *const comp = &compData;
     comp->typeMask = entTypeMask;
-    if (ecs_registerComp(&engine->ecs, ent, type, compRaw) == ECS_RES_OK)
-        return ENGINE_STATUS_OK;
-    return ENGINE_STATUS_REGISTER_FAILED;
+    if (ecs_registerCompData(&engine->ecs, ent, type, comp) != ECS_RES_OK)
+        return ENGINE_STATUS_REGISTER_FAILED;
+    ecs_addTags(&engine->ecs, ent, ECS_TAG_MASK(ENGINE_TAG_INFO) | entTypeMask);
+    return ENGINE_STATUS_OK;
+}
+
+EngineStatus engine_setEntityType(Engine *const engine, const ECSEntityID ent,
+                                  const EngineEntType entTypeMask) {
+    EngineCompInfo *const info = engine_getInfo(engine, ent);
+    if (info == NULL)
+        return ENGINE_STATUS_REGISTER_FAILED;
+    ecs_removeTags(&engine->ecs, ent, info->typeMask);
+    ecs_addTags(&engine->ecs, ent, entTypeMask);
+    info->typeMask = entTypeMask;
+    return ENGINE_STATUS_OK;
 }
 
 EngineStatus engine_createTransform(Engine *const engine, const ECSEntityID ent,
                                     const ECSEntityID transformAnchor) {
     const EngineECSCompType type = ENGINE_COMP_TRANSFORM;
-    ECSComponent compRaw;
-    EngineCompTransform *const comp =
-        &(((EngineECSCompData *)&compRaw.data)->trans);
+    EngineCompTransform compData;
+    EngineCompTransform *const comp = &compData;
     comp->anchor = transformAnchor;
     comp->globalMatrix = MatrixIdentity();
     comp->localMatrix = MatrixIdentity();
     comp->pos = (Vector3){0, 0, 0};
     comp->scale = (Vector3){1, 1, 1};
     comp->rot = QuaternionFromEuler(0, 0, 0);
-    comp->_globalUpdate = 0;
     comp->localUpdate = 1;
-    if (ecs_registerComp(&engine->ecs, ent, type, compRaw) == ECS_RES_OK) {
-        ecs_setCallback(&engine->ecs, ent, type, ENGINE_CB_CREATE,
-                        engine_cbTransformOnCreate);
+    comp->_node = ECS_INVALID_ID;
+    if (ecs_registerCompData(&engine->ecs, ent, type, comp) == ECS_RES_OK)
         return ENGINE_STATUS_OK;
-    }
     return ENGINE_STATUS_REGISTER_FAILED;
 }
 
 EngineStatus engine_createCamera(Engine *const engine, const ECSEntityID ent,
                                  const float fov, const int projection) {
     const EngineECSCompType type = ENGINE_COMP_CAMERA;
-    ECSComponent compRaw;
-    EngineCompCamera *const comp = &(((EngineECSCompData *)&compRaw.data)->cam);
+    EngineCompCamera compData;
+    EngineCompCamera *const comp = &compData;
     comp->cam.fovy = fov;
     comp->cam.position = (Vector3){0, 0, 0};
     comp->cam.projection = projection;
     comp->cam.target = (Vector3){0, 0, 1};
     comp->cam.up = (Vector3){0, 1, 0};
-    if (ecs_registerComp(&engine->ecs, ent, type, compRaw) == ECS_RES_OK) {
-        ecs_setCallback(&engine->ecs, ent, type, ENGINE_CB_UPDATE,
-                        engine_cbCameraOnUpdate);
+    if (ecs_registerCompData(&engine->ecs, ent, type, comp) == ECS_RES_OK)
         return ENGINE_STATUS_OK;
-    }
     return ENGINE_STATUS_REGISTER_FAILED;
 }
 
@@ -565,9 +1263,8 @@ EngineStatus engine_createMeshRenderer(Engine *const engine,
                                        const ECSEntityID transformAnchor,
                                        const EngineRenderModelID modelId) {
     const EngineECSCompType type = ENGINE_COMP_MESHRENDERER;
-    ECSComponent compRaw;
-    EngineCompMeshRenderer *const comp =
-        &(((EngineECSCompData *)&compRaw.data)->meshR);
+    EngineCompMeshRenderer compData;
+    EngineCompMeshRenderer *const comp = &compData;
     HashmapVal modelHVal;
     ECSStatus res;
 
@@ -588,6 +1285,7 @@ EngineStatus engine_createMeshRenderer(Engine *const engine,
     comp->shaderId = ECS_INVALID_ID;
     comp->distanceMode = RENDER_DIST_FROM_CAMERA;
     comp->transform = transformAnchor;
+    comp->_boundingBoxTick = 0;
 
     if (transformAnchor == ECS_INVALID_ID) {
         res = ecs_compExists(&engine->ecs, ent, ENGINE_COMP_TRANSFORM);
@@ -599,13 +1297,8 @@ EngineStatus engine_createMeshRenderer(Engine *const engine,
         }
     }
 
-    if (ecs_registerComp(&engine->ecs, ent, type, compRaw) == ECS_RES_OK) {
-        ecs_setCallback(&engine->ecs, ent, type, ENGINE_CB_CREATE,
-                        engine_cbMeshRendererOnCreate);
-        ecs_setCallback(&engine->ecs, ent, type, ENGINE_CB_DESTROY,
-                        engine_cbMeshRendererOnDestroy);
+    if (ecs_registerCompData(&engine->ecs, ent, type, comp) == ECS_RES_OK)
         return ENGINE_STATUS_OK;
-    }
     return ENGINE_STATUS_REGISTER_FAILED;
 }
 
@@ -613,33 +1306,24 @@ EngineStatus engine_createAmbientLight(Engine *const engine,
                                        const ECSEntityID ent,
                                        const Vector3 color) {
     const EngineECSCompType type = ENGINE_COMP_LIGHTSOURCE;
-    ECSComponent compRaw;
-    EngineCompLightSrc *const comp =
-        &(((EngineECSCompData *)&compRaw.data)->light);
+    EngineCompLightSrc compData;
+    EngineCompLightSrc *const comp = &compData;
     uint8_t res;
     comp->type = ENGINE_LIGHTSRC_AMBIENT;
     comp->visible = 1;
     comp->castShadow = 0;
     comp->color = color;
 
-    if (ecs_registerComp(&engine->ecs, ent, type, compRaw) == ECS_RES_OK) {
-        ecs_setCallback(&engine->ecs, ent, type, ENGINE_CB_CREATE,
-                        engine_cbLightSourceOnCreate);
-        ecs_setCallback(&engine->ecs, ent, type, ENGINE_CB_DESTROY,
-                        engine_cbLightSourceOnDestroy);
-        ecs_setCallback(&engine->ecs, ent, type, ENGINE_CB_UPDATE,
-                        engine_cbLightSourceOnUpdate);
+    if (ecs_registerCompData(&engine->ecs, ent, type, comp) == ECS_RES_OK)
         return ENGINE_STATUS_OK;
-    }
     return ENGINE_STATUS_REGISTER_FAILED;
 }
 
 EngineStatus engine_createDirLight(Engine *const engine, const ECSEntityID ent,
                                    const Vector3 color, const Vector3 dir) {
     const EngineECSCompType type = ENGINE_COMP_LIGHTSOURCE;
-    ECSComponent compRaw;
-    EngineCompLightSrc *const comp =
-        &(((EngineECSCompData *)&compRaw.data)->light);
+    EngineCompLightSrc compData;
+    EngineCompLightSrc *const comp = &compData;
     uint8_t res;
     comp->type = ENGINE_LIGHTSRC_DIRECTIONAL;
     comp->visible = 1;
@@ -647,15 +1331,8 @@ EngineStatus engine_createDirLight(Engine *const engine, const ECSEntityID ent,
     comp->dir = dir;
     comp->color = color;
 
-    if (ecs_registerComp(&engine->ecs, ent, type, compRaw) == ECS_RES_OK) {
-        ecs_setCallback(&engine->ecs, ent, type, ENGINE_CB_CREATE,
-                        engine_cbLightSourceOnCreate);
-        ecs_setCallback(&engine->ecs, ent, type, ENGINE_CB_DESTROY,
-                        engine_cbLightSourceOnDestroy);
-        ecs_setCallback(&engine->ecs, ent, type, ENGINE_CB_UPDATE,
-                        engine_cbLightSourceOnUpdate);
+    if (ecs_registerCompData(&engine->ecs, ent, type, comp) == ECS_RES_OK)
         return ENGINE_STATUS_OK;
-    }
     return ENGINE_STATUS_REGISTER_FAILED;
 }
 
@@ -665,9 +1342,8 @@ EngineStatus engine_createPointLight(Engine *const engine,
                                      const Vector3 color, const Vector3 pos,
                                      const float range) {
     const EngineECSCompType type = ENGINE_COMP_LIGHTSOURCE;
-    ECSComponent compRaw;
-    EngineCompLightSrc *const comp =
-        &(((EngineECSCompData *)&compRaw.data)->light);
+    EngineCompLightSrc compData;
+    EngineCompLightSrc *const comp = &compData;
     uint8_t res;
     comp->type = ENGINE_LIGHTSRC_POINT;
     comp->visible = 1;
@@ -687,78 +1363,68 @@ EngineStatus engine_createPointLight(Engine *const engine,
         }
     }
 
-    if (ecs_registerComp(&engine->ecs, ent, type, compRaw) == ECS_RES_OK) {
-        ecs_setCallback(&engine->ecs, ent, type, ENGINE_CB_CREATE,
-                        engine_cbLightSourceOnCreate);
-        ecs_setCallback(&engine->ecs, ent, type, ENGINE_CB_DESTROY,
-                        engine_cbLightSourceOnDestroy);
-        ecs_setCallback(&engine->ecs, ent, type, ENGINE_CB_UPDATE,
-                        engine_cbLightSourceOnUpdate);
+    if (ecs_registerCompData(&engine->ecs, ent, type, comp) == ECS_RES_OK)
         return ENGINE_STATUS_OK;
-    }
     return ENGINE_STATUS_REGISTER_FAILED;
 }
 
 EngineStatus engine_createRigidBody(Engine *const engine, const ECSEntityID ent,
                                     const float mass) {
     const EngineECSCompType type = ENGINE_COMP_RIGIDBODY;
-    ECSComponent compRaw;
-    RigidBody *const comp = &(((EngineECSCompData *)&compRaw.data)->rigidBody);
+    RigidBody compData;
+    RigidBody *const comp = &compData;
     const Collider *coll;
     *comp = physics_initRigidBody(mass);
 
-    if (ecs_registerComp(&engine->ecs, ent, type, compRaw) == ECS_RES_OK) {
-        ecs_setCallback(&engine->ecs, ent, type, ENGINE_CB_CREATE,
-                        engine_cbRigidBodyOnCreate);
-        ecs_setCallback(&engine->ecs, ent, type, ENGINE_CB_UPDATE,
-                        engine_cbRigidBodyOnUpdate);
-        ecs_setCallback(&engine->ecs, ent, type, ENGINE_CB_DESTROY,
-                        engine_cbRigidBodyOnDestroy);
+    if (ecs_registerCompData(&engine->ecs, ent, type, comp) == ECS_RES_OK)
         return ENGINE_STATUS_OK;
-    }
     return ENGINE_STATUS_REGISTER_FAILED;
 }
 
 EngineStatus engine_createSphereCollider(Engine *engine, ECSEntityID ent,
                                          float radius) {
     const EngineECSCompType type = ENGINE_COMP_COLLIDER;
-    ECSComponent compRaw;
-    Collider *const comp = &(((EngineECSCompData *)&compRaw.data)->coll);
+    Collider compData;
+    Collider *const comp = &compData;
     *comp = initCollider();
     comp->type = COLLIDER_TYPE_SPHERE;
     comp->sphere.radius = radius;
 
-    if (ecs_registerComp(&engine->ecs, ent, type, compRaw) == ECS_RES_OK)
+    if (ecs_registerCompData(&engine->ecs, ent, type, comp) == ECS_RES_OK)
         return ENGINE_STATUS_OK;
     return ENGINE_STATUS_REGISTER_FAILED;
 }
 
-EngineStatus engine_createConvexHullCollider(Engine *engine, ECSEntityID ent,
-                                             unsigned short *ind, float *vert,
-                                             size_t nVert) {
+static EngineStatus engine_registerConvexHull(Engine *engine, ECSEntityID ent,
+                                              unsigned short *ind, float *vert,
+                                              size_t nVert, uint32_t modelId) {
     const EngineECSCompType type = ENGINE_COMP_COLLIDER;
-    ECSComponent compRaw;
-    Collider *const comp = &(((EngineECSCompData *)&compRaw.data)->coll);
+    Collider compData;
+    Collider *const comp = &compData;
     Mesh tempMesh;
     *comp = initCollider();
     comp->type = COLLIDER_TYPE_CONVEX_HULL;
     comp->convexHull.indices = ind;
     comp->convexHull.vertices = vert;
     comp->convexHull.nVertices = nVert;
+    comp->convexHull.modelId = modelId;
 
     tempMesh.vertexCount = nVert;
     tempMesh.vertices = vert;
     comp->bounds = GetMeshBoundingBox(tempMesh);
 
-    if (ecs_registerComp(&engine->ecs, ent, type, compRaw) != ECS_RES_OK)
+    if (ecs_registerCompData(&engine->ecs, ent, type, comp) != ECS_RES_OK)
         return ENGINE_STATUS_REGISTER_FAILED;
-    ecs_setCallback(&engine->ecs, ent, type, ENGINE_CB_CREATE,
-                    engine_cbColliderOnCreate);
-    ecs_setCallback(&engine->ecs, ent, type, ENGINE_CB_DESTROY,
-                    engine_cbColliderOnDestroy);
     return ENGINE_STATUS_OK;
 }
 
+EngineStatus engine_createConvexHullCollider(Engine *engine, ECSEntityID ent,
+                                             unsigned short *ind, float *vert,
+                                             size_t nVert) {
+    return engine_registerConvexHull(engine, ent, ind, vert, nVert,
+                                     UINT32_MAX);
+}
+
 EngineStatus engine_createConvexHullColliderModel(Engine *engine,
                                                   ECSEntityID ent,
                                                   EngineRenderModelID id) {
@@ -768,8 +1434,8 @@ EngineStatus engine_createConvexHullColliderModel(Engine *engine,
         return ENGINE_STATUS_MODEL_NOT_FOUND;
     }
     Mesh *mesh = &mdl->meshes[0];
-    return engine_createConvexHullCollider(engine, ent, mesh->indices,
-                                           mesh->vertices, mesh->vertexCount);
+    return engine_registerConvexHull(engine, ent, mesh->indices,
+                                     mesh->vertices, mesh->vertexCount, id);
 }
 
 EngineCompInfo *engine_getInfo(Engine *const engine, const ECSEntityID ent) {
@@ -842,10 +1508,10 @@ Collider *engine_getCollider(Engine *engine, ECSEntityID ent) {
 Vector3 engine_meshRendererCenter(const ECS *ecs,
                                   const EngineCompMeshRenderer *const mr) {
     const BoundingBox *meshBB = &mr->boundingBox;
-    const ECSComponentID transformId =
-        ecs->entDesc[mr->transform].compIndex[ENGINE_COMP_TRANSFORM];
+    ECSComponentID transformId;
+    ecs_getCompID(ecs, mr->transform, ENGINE_COMP_TRANSFORM, &transformId);
     const EngineCompTransform *transform =
-        &((EngineECSCompData *)ecs->comp[transformId].data)->trans;
+        ecs_getCompDataByID(ecs, ENGINE_COMP_TRANSFORM, transformId);
     Vector3 meshBBCenter =
         (Vector3){transform->globalMatrix.m12, transform->globalMatrix.m13,
                   transform->globalMatrix.m14};
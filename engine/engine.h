@@ -3,6 +3,8 @@
 #include <lua.h>
 #define ENGINE_MAX_PENDING_MESSAGES 128
 #define ENGINE_MESSAGE_DATA_SIZE 64
+// Transform swaps per engine_stepUpdate to restore the hierarchy order
+#define ENGINE_SORT_SWAPS_PER_STEP 256
 
 #include <stdint.h>
 #include <stdio.h>
@@ -14,12 +16,16 @@
 
 #include "./dsa.h"
 #include "./ecs.h"
+#include "./jobs.h"
 #include "./logger.h"
 #include "./physcoll.h"
 
 typedef uint32_t EngineRenderModelID;
 typedef uint32_t EngineShaderID;
+// Entity type bits, stored as the ECS tags of the same index
 typedef uint32_t EngineEntType;
+// Tag of the entities with an Info component, right above the entity types
+#define ENGINE_TAG_INFO 32
 
 typedef struct Engine Engine;
 
@@ -44,10 +50,12 @@ typedef struct EngineMsg {
 
 // Components system
 typedef struct EngineCompInfo {
+    // Also stored as tags. Change it with engine_setEntityType.
     EngineEntType typeMask;
 } EngineCompInfo;
 
 typedef struct EngineCompTransform {
+    // Parent transform. Change it with engine_setTransformAnchor.
     ECSEntityID anchor;
 
     Vector3 pos;
@@ -55,9 +63,10 @@ typedef struct EngineCompTransform {
     Quaternion rot;
 
     uint8_t localUpdate;
-    uint8_t _globalUpdate;
     Matrix localMatrix;
     Matrix globalMatrix;
+    // Index in the transform hierarchy, ECS_INVALID_ID if left out
+    uint32_t _node;
 } EngineCompTransform;
 
 typedef struct EngineCompCamera {
@@ -76,6 +85,8 @@ typedef struct EngineCompMeshRenderer {
     EngineShaderID shaderId;
     RenderDistMode distanceMode;
     BoundingBox _boundingBoxTrans;
+    // ECS tick _boundingBoxTrans was computed at
+    uint32_t _boundingBoxTick;
 } EngineCompMeshRenderer;
 
 typedef enum EngineLightSrcTypeEnum {
@@ -101,6 +112,8 @@ typedef struct EngineCompLightSrc {
 typedef struct EngineCompScript {
     lua_State *state;
     char scriptName[64];
+    // Source file, run again when loading a snapshot. Empty if too long.
+    char scriptFile[128];
 } EngineCompScript;
 
 typedef struct EngineCallbackData {
@@ -152,6 +165,8 @@ typedef enum EngineECSCallbackTypeEnum {
     ENGINE_CB_POSTRENDER
 } EngineECSCallbackType;
 
+// Generic view of the engine components. Each type is stored with its own size
+// and alignment, so only the member matching the component type is valid.
 typedef union EngineECSCompData {
     EngineCompInfo info;
     EngineCompTransform trans;
@@ -163,20 +178,66 @@ typedef union EngineECSCompData {
     Collider coll;
 } EngineECSCompData;
 
+// Node of the transform hierarchy. Links are indices in the node array.
+typedef struct EngineTransformNode {
+    EngineCompTransform *trans;
+    ECSComponentID compId;
+    uint32_t parent; // ECS_INVALID_ID for roots
+    uint32_t firstChild;
+    uint32_t nextSibling;
+    uint32_t depth;
+    uint8_t changed; // Global matrix recomputed by the last pass
+} EngineTransformNode;
+
+// Memory order of the components of a type
+typedef enum EngineSortOrderEnum {
+    // By owner entity slot
+    ENGINE_SORT_ENTITY,
+    // By position of the owner's transform in the transform hierarchy, parents
+    // before their children
+    ENGINE_SORT_HIERARCHY,
+    // Along a Z-order curve through the owners' world positions
+    ENGINE_SORT_SPATIAL
+} EngineSortOrder;
+
+// Transforms linked by their anchors and sorted by depth, so that world
+// matrices are computed in one pass with parents before their children.
+// Rebuilt whenever anchors or transform component IDs change.
+typedef struct EngineTransformHierarchy {
+    EngineTransformNode *node;
+    size_t nNodes;
+    // Structural epoch of the transform pool at the last rebuild
+    uint32_t epoch;
+    // Capacity of node and scratch, grows geometrically
+    size_t cap;
+    // Parent, first child and next sibling by component ID, for rebuilding
+    uint32_t *scratch;
+    // Set when an anchor changed
+    uint8_t dirty;
+    // Structural epoch of the transform pool when it was last found sorted in
+    // hierarchy order
+    uint32_t sortedEpoch;
+} EngineTransformHierarchy;
+
 typedef struct Engine {
     float timescale;
     size_t nPendingMsg;
     EngineMsg pendingMsg[ENGINE_MAX_PENDING_MESSAGES];
     ECS ecs;
+    // Receivers of the broadcast message being dispatched
+    ECSEntityID *msgDst;
+    size_t msgDstCap;
+    JobPool jobs;      // Worker threads running the update systems
+    EngineTransformHierarchy transforms;
     PhysicsSystem phys;
     struct {
         Hashmap models;  // Model* values
         Hashmap shaders; // Shader* values
 
-        Array meshRend; // ComponentID (for Mesh Renderer) values
+        ECSQuery *meshRend; // Entities with a Mesh Renderer component
 
-        Array lightSrc;        // ComponentID (for light sources) values
-        ECSComponentID camera; // Camera component
+        U32Vec lightSrc;    // Light source EntityIDs, refreshed at sync points
+        ECSEntityID camera; // Entity owning the Camera component
     } render;
 
     float physDeltaTime;
@@ -194,7 +255,9 @@ typedef enum EngineStatusEnum {
     ENGINE_STATUS_MSG_DATA_SIZE_EXCEEDED,
     ENGINE_STATUS_MSG_SRC_NOT_FOUND,
     ENGINE_STATUS_MSG_DST_NOT_FOUND,
-    ENGINE_STATUS_SCRIPT_ERROR
+    ENGINE_STATUS_SCRIPT_ERROR,
+    ENGINE_STATUS_SNAPSHOT_FAILED,
+    ENGINE_STATUS_STATS_FAILED
 } EngineStatus;
 
 // clang-format off
@@ -208,21 +271,58 @@ const static char *EngineStatusStr[] = {
     "ENGINE_STATUS_MSG_PENDING_FULL",
     "ENGINE_STATUS_MSG_DATA_SIZE_EXCEEDED",
     "ENGINE_STATUS_MSG_SRC_NOT_FOUND",
-    "ENGINE_STATUS_MSG_DST_NOT_FOUND"
+    "ENGINE_STATUS_MSG_DST_NOT_FOUND",
+    "ENGINE_STATUS_SCRIPT_ERROR",
+    "ENGINE_STATUS_SNAPSHOT_FAILED",
+    "ENGINE_STATUS_STATS_FAILED"
 };
 // clang-format on
 
 // Initialize engine
 void engine_init(Engine *const engine);
+// Stop the worker threads and free the ECS and the engine's own buffers.
+// Entities are not destroyed, run engine_entityDestroy on them first.
+void engine_free(Engine *engine);
 
 /* General entity management */
 // Run component callbacks right after fully registering a entity to the ECS
 void engine_entityPostCreate(Engine *engine, ECSEntityID id);
 // Run destroy callback on the components and unregister their parent entity
 void engine_entityDestroy(Engine *engine, ECSEntityID id);
+// Destroy entity at the next sync point instead of right away. Safe to call
+// from component callbacks.
+void engine_entityDestroyDeferred(Engine *engine, ECSEntityID id);
+// Apply the deferred entity and component operations of the ECS command
+// buffers, then notify the component observers (e.g. the light source list).
+// Run at the end of engine_stepUpdate.
+void engine_flushCommands(Engine *engine);
+// Capture the components and per-instance callbacks of an entity built with
+// the engine_create* functions into a prefab, then unregister it. The entity
+// must not be post-created. Entities with a Script component can't be used.
+EngineStatus engine_createPrefab(Engine *engine, ECSPrefab *prefab,
+                                 ECSEntityID templateEnt);
+// Create count entities from a prefab and run their create callbacks in bulk
+EngineStatus engine_instantiatePrefab(Engine *engine, const ECSPrefab *prefab,
+                                      size_t count, ECSEntityID *idsOut);
+// Run destroy callback on the components and park their parent entity, to be
+// reused by the next engine_instantiatePrefab with the same component types
+void engine_entityPark(Engine *engine, ECSEntityID id);
+// Write the whole scene (ECS, camera and time scale) to a file. Convex hull
+// colliders are saved by model, and scripts by file. Fails on colliders made
+// from raw mesh data or heightmaps. Per-instance callbacks must be registered
+// with ecs_registerSnapshotCallback.
+EngineStatus engine_saveSnapshot(Engine *engine, const char *path);
+// Replace the scene with one saved by engine_saveSnapshot. The destroy
+// callbacks of the current entities are run first. Colliders are rebuilt from
+// the registered models and scripts are run again from their file, without
+// onCreate. The physics and light source registries are rebuilt from the
+// loaded components; pending messages and deferred commands are dropped.
+EngineStatus engine_loadSnapshot(Engine *engine, const char *path);
+// Write the ECS occupancy and memory statistics to a JSON file
+EngineStatus engine_dumpStats(Engine *engine, const char *path);
 // Dispatch all pending messages
 void engine_dispatchMessages(Engine *const engine);
-// Update scene
+// Update scene. Starts a new ECS change tick.
 void engine_stepUpdate(Engine *engine, float deltaTime);
 
 /* Graphics */
@@ -236,21 +336,12 @@ EngineStatus engine_render_addShader(Engine *engine, EngineShaderID id,
                                      const Shader *shader);
 // Get shader for input id. If id is invalid, it returns the default shader.
 Shader engine_render_getShader(Engine *engine, EngineShaderID id);
-// Register a Mesh Renderer component to the renderer
-/*EngineStatus engine_render_registerMeshRenderer(
-    Engine *engine, ECSEntityID id
-);
-// Unregister a Mesh Renderer component from the renderer
-EngineStatus engine_render_unregisterMeshRenderer(
-    Engine *engine, ECSEntityID id
-);*/
-// Register a Light Source component to the renderer
-EngineStatus engine_render_registerLightSrc(Engine *engine, ECSComponentID id);
-// Unregister a Light Source component from the renderer
-EngineStatus engine_render_unregisterLightSrc(Engine *engine,
-                                              ECSComponentID id);
-// Set Camera component which will be used for rendering the scene
-void engine_render_setCamera(Engine *engine, ECSComponentID id);
+// Register the Light Source component of an entity to the renderer
+EngineStatus engine_render_registerLightSrc(Engine *engine, ECSEntityID id);
+// Unregister the Light Source component of an entity from the renderer
+EngineStatus engine_render_unregisterLightSrc(Engine *engine, ECSEntityID id);
+// Set the entity whose Camera component will be used for rendering the scene
+void engine_render_setCamera(Engine *engine, ECSEntityID id);
 // Render scene
 void engine_stepRender(Engine *engine);
 
@@ -267,9 +358,20 @@ EngineStatus engine_entityBroadcastMsg(Engine *engine, ECSEntityID src,
 // Create and initialize Info component
 EngineStatus engine_createInfo(Engine *engine, ECSEntityID ent,
                                EngineEntType entTypeMask);
+// Change the type mask of the Info component of an entity, and its type tags
+EngineStatus engine_setEntityType(Engine *engine, ECSEntityID ent,
+                                  EngineEntType entTypeMask);
 // Create and initialize Transform component
 EngineStatus engine_createTransform(Engine *engine, ECSEntityID ent,
                                     ECSEntityID transformAnchor);
+// Attach the Transform of an entity to another one (ECS_INVALID_ID to detach
+// it)
+EngineStatus engine_setTransformAnchor(Engine *engine, ECSEntityID ent,
+                                       ECSEntityID anchor);
+// Reorder the components of a type in memory, in at most maxSwaps swaps (0 for
+// no limit). Returns the number of swaps, 0 once the pool is sorted.
+size_t engine_sortComponents(Engine *engine, uint32_t compType,
+                             EngineSortOrder order, size_t maxSwaps);
 // Create and initialize Camera component
 EngineStatus engine_createCamera(Engine *engine, ECSEntityID ent, float fov,
                                  int projection);
@@ -0,0 +1,167 @@
+#include "./jobs.h"
+#include "./logger.h"
+
+#include <unistd.h>
+
+static __thread size_t jobsThreadIndex = 0;
+
+// Pop the next queued job. Must be called with the lock held.
+static inline uint8_t jobs_pop(JobPool *const pool, Job *const job) {
+    if (pool->nQueued == 0)
+        return 0;
+    *job = pool->queue[pool->queueHead];
+    pool->queueHead = (pool->queueHead + 1) % pool->queueCap;
+    pool->nQueued--;
+    return 1;
+}
+
+// Mark a popped job as done. Must be called with the lock held.
+static inline void jobs_done(JobPool *const pool) {
+    if (--pool->nPending == 0)
+        pthread_cond_broadcast(&pool->jobsDone);
+}
+
+static void *jobs_worker(void *arg) {
+    JobPool *const pool = arg;
+    Job job;
+
+    pthread_mutex_lock(&pool->lock);
+    jobsThreadIndex = ++pool->nStarted;
+    while (1) {
+        while (!pool->stop && !jobs_pop(pool, &job))
+            pthread_cond_wait(&pool->jobAvail, &pool->lock);
+        if (pool->stop)
+            break;
+        pthread_mutex_unlock(&pool->lock);
+        job.func(job.arg);
+        pthread_mutex_lock(&pool->lock);
+        jobs_done(pool);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+uint8_t jobs_init(JobPool *const pool, const size_t nThreads) {
+    pool->nThreads = 0;
+    pool->nStarted = 0;
+    pool->threads = NULL;
+    pool->queue = NULL;
+    pool->queueCap = 0;
+    pool->queueHead = 0;
+    pool->nQueued = 0;
+    pool->nPending = 0;
+    pool->stop = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->jobAvail, NULL);
+    pthread_cond_init(&pool->jobsDone, NULL);
+    if (nThreads == 0)
+        return 1;
+
+    pool->threads = malloc(sizeof(pthread_t) * nThreads);
+    if (pool->threads == NULL) {
+        logMsg(LOG_LVL_ERR, "can't allocate %u worker threads", nThreads);
+        return 0;
+    }
+    for (; pool->nThreads < nThreads; pool->nThreads++) {
+        if (pthread_create(pool->threads + pool->nThreads, NULL, jobs_worker,
+                           pool)) {
+            logMsg(LOG_LVL_ERR, "can't start worker thread %u",
+                   pool->nThreads);
+            break;
+        }
+    }
+    if (pool->nThreads < nThreads) {
+        // Stop the workers already started, the pool stays usable from the
+        // calling thread alone
+        pthread_mutex_lock(&pool->lock);
+        pool->stop = 1;
+        pthread_cond_broadcast(&pool->jobAvail);
+        pthread_mutex_unlock(&pool->lock);
+        while (pool->nThreads)
+            pthread_join(pool->threads[--pool->nThreads], NULL);
+        free(pool->threads);
+        pool->threads = NULL;
+        pool->nStarted = 0;
+        pool->stop = 0;
+        return 0;
+    }
+    logMsg(LOG_LVL_INFO, "started %u worker threads", pool->nThreads);
+    return 1;
+}
+
+void jobs_free(JobPool *const pool) {
+    size_t i;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    pthread_cond_broadcast(&pool->jobAvail);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < pool->nThreads; i++)
+        pthread_join(pool->threads[i], NULL);
+    free(pool->threads);
+    free(pool->queue);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->jobAvail);
+    pthread_cond_destroy(&pool->jobsDone);
+    pool->threads = NULL;
+    pool->queue = NULL;
+    pool->nThreads = 0;
+    pool->queueCap = 0;
+    pool->nQueued = 0;
+    pool->nPending = 0;
+}
+
+// Double the queue capacity, unwrapping the ring buffer
+static uint8_t jobs_grow(JobPool *const pool) {
+    const size_t cap = pool->queueCap ? pool->queueCap * 2 : 64;
+    Job *const queue = malloc(sizeof(Job) * cap);
+    size_t i;
+
+    if (queue == NULL)
+        return 0;
+    for (i = 0; i < pool->nQueued; i++)
+        queue[i] = pool->queue[(pool->queueHead + i) % pool->queueCap];
+    free(pool->queue);
+    pool->queue = queue;
+    pool->queueCap = cap;
+    pool->queueHead = 0;
+    return 1;
+}
+
+uint8_t jobs_push(JobPool *const pool, JobFunc func, void *arg) {
+    pthread_mutex_lock(&pool->lock);
+    if (pool->nQueued == pool->queueCap && !jobs_grow(pool)) {
+        pthread_mutex_unlock(&pool->lock);
+        logMsg(LOG_LVL_ERR, "can't grow job queue");
+        return 0;
+    }
+    pool->queue[(pool->queueHead + pool->nQueued) % pool->queueCap] =
+        (Job){func, arg};
+    pool->nQueued++;
+    pool->nPending++;
+    pthread_cond_signal(&pool->jobAvail);
+    pthread_mutex_unlock(&pool->lock);
+    return 1;
+}
+
+void jobs_wait(JobPool *const pool) {
+    Job job;
+
+    pthread_mutex_lock(&pool->lock);
+    while (jobs_pop(pool, &job)) {
+        pthread_mutex_unlock(&pool->lock);
+        job.func(job.arg);
+        pthread_mutex_lock(&pool->lock);
+        jobs_done(pool);
+    }
+    while (pool->nPending)
+        pthread_cond_wait(&pool->jobsDone, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+size_t jobs_threadIndex(void) { return jobsThreadIndex; }
+
+size_t jobs_cpuCount(void) {
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? n : 1;
+}
\ No newline at end of file
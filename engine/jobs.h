@@ -0,0 +1,50 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef void (*JobFunc)(void *arg);
+
+typedef struct Job {
+    JobFunc func;
+    void *arg;
+} Job;
+
+// Fixed set of worker threads consuming a shared job queue
+typedef struct JobPool {
+    size_t nThreads;
+    // Workers that already got their thread index
+    size_t nStarted;
+    pthread_t *threads;
+    pthread_mutex_t lock;
+    // Signaled when jobs are pushed or the pool is stopped
+    pthread_cond_t jobAvail;
+    // Signaled when the last pending job is done
+    pthread_cond_t jobsDone;
+    // Ring buffer of queued jobs, grows geometrically
+    Job *queue;
+    size_t queueCap;
+    size_t queueHead;
+    size_t nQueued;
+    // Queued and running jobs count
+    size_t nPending;
+    uint8_t stop;
+} JobPool;
+
+// Start nThreads worker threads. With 0 threads, jobs only run inside
+// jobs_wait on the calling thread. Returns 0 if not all of them could be
+// started, the pool is then left without workers but must still be freed.
+uint8_t jobs_init(JobPool *pool, size_t nThreads);
+// Stop the worker threads and free the pool. Queued jobs are discarded.
+void jobs_free(JobPool *pool);
+// Queue a job. Returns 0 if the queue can't grow.
+uint8_t jobs_push(JobPool *pool, JobFunc func, void *arg);
+// Run queued jobs on the calling thread too, and return once all of them are
+// done
+void jobs_wait(JobPool *pool);
+// Index of the calling thread: 1 to nThreads for the workers of a pool, 0 for
+// any other thread
+size_t jobs_threadIndex(void);
+// Number of available CPU cores
+size_t jobs_cpuCount(void);
\ No newline at end of file
@@ -2,7 +2,7 @@
 
 static LogStyle g_logStyle = LOG_STYLE_COLOR;
 static LogLevel g_logThres = LOG_LVL_DEBUG;
-static Hashmap g_headerThresLevels = {0, 0, NULL};
+static Hashmap g_headerThresLevels = {0, 0, NULL, 0, NULL};
 static Array g_tags = {0, 0, NULL};
 
 void logSetLogStyle(const LogStyle style) { g_logStyle = style; }
@@ -22,6 +22,7 @@ static void *luaAlloc(void *ud, void *ptr, size_t osize, size_t nsize) {
 }
 
 static Quaternion luaGetQuaternion(lua_State *L, int tableIndex);
+static void luaEnvSetupSnapshots(lua_State *L);
 
 static inline float getTableFloat(lua_State *L, int idx, const char *name) {
     lua_pushstring(L, name);
@@ -1006,7 +1007,7 @@ static int luaEngineComponentNewIndex(lua_State *L) {
     switch (compType) {
     case ENGINE_COMP_INFO:
         if (strcmp(key, "typeMask") == 0)
-            dat->info.typeMask = lua_tointeger(L, -1);
+            engine_setEntityType(engine, entityId, lua_tointeger(L, -1));
         else
             isTableEntry = 1;
         break;
@@ -1045,9 +1046,13 @@ static int luaEngineComponentNewIndex(lua_State *L) {
             isTableEntry = 1;
         break;
     case ENGINE_COMP_TRANSFORM:
-        if (strcmp(key, "anchor") == 0)
-            dat->trans.anchor = lua_tointeger(L, -1);
-        else if (strcmp(key, "pos") == 0)
+        if (strcmp(key, "anchor") == 0) {
+            if (engine_setTransformAnchor(engine, entityId,
+                                          lua_tointeger(L, -1)) !=
+                ENGINE_STATUS_OK)
+                return luaL_error(L, "entity %u can't be anchored to %u",
+                                  entityId, (ECSEntityID)lua_tointeger(L, -1));
+        } else if (strcmp(key, "pos") == 0)
             dat->trans.pos = luaGetVector3(L, -1);
         else if (strcmp(key, "scale") == 0)
             dat->trans.scale = luaGetVector3(L, -1);
@@ -1133,6 +1138,8 @@ static int luaEngineComponentNewIndex(lua_State *L) {
 
     if (isTableEntry)
         lua_rawset(L, -3);
+    else
+        ecs_markChanged(&engine->ecs, entityId, compType);
     return 0;
 }
 
@@ -1142,10 +1149,8 @@ static int luaCreateComponentTable(lua_State *L, ECSEntityID id,
         "info",         "rigidbody",   "transform", "camera",
         "meshrenderer", "lightsource", "collider"};
 
-    ECSComponent *comp;
-
     logPushTag("lua");
-    ECSStatus res = ecs_getComp(&engine->ecs, id, compType, &comp);
+    ECSStatus res = ecs_compExists(&engine->ecs, id, compType);
     logPopTag();
     if (res != ECS_RES_OK)
         return 0;
@@ -1470,8 +1475,6 @@ static int luaFuncCreateMeshCollider(lua_State *L) {
 }
 
 static int luaCreateEntityTable(lua_State *L, ECSEntityID id) {
-    ECSComponent *comp;
-
     ECSStatus res = ecs_entityExists(&engine->ecs, id);
     if (res != ECS_RES_OK)
         return luaL_error(L, "entity id %d not found", id);
@@ -1591,7 +1594,8 @@ static int luaFuncDestroyEntity(lua_State *L) {
 
     ECSEntityID id = (uint32_t)getTableInteger(L, -2, "id");
     logPushTag("lua");
-    engine_entityDestroy(engine, id);
+    // Scripts run inside ECS callbacks, so the entity can't go away yet
+    engine_entityDestroyDeferred(engine, id);
     logPopTag();
     return 0;
 }
@@ -1616,11 +1620,9 @@ static int luaFuncSetCamera(lua_State *L) {
         return luaL_error(L, "expected entity table");
 
     ECSEntityID entId = (uint32_t)getTableInteger(L, -2, "entityId");
-    ECSComponentID camId;
     logPushTag("lua");
-    if (ecs_getCompID(&engine->ecs, entId, ENGINE_COMP_CAMERA, &camId) ==
-        ECS_RES_OK)
-        engine_render_setCamera(engine, camId);
+    if (ecs_compExists(&engine->ecs, entId, ENGINE_COMP_CAMERA) == ECS_RES_OK)
+        engine_render_setCamera(engine, entId);
     logPopTag();
     return 0;
 }
@@ -1875,6 +1877,7 @@ lua_State *luaEnvCreate(struct nk_context *nk) {
     lua_State *L = lua_newstate(luaAlloc, NULL);
     luaL_openlibs(L);
     luaEnvSetupBindings(L, nk);
+    luaEnvSetupSnapshots(L);
     return L;
 }
 
@@ -1935,8 +1938,7 @@ void luaEnvUpdate(lua_State *L) {
 
 static void engineCbScriptOnCreate(uint32_t cbType, ECSEntityID entId,
                                    ECSComponentID compId, uint32_t compType,
-                                   struct ECSComponent *comp,
-                                   void *cbUserData) {
+                                   void *compData, void *cbUserData) {
     if (engine == NULL)
         logMsg(LOG_LVL_FATAL, "engine is NULL");
 
@@ -1975,8 +1977,7 @@ static void engineCbScriptOnCreate(uint32_t cbType, ECSEntityID entId,
 
 static void engineCbScriptOnDestroy(uint32_t cbType, ECSEntityID entId,
                                     ECSComponentID compId, uint32_t compType,
-                                    struct ECSComponent *comp,
-                                    void *cbUserData) {
+                                    void *compData, void *cbUserData) {
     if (engine == NULL)
         logMsg(LOG_LVL_FATAL, "engine is NULL");
 
@@ -2007,8 +2008,7 @@ static void engineCbScriptOnDestroy(uint32_t cbType, ECSEntityID entId,
 
 static void engineCbScriptOnUpdate(uint32_t cbType, ECSEntityID entId,
                                    ECSComponentID compId, uint32_t compType,
-                                   struct ECSComponent *comp,
-                                   void *cbUserData) {
+                                   void *compData, void *cbUserData) {
     if (engine == NULL)
         logMsg(LOG_LVL_FATAL, "engine is NULL");
 
@@ -2041,8 +2041,7 @@ static void engineCbScriptOnUpdate(uint32_t cbType, ECSEntityID entId,
 
 static void engineCbScriptOnMessage(uint32_t cbType, ECSEntityID entId,
                                     ECSComponentID compId, uint32_t compType,
-                                    struct ECSComponent *comp,
-                                    void *cbUserData) {
+                                    void *compData, void *cbUserData) {
     if (engine == NULL)
         logMsg(LOG_LVL_FATAL, "engine is NULL");
 
@@ -2082,24 +2081,14 @@ static void engineCbScriptOnMessage(uint32_t cbType, ECSEntityID entId,
         lua_pop(L, 4);
 }
 
-EngineStatus engine_createScriptFromFile(Engine *engine, lua_State *L,
-                                         ECSEntityID ent,
-                                         const char *scriptFile) {
-    if (engine == NULL)
-        logMsg(LOG_LVL_FATAL, "engine is NULL");
-
-    const EngineECSCompType type = ENGINE_COMP_SCRIPT;
-    ECSComponent compRaw;
-    EngineCompScript *const comp =
-        &(((EngineECSCompData *)&compRaw.data)->script);
-
-    if (!luaEnvLoad(L, scriptFile, comp->scriptName))
-        return ENGINE_STATUS_SCRIPT_ERROR;
-
-    comp->state = L;
+// Load a script in a new environment and run it
+static uint8_t luaEnvRunScript(lua_State *L, const char *scriptFile,
+                               char *scriptName) {
+    if (!luaEnvLoad(L, scriptFile, scriptName))
+        return 0;
     // script chunk is now at top
 
-    lua_getfield(L, LUA_REGISTRYINDEX, comp->scriptName);
+    lua_getfield(L, LUA_REGISTRYINDEX, scriptName);
     lua_newtable(L);
     lua_pushnil(L);
     lua_setfield(L, -2, "onCreate");
@@ -2113,12 +2102,31 @@ EngineStatus engine_createScriptFromFile(Engine *engine, lua_State *L,
     if (lua_pcall(L, 0, LUA_MULTRET, 0) != LUA_OK) {
         logMsg(LOG_LVL_FATAL, "script load error: %s", lua_tostring(L, -1));
         lua_pop(L, 2);
-        return ENGINE_STATUS_SCRIPT_ERROR;
+        return 0;
     }
 
     lua_pop(L, 1);
+    return 1;
+}
+
+EngineStatus engine_createScriptFromFile(Engine *engine, lua_State *L,
+                                         ECSEntityID ent,
+                                         const char *scriptFile) {
+    if (engine == NULL)
+        logMsg(LOG_LVL_FATAL, "engine is NULL");
 
-    if (ecs_registerComp(&engine->ecs, ent, type, compRaw) != ECS_RES_OK) {
+    const EngineECSCompType type = ENGINE_COMP_SCRIPT;
+    EngineCompScript compData;
+    EngineCompScript *const comp = &compData;
+
+    if (!luaEnvRunScript(L, scriptFile, comp->scriptName))
+        return ENGINE_STATUS_SCRIPT_ERROR;
+    comp->state = L;
+    comp->scriptFile[0] = '\0';
+    if (strlen(scriptFile) < sizeof(comp->scriptFile))
+        strcpy(comp->scriptFile, scriptFile);
+
+    if (ecs_registerCompData(&engine->ecs, ent, type, comp) != ECS_RES_OK) {
         lua_close(L);
         return ENGINE_STATUS_REGISTER_FAILED;
     }
@@ -2135,6 +2143,48 @@ EngineStatus engine_createScriptFromFile(Engine *engine, lua_State *L,
     return ENGINE_STATUS_OK;
 }
 
+// Scripts are saved by file, the Lua state doesn't outlive the program
+static ECSStatus luaEnvSnapSaveScript(ECSEntityID entId, uint32_t compType,
+                                      void *compData, void *userData) {
+    EngineCompScript *const script = compData;
+
+    script->state = NULL;
+    if (script->scriptFile[0] == '\0') {
+        logMsg(LOG_LVL_ERR, "script of entity %u has no file", entId);
+        return ECS_RES_INVALID_PARAMS;
+    }
+    return ECS_RES_OK;
+}
+
+// Run the script again in a new environment. Without it, the callbacks of the
+// component are removed.
+static ECSStatus luaEnvSnapLoadScript(ECSEntityID entId, uint32_t compType,
+                                      void *compData, void *userData) {
+    EngineCompScript *const script = compData;
+
+    script->state = NULL;
+    if (!luaEnvRunScript(userData, script->scriptFile, script->scriptName)) {
+        logMsg(LOG_LVL_ERR, "can't run script %s of entity %u again",
+               script->scriptFile, entId);
+        for (uint32_t cbType = 0; cbType < ECS_COMPONENT_CALLBACK_TYPES;
+             cbType++)
+            ecs_setCallback(&engine->ecs, entId, compType, cbType, NULL);
+        return ECS_RES_INVALID_PARAMS;
+    }
+    script->state = userData;
+    return ECS_RES_OK;
+}
+
+// Let snapshots store the script callbacks and rebuild the scripts
+static void luaEnvSetupSnapshots(lua_State *L) {
+    ecs_setCompSnapshotHooks(&engine->ecs, ENGINE_COMP_SCRIPT,
+                             luaEnvSnapSaveScript, luaEnvSnapLoadScript, L);
+    ecs_registerSnapshotCallback(&engine->ecs, engineCbScriptOnCreate);
+    ecs_registerSnapshotCallback(&engine->ecs, engineCbScriptOnDestroy);
+    ecs_registerSnapshotCallback(&engine->ecs, engineCbScriptOnUpdate);
+    ecs_registerSnapshotCallback(&engine->ecs, engineCbScriptOnMessage);
+}
+
 EngineCompScript *engine_getScript(Engine *const engine,
                                    const ECSEntityID ent) {
     EngineECSCompData *data;
@@ -245,6 +245,21 @@ Vector3 Vector3SetLength(Vector3 vec, float length) {
     return Vector3Scale(Vector3Normalize(vec), length);
 }
 
+// Spread the low 21 bits of v so that two zero bits follow each of them
+static uint64_t MortonSpread3(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffff;
+    v = (v | v << 16) & 0x1f0000ff0000ff;
+    v = (v | v << 8) & 0x100f00f00f00f00f;
+    v = (v | v << 4) & 0x10c30c30c30c30c3;
+    v = (v | v << 2) & 0x1249249249249249;
+    return v;
+}
+
+uint64_t MortonCode3(uint32_t x, uint32_t y, uint32_t z) {
+    return MortonSpread3(x) | MortonSpread3(y) << 1 | MortonSpread3(z) << 2;
+}
+
 Matrix GetProjectionMatrix(Camera cam, float aspect, uint8_t zInvert) {
     Matrix proj = MatrixIdentity();
 
@@ -38,6 +38,8 @@ float DistanceFromPlane(Plane plane, Vector3 in);
 Vector3 ProjectPointOntoPlane(Plane plane, Vector3 point);
 
 Vector3 Vector3SetLength(Vector3 vec, float length);
+// Interleave the low 21 bits of x, y and z into a 63-bit Z-order curve index
+uint64_t MortonCode3(uint32_t x, uint32_t y, uint32_t z);
 
 Matrix GetProjectionMatrix(Camera cam, float aspect, uint8_t zInvert);
 Matrix GetViewMatrix(Camera cam);
\ No newline at end of file
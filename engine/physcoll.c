@@ -13,7 +13,8 @@ Collider initCollider() {
     coll.enabled = 1;
     coll.collMask = 0;
     coll.collTargetMask = 0;
-    coll.contacts = malloc(COLLIDER_MAX_CONTACTS * sizeof(*coll.contacts));
+    // Allocated when the collider is added to the physics system
+    coll.contacts = NULL;
     coll.nContacts = 0;
     coll.type = COLLIDER_TOTAL_TYPES;
     coll.localTransform = MatrixIdentity();
@@ -49,8 +50,7 @@ RigidBody physics_initRigidBody(float mass) {
 
 PhysicsSystem physics_initSystem() {
     PhysicsSystem sys;
-    sys.collEnt = hashmap_init();
-    sys.rigidBodies = hashmap_init();
+    sys.rec = (PhysicsRecords){0, 0, NULL, NULL, NULL, hashmap_init()};
     sys.nContacts = 0;
     // sys.nContactsBroad = 0;
     sys.correction.penetrationOffset = 0.005f; // 0.0002f;
@@ -63,35 +63,143 @@ PhysicsSystem physics_initSystem() {
     return sys;
 }
 
+static uint8_t physics_recordsGrow(PhysicsRecords *rec) {
+    const size_t cap = rec->cap ? rec->cap * 2 : 64;
+    uint32_t *ids;
+    ColliderEntity *collEnt;
+    RigidBody **rb;
+
+    if ((ids = realloc(rec->ids, cap * sizeof(*ids))) == NULL)
+        return 0;
+    rec->ids = ids;
+    if ((collEnt = realloc(rec->collEnt, cap * sizeof(*collEnt))) == NULL)
+        return 0;
+    rec->collEnt = collEnt;
+    if ((rb = realloc(rec->rb, cap * sizeof(*rb))) == NULL)
+        return 0;
+    rec->rb = rb;
+    rec->cap = cap;
+    return 1;
+}
+
+// Record of an entity, appended if it has none yet. Returns UINT32_MAX if the
+// records can't grow.
+static uint32_t physics_recordAdd(PhysicsSystem *sys, uint32_t id) {
+    PhysicsRecords *const rec = &sys->rec;
+    uint32_t r;
+    if (hashmap_getU32(&rec->index, id, &r))
+        return r;
+    if (rec->n == rec->cap && !physics_recordsGrow(rec)) {
+        logMsg(LOG_LVL_ERR, "can't grow physics records");
+        return UINT32_MAX;
+    }
+    r = rec->n;
+    if (!hashmap_set(&rec->index, id, (HashmapVal){r})) {
+        logMsg(LOG_LVL_ERR, "can't index physics record for id %u", id);
+        return UINT32_MAX;
+    }
+    rec->ids[r] = id;
+    rec->collEnt[r].coll = NULL;
+    rec->rb[r] = NULL;
+    rec->n++;
+    return r;
+}
+
+// Remove a record once it holds neither a collider nor a rigid body
+static void physics_recordRelease(PhysicsSystem *sys, uint32_t r) {
+    PhysicsRecords *const rec = &sys->rec;
+    const uint32_t last = rec->n - 1;
+    if (rec->collEnt[r].coll || rec->rb[r])
+        return;
+    hashmap_del(&rec->index, rec->ids[r], 0);
+    if (r != last) {
+        rec->ids[r] = rec->ids[last];
+        rec->collEnt[r] = rec->collEnt[last];
+        rec->rb[r] = rec->rb[last];
+        hashmap_set(&rec->index, rec->ids[r], (HashmapVal){r});
+    }
+    rec->n--;
+}
+
 void physics_addCollider(PhysicsSystem *sys, uint32_t id, Collider *coll,
                          Matrix *transform) {
-    ColliderEntity *ent = malloc(sizeof(*ent));
+    const uint32_t r = physics_recordAdd(sys, id);
+    ColliderEntity *ent;
+    if (r == UINT32_MAX)
+        return;
+    ent = sys->rec.collEnt + r;
+    if (ent->coll)
+        free(ent->coll->contacts);
+    coll->contacts = malloc(COLLIDER_MAX_CONTACTS * sizeof(*coll->contacts));
+    coll->nContacts = 0;
     ent->coll = coll;
     ent->transform = transform;
     ent->transformInverse = MatrixIdentity();
-    hashmap_set(&sys->collEnt, id, (HashmapVal)(void *)ent);
 
     logMsg(LOG_LVL_DEBUG, "added collider id %u to physics system", id);
 }
 
 void physics_addRigidBody(PhysicsSystem *sys, uint32_t id, RigidBody *rb) {
-    hashmap_set(&sys->rigidBodies, id, (HashmapVal)(void *)rb);
+    const uint32_t r = physics_recordAdd(sys, id);
+    if (r == UINT32_MAX)
+        return;
+    sys->rec.rb[r] = rb;
     logMsg(LOG_LVL_DEBUG, "added rigidbody id %u to physics system", id);
 }
 
 void physics_removeCollider(PhysicsSystem *sys, uint32_t id) {
     ColliderEntity *ent;
-    if (!hashmap_getP(&sys->collEnt, id, (void **)&ent)) {
+    uint32_t r;
+    if (!hashmap_getU32(&sys->rec.index, id, &r) ||
+        sys->rec.collEnt[r].coll == NULL) {
         logMsg(LOG_LVL_ERR, "collider id %u not found in physics system", id);
         return;
     }
-    free(ent);
-    hashmap_del(&sys->collEnt, id, 0);
+    ent = sys->rec.collEnt + r;
+    free(ent->coll->contacts);
+    ent->coll->contacts = NULL;
+    ent->coll = NULL;
+    physics_recordRelease(sys, r);
     logMsg(LOG_LVL_DEBUG, "removed collider id %u from physics system", id);
 }
 
 void physics_removeRigidBody(PhysicsSystem *sys, uint32_t id) {
-    hashmap_del(&sys->rigidBodies, id, 0);
+    uint32_t r;
+    if (!hashmap_getU32(&sys->rec.index, id, &r))
+        return;
+    sys->rec.rb[r] = NULL;
+    physics_recordRelease(sys, r);
+}
+
+void physics_clear(PhysicsSystem *sys) {
+    ColliderEntity *ent;
+    for (size_t i = 0; i < sys->rec.n; i++) {
+        ent = sys->rec.collEnt + i;
+        if (ent->coll == NULL)
+            continue;
+        free(ent->coll->contacts);
+        ent->coll->contacts = NULL;
+    }
+    sys->rec.n = 0;
+    hashmap_clear(&sys->rec.index);
+    sys->nContacts = 0;
+}
+
+void physics_relocateCollider(PhysicsSystem *sys, uint32_t id, Collider *coll,
+                              Matrix *transform) {
+    uint32_t r;
+    if (!hashmap_getU32(&sys->rec.index, id, &r) ||
+        sys->rec.collEnt[r].coll == NULL)
+        return;
+    sys->rec.collEnt[r].coll = coll;
+    sys->rec.collEnt[r].transform = transform;
+}
+
+void physics_relocateRigidBody(PhysicsSystem *sys, uint32_t id, RigidBody *rb) {
+    uint32_t r;
+    if (!hashmap_getU32(&sys->rec.index, id, &r) || sys->rec.rb[r] == NULL)
+        return;
+    sys->rec.rb[r] = rb;
 }
 
 void physics_setPosition(RigidBody *rb, Vector3 pos) { rb->pos = pos; }
@@ -213,20 +321,26 @@ static void physics_collisionBroadPhase(PhysicsSystem *sys) {
     BoundingBox bbA, bbB;
     uint32_t maskA, maskB;
 
-    for (size_t i = 0; i < sys->collEnt.nEntries; i++) {
-        entA = (const ColliderEntity *)sys->collEnt.entries[i].val.ptr;
+    for (size_t i = 0; i < sys->rec.n; i++) {
+        entA = sys->rec.collEnt + i;
+        if (entA->coll == NULL)
+            continue;
         entA->coll->_boundsTransformed = BoxTransform(
             entA->coll->bounds,
             MatrixMultiply(entA->coll->localTransform, *entA->transform));
     }
 
     sys->nContactsBroad = 0;
-    for (size_t i = 0; i < sys->collEnt.nEntries; i++) {
-        entA = (const ColliderEntity *)sys->collEnt.entries[i].val.ptr;
+    for (size_t i = 0; i < sys->rec.n; i++) {
+        entA = sys->rec.collEnt + i;
+        if (entA->coll == NULL)
+            continue;
         bbA = entA->coll->_boundsTransformed;
 
-        for (size_t j = i + 1; j < sys->collEnt.nEntries; j++) {
-            entB = (const ColliderEntity *)sys->collEnt.entries[j].val.ptr;
+        for (size_t j = i + 1; j < sys->rec.n; j++) {
+            entB = sys->rec.collEnt + j;
+            if (entB->coll == NULL)
+                continue;
             bbB = entB->coll->_boundsTransformed;
             maskA = entA->coll->collTargetMask;
             maskB = entB->coll->collMask;
@@ -466,8 +580,10 @@ static void physics_collisionNarrowPhase(PhysicsSystem *sys) {
     Vector3 nor, locA, locB;
     int idxA, idxB;
 
-    for (size_t i = 0; i < sys->collEnt.nEntries; i++) {
-        entA = (ColliderEntity *)sys->collEnt.entries[i].val.ptr;
+    for (size_t i = 0; i < sys->rec.n; i++) {
+        entA = sys->rec.collEnt + i;
+        if (entA->coll == NULL)
+            continue;
         // collA = entA->coll;
         entA->coll->nContacts = 0;
         entA->transformInverse = MatrixInvert(
@@ -478,17 +594,17 @@ static void physics_collisionNarrowPhase(PhysicsSystem *sys) {
     for (size_t i = 0; i < sys->nContactsBroad; i++) {
         idxA = sys->contactsBroad[i].posA;
         idxB = sys->contactsBroad[i].posB;
-        entA = sys->collEnt.entries[idxA].val.ptr;
-        entB = sys->collEnt.entries[idxB].val.ptr;
+        entA = sys->rec.collEnt + idxA;
+        entB = sys->rec.collEnt + idxB;
 
         if (entA->coll->type >= COLLIDER_TOTAL_TYPES) {
             logMsg(LOG_LVL_ERR, "invalid collider type for id %u: %u",
-                   sys->collEnt.entries[idxA].key, entA->coll->type);
+                   sys->rec.ids[idxA], entA->coll->type);
             continue;
         }
         if (entB->coll->type >= COLLIDER_TOTAL_TYPES) {
             logMsg(LOG_LVL_ERR, "invalid collider type for id %u: %u",
-                   sys->collEnt.entries[idxB].key, entB->coll->type);
+                   sys->rec.ids[idxB], entB->coll->type);
             continue;
         }
         // uint8_t collRes = gjk(&gjkMeshA, &gjkMeshB, &nor, &locA, &locB);
@@ -525,8 +641,8 @@ static void physics_collisionNarrowPhase(PhysicsSystem *sys) {
                 logMsg(LOG_LVL_ERR, "too many collisions in system");
 
             if (entA->coll->nContacts < COLLIDER_MAX_CONTACTS) {
-                cont.sourceId = sys->collEnt.entries[idxA].key;
-                cont.targetId = sys->collEnt.entries[idxB].key;
+                cont.sourceId = sys->rec.ids[idxA];
+                cont.targetId = sys->rec.ids[idxB];
                 cont.pointA = locA;
                 cont.pointB = locB;
                 entA->coll->contacts[entA->coll->nContacts++] = cont;
@@ -537,8 +653,8 @@ static void physics_collisionNarrowPhase(PhysicsSystem *sys) {
                 );*/
             }
             if (entB->coll->nContacts < COLLIDER_MAX_CONTACTS) {
-                cont.sourceId = sys->collEnt.entries[idxB].key;
-                cont.targetId = sys->collEnt.entries[idxA].key;
+                cont.sourceId = sys->rec.ids[idxB];
+                cont.targetId = sys->rec.ids[idxA];
                 cont.normal = Vector3Scale(cont.normal, -1);
                 cont.pointA = locB;
                 cont.pointB = locA;
@@ -563,8 +679,10 @@ void physics_raycast(PhysicsSystem *sys, Ray ray, float maxDist,
     Mesh tempMesh;
 
     *nCont = 0;
-    for (size_t i = 0; i < sys->collEnt.nEntries && *nCont < maxCont; i++) {
-        ent = (const ColliderEntity *)sys->collEnt.entries[i].val.ptr;
+    for (size_t i = 0; i < sys->rec.n && *nCont < maxCont; i++) {
+        ent = sys->rec.collEnt + i;
+        if (ent->coll == NULL)
+            continue;
         if ((mask & ent->coll->collMask) != mask)
             continue;
 
@@ -586,7 +704,7 @@ void physics_raycast(PhysicsSystem *sys, Ray ray, float maxDist,
                 break;
             }
             if (collRes.hit) {
-                currContact.id = sys->collEnt.entries[i].key;
+                currContact.id = sys->rec.ids[i];
                 currContact.normal = collRes.normal;
                 currContact.dist = collRes.distance;
                 cont[(*nCont)++] = currContact;
@@ -605,10 +723,13 @@ void physics_updateBodies(PhysicsSystem *sys, float dt) {
     ColliderEntity *collA, *collB;
 
     for (size_t i = 0; i < sys->nContacts; i++) {
-        rbA = sys->rigidBodies.entries[sys->contacts[i].posA].val.ptr;
-        rbB = sys->rigidBodies.entries[sys->contacts[i].posB].val.ptr;
-        collA = sys->collEnt.entries[sys->contacts[i].posA].val.ptr;
-        collB = sys->collEnt.entries[sys->contacts[i].posB].val.ptr;
+        rbA = sys->rec.rb[sys->contacts[i].posA];
+        rbB = sys->rec.rb[sys->contacts[i].posB];
+        // Static colliders without a body don't respond to contacts
+        if (rbA == NULL || rbB == NULL)
+            continue;
+        collA = sys->rec.collEnt + sys->contacts[i].posA;
+        collB = sys->rec.collEnt + sys->contacts[i].posB;
 
         Vector3 posA =
             Vector3Add(rbA->pos, Vector3RotateByQuaternion(rbA->cog, rbA->rot));
@@ -701,8 +822,6 @@ void physics_updateBodies(PhysicsSystem *sys, float dt) {
         }
 
         uint8_t isWheel = 0;
-        uint32_t entA = sys->rigidBodies.entries[sys->contacts[i].posA].key;
-        uint32_t entB = sys->rigidBodies.entries[sys->contacts[i].posB].key;
 
         physics_applyImpulseAt(rbA, Vector3Scale(fImpulse, -1.f), relPosA);
         physics_applyImpulseAt(rbB, Vector3Scale(fImpulse, 1.f), relPosB);
@@ -713,8 +832,10 @@ void physics_updateBodies(PhysicsSystem *sys, float dt) {
         physics_applyImpulseAt(rbB, Vector3Scale(imp, 1.f), relPosB);
     }
 
-    for (size_t i = 0; i < sys->rigidBodies.nEntries; i++) {
-        rbA = (RigidBody *)sys->rigidBodies.entries[i].val.ptr;
+    for (size_t i = 0; i < sys->rec.n; i++) {
+        rbA = sys->rec.rb[i];
+        if (rbA == NULL)
+            continue;
         physics_bodyUpdate(sys, rbA, dt);
     }
 }
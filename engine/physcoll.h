@@ -16,6 +16,7 @@ typedef struct ColliderMesh {
     float *vertices;  // set of (X, Y, Z) coordinates
     size_t nVertices; // number of coordinates (vertices size = nVertices * 3)
     unsigned short *indices; // only used in raycasting to define mesh triangles
+    uint32_t modelId; // source model, UINT32_MAX if given as raw data
 } ColliderMesh;
 
 typedef struct ColliderSphere {
@@ -107,10 +108,21 @@ typedef struct Joint {
     JointType type;
 } Joint;
 
+// Colliders and rigid bodies of the world, one record per entity stored in
+// parallel dense arrays. Removing a record moves the last one into the hole
+// and remaps its id in the index.
+typedef struct PhysicsRecords {
+    size_t n;
+    size_t cap;
+    uint32_t *ids;
+    ColliderEntity *collEnt; // coll is NULL without a collider
+    RigidBody **rb;          // NULL without a rigid body
+    Hashmap index;           // entity id -> record
+} PhysicsRecords;
+
 typedef struct PhysicsSystem {
-    // A body's Collider and PhysicsSystemEntity share the same index
-    Hashmap collEnt;     // ColliderEntity*
-    Hashmap rigidBodies; // PhysicsRigidBody*
+    // Contacts index records
+    PhysicsRecords rec;
 
     struct {
         int posA, posB;
@@ -148,6 +160,13 @@ void physics_addCollider(PhysicsSystem *sys, uint32_t id, Collider *coll,
 void physics_addRigidBody(PhysicsSystem *sys, uint32_t id, RigidBody *rb);
 void physics_removeCollider(PhysicsSystem *sys, uint32_t id);
 void physics_removeRigidBody(PhysicsSystem *sys, uint32_t id);
+// Remove all the colliders and rigid bodies
+void physics_clear(PhysicsSystem *sys);
+// Update the stored pointers of an already added collider/rigid body after its
+// data was moved. Unknown IDs are ignored.
+void physics_relocateCollider(PhysicsSystem *sys, uint32_t id, Collider *coll,
+                              Matrix *transform);
+void physics_relocateRigidBody(PhysicsSystem *sys, uint32_t id, RigidBody *rb);
 
 void physics_setPosition(RigidBody *rb, Vector3 pos);
 void physics_applyForce(RigidBody *rb, Vector3 force);
@@ -1,6 +1,14 @@
 #include "./render.h"
 #include "ecs.h"
 
+static int render_cmpDrawItem(const void *a, const void *b) {
+    const uint32_t keyA = ((const SortPairU32 *)a)->key;
+    const uint32_t keyB = ((const SortPairU32 *)b)->key;
+    return (keyA > keyB) - (keyA < keyB);
+}
+
+_VEC_FUNC(RenderDrawList, drawList, SortPairU32, render_cmpDrawItem)
+
 Renderer render_init(size_t maxSrcPoint, size_t maxSrcDir) {
     Renderer r;
     r.light.maxSrcPoint = maxSrcPoint;
@@ -10,8 +18,8 @@ Renderer render_init(size_t maxSrcPoint, size_t maxSrcDir) {
     r.shadowDir.resolution = 0;
     r.shadowDir.size = 0;
     r.state.shadowDirCam = NULL;
-    r.state.meshRendVisible = array_init();
-    r.state.meshRendVisibleDist = array_init();
+    r.state.meshRendVisible = drawList_init();
+    r.state.meshRendSortTmp = drawList_init();
     r.state.mainCam.position = (Vector3){0, 0, 0};
     r.state.mainCam.target = (Vector3){0, 0, 1};
     r.state.mainCam.up = (Vector3){0, 1, 0};
@@ -63,29 +71,20 @@ void render_setupDirShadow(Renderer *rend, float size, size_t nCascades,
 
 static void render_sortMeshRenderers(Engine *const engine, Renderer *const rend,
                                      Camera camera) {
-    Array *const meshRend = &engine->render.meshRend;
-    Array *const meshRendVis = &rend->state.meshRendVisible;
-    Array *const meshRendVisDist = &rend->state.meshRendVisibleDist;
+    RenderDrawList *const meshRendVis = &rend->state.meshRendVisible;
+    RenderDrawList *const sortTmp = &rend->state.meshRendSortTmp;
     Vector3 meshBBCenter;
     EngineCompMeshRenderer *meshRendComp;
-    EngineECSCompData *ecsCompData;
-    int32_t i;
+    size_t i;
     ECSEntityID entPos;
-    ECSComponentID compPos;
-    uint8_t sorted = 0;
     float dist;
 
     const Vector3 camPos = camera.position;
 
     // Compute distances between mesh renderers and camera
-    array_clear(meshRendVisDist);
-    for (i = 0; i < array_size(meshRendVis); i++) {
-        entPos = array_get(meshRendVis, i).u32;
-        compPos =
-            engine->ecs.entDesc[entPos].compIndex[ENGINE_COMP_MESHRENDERER];
-
-        ecsCompData = (EngineECSCompData *)engine->ecs.comp[compPos].data;
-        meshRendComp = &ecsCompData->meshR;
+    for (i = 0; i < meshRendVis->n; i++) {
+        entPos = meshRendVis->data[i].val;
+        meshRendComp = engine_getMeshRenderer(engine, entPos);
         meshBBCenter = engine_meshRendererCenter(&engine->ecs, meshRendComp);
 
         if (meshRendComp->distanceMode == RENDER_DIST_MAX)
@@ -97,60 +96,48 @@ static void render_sortMeshRenderers(Engine *const engine, Renderer *const rend,
         else {
             logMsg(LOG_LVL_ERR, "invalid distance mode for mesh %u: %u", entPos,
                    meshRendComp->distanceMode);
+            dist = 0.f;
         }
-        array_pushBack(meshRendVisDist, (ArrayVal)dist);
-    }
-
-    if (array_size(meshRendVis) == 0)
-        return;
-
-    while (!sorted) {
-        sorted = 1;
-        for (i = 0; i < array_size(meshRendVis) - 1; i++) {
-            float distA = array_get(meshRendVisDist, i).flt;
-            float distB = array_get(meshRendVisDist, i + 1).flt;
-            if (distA < distB) {
-                array_swap(meshRendVis, i, i + 1);
-                array_swap(meshRendVisDist, i, i + 1);
-                sorted = 0;
-            }
-        }
+        meshRendVis->data[i].key = sort_fltKey(dist);
     }
+    // Farthest first, the scratch is allocated by the sort if it can't grow
+    sort_radixU32(meshRendVis->data, meshRendVis->n,
+                  drawList_reserve(sortTmp, meshRendVis->n) ? sortTmp->data
+                                                            : NULL,
+                  1);
 }
 
 static void render_createMeshRendererDrawList(Engine *const engine,
                                               Renderer *const rend,
                                               Camera cam) {
     BoundingBox transBox;
-    Array *const meshRend = &engine->render.meshRend;
-    Array *const meshRendVis = &rend->state.meshRendVisible;
+    const ECSQuery *const meshRend = engine->render.meshRend;
+    EngineCompMeshRenderer **const meshRendComps =
+        (EngineCompMeshRenderer **)ecs_queryComp(meshRend,
+                                                 ENGINE_COMP_MESHRENDERER);
+    RenderDrawList *const meshRendVis = &rend->state.meshRendVisible;
     const Frustum frustum =
         GetCameraFrustum(cam, (float)GetScreenWidth() / GetScreenHeight());
     Vector3 meshBBCenter;
     EngineCompMeshRenderer *meshRendComp;
-    EngineECSCompData *ecsCompData;
     uint32_t i;
-    uint32_t compPos, entPos;
+    uint32_t entPos;
     uint8_t sorted = 0;
     float dist;
 
-    array_clear(meshRendVis);
-    for (i = 0; i < array_size(meshRend); i++) {
-        entPos = array_get(meshRend, i).u32;
-        compPos =
-            engine->ecs.entDesc[entPos].compIndex[ENGINE_COMP_MESHRENDERER];
-        ecsCompData = (EngineECSCompData *)engine->ecs.comp[compPos].data;
-        meshRendComp = &ecsCompData->meshR;
+    drawList_clear(meshRendVis);
+    for (i = 0; i < meshRend->nEnt; i++) {
+        entPos = meshRend->ent[i];
+        meshRendComp = meshRendComps[i];
         if (!meshRendComp->visible)
             continue;
         if (meshRendComp->transform == ECS_INVALID_ID) {
-            logMsg(LOG_LVL_ERR, "mesh renderer %u has null transform", compPos);
+            logMsg(LOG_LVL_ERR, "mesh renderer of entity %u has null transform",
+                   entPos);
             continue;
         }
-        transBox = BoxTransform(
-            meshRendComp->boundingBox,
-            engine_getTransform(engine, meshRendComp->transform)->globalMatrix);
-        meshRendComp->_boundingBoxTrans = transBox;
+        // Refreshed by engine_stepUpdate
+        transBox = meshRendComp->_boundingBoxTrans;
 
         Vector3 point = (Vector3){(transBox.min.x + transBox.max.x) / 2,
                                   (transBox.min.y + transBox.max.y) / 2,
@@ -159,27 +146,26 @@ static void render_createMeshRendererDrawList(Engine *const engine,
         if (FrustumBoxIntersect(frustum, transBox) == 2)
             continue;
 
-        array_pushBack(meshRendVis, (ArrayVal)entPos);
+        drawList_push(meshRendVis, (SortPairU32){0, entPos});
     }
 }
 
 void render_setShaderLightSrcUniforms(Engine *const engine,
                                       Renderer *const rend,
                                       const Shader shader) {
-    uint32_t i, compId;
+    uint32_t i, entId;
     uint32_t nSrcPoint = 0, nSrcDir = 0;
     uint32_t lightVec, lightColor, lightRange;
-    const Array *const lightSrcIdArr = &engine->render.lightSrc;
-    EngineECSCompData *ecsCompData;
+    const U32Vec *const lightSrcIds = &engine->render.lightSrc;
     EngineCompLightSrc *lightSrc;
     Vector3 dirLightDir;
 
-    for (i = 0; i < array_size(lightSrcIdArr); i++) {
-        compId = array_get(lightSrcIdArr, i).u32;
-        ecsCompData = (EngineECSCompData *)engine->ecs.comp[compId].data;
-        lightSrc = &ecsCompData->light;
+    for (i = 0; i < lightSrcIds->n; i++) {
+        entId = lightSrcIds->data[i];
+        lightSrc = engine_getLightSrc(engine, entId);
 
-        if (!lightSrc->visible)
+        // Destroyed since the last sync point
+        if (lightSrc == NULL || !lightSrc->visible)
             continue;
 
         switch (lightSrc->type) {
@@ -265,12 +251,8 @@ static void render_drawVisibleMeshes(Engine *const engine, Renderer *const rend,
                                      uint8_t inShadowPass) {
     static Shader defaultShader;
 
-    Array *const meshRend = &engine->render.meshRend;
-    Array *const meshRendVis = &rend->state.meshRendVisible;
-    Array *const meshRendVisDist = &rend->state.meshRendVisibleDist;
-    const ECSComponentID camId = engine->render.camera;
+    const RenderDrawList *const meshRendVis = &rend->state.meshRendVisible;
     EngineCompMeshRenderer *meshRendComp;
-    ECSComponentID compId;
     ECSEntityID entId;
     EngineCallbackData cbData;
     Model *model;
@@ -280,15 +262,14 @@ static void render_drawVisibleMeshes(Engine *const engine, Renderer *const rend,
     defaultShader.id = rlGetShaderIdDefault();
     defaultShader.locs = rlGetShaderLocsDefault();
 
-    for (size_t i = 0; i < array_size(meshRendVis); i++) {
-        entId = array_get(meshRendVis, i).u32;
-        compId = engine->ecs.entDesc[entId].compIndex[ENGINE_COMP_MESHRENDERER];
-        meshRendComp = (EngineCompMeshRenderer *)engine->ecs.comp[compId].data;
+    for (size_t i = 0; i < meshRendVis->n; i++) {
+        entId = meshRendVis->data[i].val;
+        meshRendComp = engine_getMeshRenderer(engine, entId);
         res = hashmap_getP(&engine->render.models, meshRendComp->modelId,
                            (void **)&model);
         if (!model) {
-            logMsg(LOG_LVL_ERR, "model id %u for mesh renderer id %u not found",
-                   meshRendComp->modelId, compId);
+            logMsg(LOG_LVL_ERR, "model id %u for mesh renderer of entity %u "
+                   "not found", meshRendComp->modelId, entId);
             continue;
         }
         if (inShadowPass && !meshRendComp->castShadow)
@@ -301,8 +282,9 @@ static void render_drawVisibleMeshes(Engine *const engine, Renderer *const rend,
                 res = hashmap_getP(&engine->render.shaders,
                                    meshRendComp->shaderId, (void **)&shader);
                 if (!res) {
-                    logMsg(LOG_LVL_ERR, "shader id %u for mesh id %u not found",
-                           meshRendComp->shaderId, compId);
+                    logMsg(LOG_LVL_ERR,
+                           "shader id %u for mesh of entity %u not found",
+                           meshRendComp->shaderId, entId);
                     shader = &defaultShader;
                 }
             } else
@@ -380,35 +362,34 @@ static void render_drawShadowMaps(Engine *const engine, Renderer *const rend) {
 }
 
 void render_updateState(Engine *const engine, Renderer *const rend) {
-    Array *const meshRend = &engine->render.meshRend;
-    Array *const meshRendVis = &rend->state.meshRendVisible;
-    Array *const meshRendVisDist = &rend->state.meshRendVisibleDist;
-    Array *const lightSrcIdArr = &engine->render.lightSrc;
+    const U32Vec *const lightSrcIds = &engine->render.lightSrc;
 
-    ECSComponentID compId;
-    EngineECSCompData *ecsCompData;
+    ECSEntityID entId;
+    EngineCompCamera *camComp;
     EngineCompMeshRenderer *meshRendComp;
     EngineCompLightSrc *lightSrc;
     Camera mainCam;
 
     uint32_t i;
 
-    compId = engine->render.camera;
-    if (compId == ECS_INVALID_ID) {
+    ecs_beginRead(&engine->ecs, ECS_COMP_MASK_ALL);
+    entId = engine->render.camera;
+    camComp = NULL;
+    if (entId != ECS_INVALID_ID)
+        camComp = engine_getCamera(engine, entId);
+    if (camComp == NULL) {
         logMsg(LOG_LVL_ERR, "invalid main camera id");
         mainCam = rend->state.mainCam;
     } else {
-        ecsCompData = (EngineECSCompData *)engine->ecs.comp[compId].data;
-        mainCam = ecsCompData->cam.cam;
+        mainCam = camComp->cam;
         rend->state.mainCam = mainCam;
     }
 
-    for (i = 0; i < array_size(lightSrcIdArr); i++) {
-        compId = array_get(lightSrcIdArr, i).u32;
-        ecsCompData = (EngineECSCompData *)engine->ecs.comp[compId].data;
-        lightSrc = &ecsCompData->light;
+    for (i = 0; i < lightSrcIds->n; i++) {
+        entId = lightSrcIds->data[i];
+        lightSrc = engine_getLightSrc(engine, entId);
 
-        if (!lightSrc->visible)
+        if (lightSrc == NULL || !lightSrc->visible)
             continue;
 
         if (lightSrc->type == ENGINE_LIGHTSRC_DIRECTIONAL &&
@@ -417,15 +398,12 @@ void render_updateState(Engine *const engine, Renderer *const rend) {
             break;
         }
     }
+    ecs_endRead(&engine->ecs, ECS_COMP_MASK_ALL);
 }
 
 void render_drawScene(Engine *const engine, Renderer *const rend) {
-    Array *const meshRend = &engine->render.meshRend;
-    Array *const meshRendVis = &rend->state.meshRendVisible;
-    Array *const meshRendVisDist = &rend->state.meshRendVisibleDist;
-    Array *const lightSrcIdArr = &engine->render.lightSrc;
-    ECSComponentID compId;
-    EngineECSCompData *ecsCompData;
+    const ECSQuery *const meshRend = engine->render.meshRend;
+    RenderDrawList *const meshRendVis = &rend->state.meshRendVisible;
     EngineCompMeshRenderer *meshRendComp;
     EngineCompLightSrc *lightSrc;
     Model *model;
@@ -433,10 +411,8 @@ void render_drawScene(Engine *const engine, Renderer *const rend) {
     uint8_t res;
     uint32_t i;
 
-    if (array_capacity(meshRendVis) < array_capacity(meshRend)) {
-        array_resize(meshRendVis, array_capacity(meshRend));
-        array_resize(meshRendVisDist, array_capacity(meshRend));
-    }
+    ecs_beginRead(&engine->ecs, ECS_COMP_MASK_ALL);
+    drawList_reserve(meshRendVis, meshRend->nEnt);
 
     // Draw shadows
     if (rend->shadowDir.shadowMap != NULL) {
@@ -452,4 +428,5 @@ void render_drawScene(Engine *const engine, Renderer *const rend) {
     render_drawVisibleMeshes(engine, rend, NULL, 0);
 
     EndMode3D();
+    ecs_endRead(&engine->ecs, ECS_COMP_MASK_ALL);
 }
\ No newline at end of file
@@ -20,12 +20,16 @@ enum {
     SHADER_WATERPLANE_ID
 };
 
+// Visible mesh renderers, keyed by sort_fltKey of their distance to the
+// camera with the entity ID as value
+_VEC_DECL(RenderDrawList, drawList, SortPairU32)
+
 typedef struct Renderer {
     struct {
-        Array meshRendVisible;     // Visible Mesh Renderer component IDs
-        Array meshRendVisibleDist; // distance to each Mesh Renderer
-        Camera *shadowDirCam;      // shadow maps cameras
-        Camera mainCam;            // main render camera
+        RenderDrawList meshRendVisible; // Visible Mesh Renderers
+        RenderDrawList meshRendSortTmp; // radix sort scratch
+        Camera *shadowDirCam;           // shadow maps cameras
+        Camera mainCam;                 // main render camera
     } state;
 
     struct {
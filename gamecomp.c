@@ -5,10 +5,9 @@ const EngineMsgType BOOM = ENGINE_MSG_TYPE_INTERACT + 1;
 
 static void game_cbPlayerControllerOnUpdate(uint32_t cbType, ECSEntityID entId,
                                             ECSComponentID compId,
-                                            uint32_t compType,
-                                            struct ECSComponent *comp,
+                                            uint32_t compType, void *compData,
                                             void *cbUserData) {
-    GameCompPlayerController *pc = &((GameCompController *)comp->data)->player;
+    GameCompPlayerController *pc = &((GameCompController *)compData)->player;
 
     static Vector3 actualDeltaPos;
 
@@ -117,7 +116,7 @@ static void game_cbPlayerControllerOnUpdate(uint32_t cbType, ECSEntityID entId,
 static void
 engine_cbCollisionDbgViewOnUpdate(uint32_t cbType, ECSEntityID entId,
                                   ECSComponentID compId, uint32_t compType,
-                                  struct ECSComponent *comp, void *cbUserData) {
+                                  void *compData, void *cbUserData) {
     const EngineCallbackData *cbData = cbUserData;
     Collider *coll = engine_getCollider(cbData->engine, entId);
     EngineCompMeshRenderer *mr = engine_getMeshRenderer(cbData->engine, entId);
@@ -136,12 +135,12 @@ engine_cbCollisionDbgViewOnUpdate(uint32_t cbType, ECSEntityID entId,
 
 static void weatherCbPreRender(uint32_t cbType, ECSEntityID entId,
                                ECSComponentID compId, uint32_t compType,
-                               struct ECSComponent *comp, void *cbUserData) {
+                               void *compData, void *cbUserData) {
     rlDisableBackfaceCulling();
     rlDisableDepthTest();
     rlDisableDepthMask();
     EngineCallbackData *cbData = (EngineCallbackData *)cbUserData;
-    EngineCompMeshRenderer *mr = &((EngineECSCompData *)comp->data)->meshR;
+    EngineCompMeshRenderer *mr = (EngineCompMeshRenderer *)compData;
     Model *mdl = engine_render_getModel(cbData->engine, mr->modelId);
 
     int texSlot = MATERIAL_MAP_CUBEMAP;
@@ -152,7 +151,7 @@ static void weatherCbPreRender(uint32_t cbType, ECSEntityID entId,
 
 static void weatherCbPostRender(uint32_t cbType, ECSEntityID entId,
                                 ECSComponentID compId, uint32_t compType,
-                                struct ECSComponent *comp, void *cbUserData) {
+                                void *compData, void *cbUserData) {
     rlEnableBackfaceCulling();
     rlEnableDepthTest();
     rlEnableDepthMask();
@@ -160,13 +159,12 @@ static void weatherCbPostRender(uint32_t cbType, ECSEntityID entId,
 
 static void waterCbPreRender(uint32_t cbType, ECSEntityID entId,
                              ECSComponentID compId, uint32_t compType,
-                             struct ECSComponent *comp, void *cbUserData) {
+                             void *compData, void *cbUserData) {
     EngineCallbackData *cbData = (EngineCallbackData *)cbUserData;
-    EngineCompMeshRenderer *mr = &((EngineECSCompData *)comp->data)->meshR;
+    EngineCompMeshRenderer *mr = (EngineCompMeshRenderer *)compData;
     Model *mdl = engine_render_getModel(cbData->engine, mr->modelId);
-    EngineCompCamera *cam = (EngineCompCamera *)cbData->engine->ecs
-                                .comp[cbData->engine->render.camera]
-                                .data;
+    EngineCompCamera *cam =
+        engine_getCamera(cbData->engine, cbData->engine->render.camera);
 
     int texSlot = MATERIAL_MAP_CUBEMAP;
     float time = GetTime();
@@ -188,8 +186,9 @@ static void waterCbPreRender(uint32_t cbType, ECSEntityID entId,
 static void engine_createCollisionDbgView(Engine *const engine,
                                           const ECSEntityID ent) {
     const EngineECSCompType type = ENGINE_COMP_USER + 1;
-    ECSComponent compRaw;
-    if (ecs_registerComp(&engine->ecs, ent, type, compRaw) != ECS_RES_OK) {
+    const uint8_t compData = 0;
+    if (ecs_registerCompData(&engine->ecs, ent, type, &compData) !=
+        ECS_RES_OK) {
         logMsg(LOG_LVL_ERR, "couldn't register collision debug view component");
         return;
     }
@@ -199,7 +198,7 @@ static void engine_createCollisionDbgView(Engine *const engine,
 
 static void boxPropCustomCallback(uint32_t cbType, ECSEntityID entId,
                                   ECSComponentID compId, uint32_t compType,
-                                  struct ECSComponent *comp, void *cbUserData) {
+                                  void *compData, void *cbUserData) {
     EngineCallbackData *cbData = cbUserData;
     RigidBody *body = engine_getRigidBody(cbData->engine, entId);
 
@@ -217,19 +216,25 @@ static void boxPropCustomCallback(uint32_t cbType, ECSEntityID entId,
 }
 
 static void gameCreatePlayerController(Engine *engine, ECSEntityID ent) {
-    ECSComponent controller;
-    GameCompController *ctrl = (GameCompController *)controller.data;
+    GameCompController controller;
+    GameCompController *ctrl = &controller;
     ctrl->type = GAME_CONTROLLER_PLAYER;
     ctrl->player.camForward = (Vector3){0.f, -.8f, .1f};
     ctrl->player.sensitivity = .004f;
     ctrl->player.moveSpeed = 30.f;
     ctrl->player.mode = GAME_PLAYERMODE_NOCLIP;
 
-    ecs_registerComp(&engine->ecs, ent, GAME_COMP_CONTROLLER, controller);
+    ecs_registerCompData(&engine->ecs, ent, GAME_COMP_CONTROLLER, ctrl);
     ecs_setCallback(&engine->ecs, ent, GAME_COMP_CONTROLLER, ENGINE_CB_UPDATE,
                     game_cbPlayerControllerOnUpdate);
 }
 
+void registerGameComponents(Engine *engine) {
+    ECS_SET_COMP_TYPE(&engine->ecs, GAME_COMP_CONTROLLER, GameCompController);
+    // The collision debug view has no data
+    ecs_setCompTypeSize(&engine->ecs, ENGINE_COMP_USER + 1, 1);
+}
+
 Player createPlayer(Engine *engine) {
     const static char *const name = "player";
     Player player;
@@ -263,28 +268,59 @@ Player createPlayer(Engine *engine) {
     return player;
 }
 
-Prop createProp(Engine *engine, EngineRenderModelID modelId) {
+static ECSEntityID gameRegisterProp(Engine *engine,
+                                    EngineRenderModelID modelId) {
     const static char *const name = "prop";
-    Prop prop;
-    ecs_registerEntity(&engine->ecs, &prop.id, name);
-    engine_createInfo(engine, prop.id, GAME_ENT_TYPE_PROP);
-    engine_createTransform(engine, prop.id, ECS_INVALID_ID);
-    engine_createMeshRenderer(engine, prop.id, prop.id, modelId);
-    engine_createConvexHullColliderModel(engine, prop.id, modelId);
-    engine_createRigidBody(engine, prop.id, 1.f);
-
-    ecs_setCallback(&engine->ecs, prop.id, ENGINE_COMP_RIGIDBODY,
-                    ENGINE_CB_MSGRECV, boxPropCustomCallback);
+    ECSEntityID id;
+    ecs_registerEntity(&engine->ecs, &id, name);
+    engine_createInfo(engine, id, GAME_ENT_TYPE_PROP);
+    engine_createTransform(engine, id, ECS_INVALID_ID);
+    engine_createMeshRenderer(engine, id, id, modelId);
+    engine_createConvexHullColliderModel(engine, id, modelId);
+    engine_createRigidBody(engine, id, 1.f);
+
+    ecs_setCallback(&engine->ecs, id, ENGINE_COMP_RIGIDBODY, ENGINE_CB_MSGRECV,
+                    boxPropCustomCallback);
+    engine_getMeshRenderer(engine, id)->shaderId = SHADER_FORWARD_BASIC_ID;
+    return id;
+}
 
+Prop createProp(Engine *engine, EngineRenderModelID modelId) {
+    Prop prop;
+    prop.id = gameRegisterProp(engine, modelId);
     prop.info = engine_getInfo(engine, prop.id);
     prop.transform = engine_getTransform(engine, prop.id);
     prop.rb = engine_getRigidBody(engine, prop.id);
     prop.coll = engine_getCollider(engine, prop.id);
     prop.meshRenderer = engine_getMeshRenderer(engine, prop.id);
-    prop.meshRenderer->shaderId = SHADER_FORWARD_BASIC_ID;
     return prop;
 }
 
+EngineStatus createPropPrefab(Engine *engine, ECSPrefab *prefab,
+                              EngineRenderModelID modelId) {
+    ecs_prefabInit(prefab, "prop");
+    return engine_createPrefab(engine, prefab,
+                               gameRegisterProp(engine, modelId));
+}
+
+EngineStatus spawnProps(Engine *engine, const ECSPrefab *prefab,
+                        const Vector3 *positions, size_t count,
+                        ECSEntityID *idsOut) {
+    EngineStatus res;
+    res = engine_instantiatePrefab(engine, prefab, count, idsOut);
+    if (res != ENGINE_STATUS_OK)
+        return res;
+    for (size_t i = 0; i < count; i++)
+        physics_setPosition(engine_getRigidBody(engine, idsOut[i]),
+                            positions[i]);
+    return ENGINE_STATUS_OK;
+}
+
+void despawnProps(Engine *engine, const ECSEntityID *ids, size_t count) {
+    for (size_t i = 0; i < count; i++)
+        engine_entityPark(engine, ids[i]);
+}
+
 Water createWater(Engine *engine, EngineRenderModelID modelId) {
     const static char *const name = "water";
     Water prop;
@@ -107,8 +107,20 @@ typedef struct Lightbulb {
     EngineCompMeshRenderer *meshRenderer;
 } Lightbulb;
 
+// Set the storage layout of the game component types. Call right after
+// engine_init.
+void registerGameComponents(Engine *engine);
 Player createPlayer(Engine *engine);
 Prop createProp(Engine *engine, EngineRenderModelID modelId);
+// Build the prefab of a prop, for spawning many of them at once
+EngineStatus createPropPrefab(Engine *engine, ECSPrefab *prefab,
+                              EngineRenderModelID modelId);
+// Instantiate count props from a prefab at the given positions
+EngineStatus spawnProps(Engine *engine, const ECSPrefab *prefab,
+                        const Vector3 *positions, size_t count,
+                        ECSEntityID *idsOut);
+// Park props spawned by spawnProps, so that the next spawn reuses them
+void despawnProps(Engine *engine, const ECSEntityID *ids, size_t count);
 Water createWater(Engine *engine, EngineRenderModelID modelId);
 Weather createWeather(Engine *engine, Vector3 ambientColor);
 Environment createEnvironment(Engine *engine, Vector3 lightColor,
@@ -142,6 +142,7 @@ int main(void) {
     logSetHeaderThreshold("engine/ecs.c", LOG_LVL_INFO);
 
     engine_init(&engine);
+    registerGameComponents(&engine);
     rend = render_init(4, 4);
     render_setupDirShadow(&rend, 20, 3, 512);
     loadAssets(&engine);
@@ -157,7 +158,7 @@ int main(void) {
     engine_entityPostCreate(&engine, env.id);
 
     Prop playerBarrel = createProp(&engine, GAME_MODEL_CYLINDER);
-    engine.ecs.entDesc[playerBarrel.id].name = "PLAYERBARREL";
+    ecs_setEntityName(&engine.ecs, playerBarrel.id, "PLAYERBARREL");
     playerBarrel.rb->mass = 30.f;
     playerBarrel.rb->cog = (Vector3){0, 3, 0};
     playerBarrel.rb->staticFriction = 0.8;
@@ -188,10 +189,13 @@ int main(void) {
             else
                 DisableCursor();
         }
+        if (IsKeyPressed(KEY_F3))
+            engine_dumpStats(&engine, "ecs_stats.json");
     }
 
     UnloadNuklear(ctx);
     cleanup(&engine);
+    engine_free(&engine);
     CloseWindow();
 
     return 0;